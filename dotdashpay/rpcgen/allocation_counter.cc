@@ -0,0 +1,44 @@
+/**
+   Counts the allocations made through the global operator new.
+**/
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<unsigned long long> allocation_count(0);
+std::atomic<unsigned long long> allocated_bytes(0);
+
+void* CountedAllocate(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (pointer == NULL) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return CountedAllocate(size); }
+void* operator new[](size_t size) { return CountedAllocate(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+namespace ddprpc_generator {
+
+AllocationCounts GetAllocationCounts() {
+  AllocationCounts counts;
+  counts.allocations = allocation_count.load(std::memory_order_relaxed);
+  counts.bytes = allocated_bytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+}  // namespace ddprpc_generator
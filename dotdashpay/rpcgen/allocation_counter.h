@@ -0,0 +1,24 @@
+/**
+   Counts the allocations made through the global operator new, for the
+   replay mode of the plugins. It replaces operator new and delete for
+   the whole binary, so it is only linked in when the build is
+   configured with COUNT_ALLOCATIONS=ON.
+**/
+
+#ifndef __DOTDASHPAY_RPCGEN_ALLOCATION_COUNTER_H__
+#define __DOTDASHPAY_RPCGEN_ALLOCATION_COUNTER_H__
+
+namespace ddprpc_generator {
+
+struct AllocationCounts {
+  unsigned long long allocations;
+  unsigned long long bytes;
+};
+
+// Allocations and bytes requested from operator new since the process
+// started, on every thread.
+AllocationCounts GetAllocationCounts();
+
+}  // namespace ddprpc_generator
+
+#endif  // __DOTDASHPAY_RPCGEN_ALLOCATION_COUNTER_H__
@@ -37,10 +37,14 @@
 #include <dotdashpay/api/common/protobuf/api_common.pb.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/printer.h>
-#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using std::map;
 using std::string;
@@ -72,83 +76,1407 @@ string FilenameIdentifier(const string &filename) {
 }
 }  // namespace
 
-string GetHeaderPrologue(const google::protobuf::FileDescriptor *file,
+void PrintHeaderPrologue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
                          const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["filename"] = file->name();
-    vars["filename_identifier"] = FilenameIdentifier(file->name());
-    vars["filename_base"] = ddprpc_generator::StripProto(file->name());
-
-    vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
-    vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
-    
-    printer.Print(vars, "// Generated by the ddpRPC protobuf plugin.\n");
-    printer.Print(vars, "// If you make any local change, they will be lost.\n");
-    printer.Print(vars, "// source: $filename$\n");
-    printer.Print(vars, "#ifndef __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
-    printer.Print(vars, "#define __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
-    printer.Print(vars, "\n");
-    printer.Print(vars, "#define DDP_API_MAJOR_VERSION $major_version$\n");
-    printer.Print(vars, "#define DDP_API_MINOR_VERSION $minor_version$\n");
-    printer.Print(vars, "\n");
-    printer.Print(vars, "#include \"$filename_base$.pb.h\"\n");
-    printer.Print(vars, "\n");
-  }
-  return output;
-}
-
-string GetHeaderIncludes(const google::protobuf::FileDescriptor *file,
-                               const Parameters &params) {
-  string temp =
-      "#include <dotdashpay/common/function.h>\n"
-      "\n\n";
+  map<string, string> vars;
+
+  vars["filename"] = file->name();
+  vars["filename_identifier"] = FilenameIdentifier(file->name());
+  vars["filename_base"] = ddprpc_generator::StripProto(file->name());
+
+  vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
+  vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
+
+  printer->Print(vars, "// Generated by the ddpRPC protobuf plugin.\n");
+  printer->Print(vars, "// If you make any local change, they will be lost.\n");
+  printer->Print(vars, "// source: $filename$\n");
+  printer->Print(vars, "#ifndef __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
+  printer->Print(vars, "#define __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "#define DDP_API_MAJOR_VERSION $major_version$\n");
+  printer->Print(vars, "#define DDP_API_MINOR_VERSION $minor_version$\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "#include \"$filename_base$.pb.h\"\n");
+  printer->Print(vars, "\n");
+}
+
+namespace {
+
+// Print InplaceFunction, the move-only handler type used by
+// callback_style=inplace. Every header generated with that style
+// carries it, so the definition is guarded.
+void PrintHeaderInplaceFunction(google::protobuf::io::Printer *printer) {
+  printer->Print(
+      "#ifndef __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__\n"
+      "#define __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__\n"
+      "\n"
+      "#include <new>\n"
+      "#include <type_traits>\n"
+      "\n"
+      "namespace dotdashpay {\n"
+      "namespace ddprpc {\n"
+      "\n"
+      "// A move-only callable that stores its target in an inline buffer of\n"
+      "// Capacity bytes instead of on the heap. Targets that do not fit are\n"
+      "// rejected at compile time.\n"
+      "template <class Signature, size_t Capacity = 4 * sizeof(void*)>\n"
+      "class InplaceFunction;\n"
+      "\n"
+      "template <class R, class... Args, size_t Capacity>\n"
+      "class InplaceFunction<R(Args...), Capacity> {\n"
+      " public:\n"
+      "  InplaceFunction() : invoke_(NULL), manage_(NULL) {}\n"
+      "  InplaceFunction(std::nullptr_t) : invoke_(NULL), manage_(NULL) {}\n"
+      "\n"
+      "  template <class F, class = typename std::enable_if<\n"
+      "                        !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>\n"
+      "  InplaceFunction(F&& target) {\n"
+      "    typedef typename std::decay<F>::type Target;\n"
+      "    static_assert(sizeof(Target) <= Capacity, \"the handler does not fit in an InplaceFunction\");\n"
+      "    static_assert(alignof(Target) <= alignof(Storage), \"the handler is over-aligned\");\n"
+      "    new (&storage_) Target(std::forward<F>(target));\n"
+      "    invoke_ = &Invoke<Target>;\n"
+      "    manage_ = &Manage<Target>;\n"
+      "  }\n"
+      "\n"
+      "  InplaceFunction(InplaceFunction&& other) : invoke_(NULL), manage_(NULL) {\n"
+      "    MoveFrom(&other);\n"
+      "  }\n"
+      "\n"
+      "  InplaceFunction& operator=(InplaceFunction&& other) {\n"
+      "    if (this != &other) {\n"
+      "      Reset();\n"
+      "      MoveFrom(&other);\n"
+      "    }\n"
+      "    return *this;\n"
+      "  }\n"
+      "\n"
+      "  InplaceFunction(const InplaceFunction&) = delete;\n"
+      "  InplaceFunction& operator=(const InplaceFunction&) = delete;\n"
+      "\n"
+      "  ~InplaceFunction() { Reset(); }\n"
+      "\n"
+      "  explicit operator bool() const { return invoke_ != NULL; }\n"
+      "\n"
+      "  R operator()(Args... args) const {\n"
+      "    return invoke_(&storage_, std::forward<Args>(args)...);\n"
+      "  }\n"
+      "\n"
+      " private:\n"
+      "  typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;\n"
+      "\n"
+      "  template <class Target>\n"
+      "  static R Invoke(void* storage, Args&&... args) {\n"
+      "    return (*static_cast<Target*>(storage))(std::forward<Args>(args)...);\n"
+      "  }\n"
+      "\n"
+      "  // Move the target at source to destination, unless destination is\n"
+      "  // NULL, and destroy the one at source.\n"
+      "  template <class Target>\n"
+      "  static void Manage(void* destination, void* source) {\n"
+      "    Target* target = static_cast<Target*>(source);\n"
+      "    if (destination != NULL) {\n"
+      "      new (destination) Target(std::move(*target));\n"
+      "    }\n"
+      "    target->~Target();\n"
+      "  }\n"
+      "\n"
+      "  void MoveFrom(InplaceFunction* other) {\n"
+      "    if (other->manage_ != NULL) {\n"
+      "      other->manage_(&storage_, &other->storage_);\n"
+      "    }\n"
+      "    invoke_ = other->invoke_;\n"
+      "    manage_ = other->manage_;\n"
+      "    other->invoke_ = NULL;\n"
+      "    other->manage_ = NULL;\n"
+      "  }\n"
+      "\n"
+      "  void Reset() {\n"
+      "    if (manage_ != NULL) {\n"
+      "      manage_(NULL, &storage_);\n"
+      "    }\n"
+      "    invoke_ = NULL;\n"
+      "    manage_ = NULL;\n"
+      "  }\n"
+      "\n"
+      "  R (*invoke_)(void*, Args&&...);\n"
+      "  void (*manage_)(void*, void*);\n"
+      "  mutable Storage storage_;\n"
+      "};\n"
+      "\n"
+      "typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceUpdateFunction;\n"
+      "typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceCompletionFunction;\n"
+      "\n"
+      "}  // namespace ddprpc\n"
+      "}  // namespace dotdashpay\n"
+      "\n"
+      "#endif  // __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__\n"
+      "\n\n");
+}
+
+bool HasStreamingMethods(const google::protobuf::FileDescriptor *file) {
+  for (int i = 0; i < file->service_count(); ++i) {
+    for (int j = 0; j < file->service(i)->method_count(); ++j) {
+      if (ddprpc_generator::GetMethodType(file->service(i)->method(j)) != ddprpc_generator::METHODTYPE_NO_STREAMING) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Print the StreamReader and StreamWriter interfaces taken by streaming
+// methods and BoundedStream, the bounded queue that implements both.
+// Guarded like InplaceFunction.
+void PrintHeaderStreams(google::protobuf::io::Printer *printer) {
+  printer->Print(
+      "#ifndef __DOTDASHPAY_DDPRPC_STREAMS__\n"
+      "#define __DOTDASHPAY_DDPRPC_STREAMS__\n"
+      "\n"
+      "#include <condition_variable>\n"
+      "#include <deque>\n"
+      "#include <mutex>\n"
+      "#include <vector>\n"
+      "\n"
+      "namespace dotdashpay {\n"
+      "namespace ddprpc {\n"
+      "\n"
+      "// The receiving end of a stream of messages.\n"
+      "template <class T>\n"
+      "class StreamReader {\n"
+      " public:\n"
+      "  virtual ~StreamReader() {}\n"
+      "\n"
+      "  // Block until a message is available and move it into message.\n"
+      "  // Returns false once the stream is closed and drained.\n"
+      "  virtual bool Read(T* message) = 0;\n"
+      "\n"
+      "  // Block until a message is available, then move up to max_count\n"
+      "  // queued messages onto the end of messages. Returns the number of\n"
+      "  // messages read, which is 0 once the stream is closed and drained.\n"
+      "  virtual size_t ReadBatch(std::vector<T>* messages, size_t max_count) = 0;\n"
+      "};\n"
+      "\n"
+      "// The sending end of a stream of messages.\n"
+      "template <class T>\n"
+      "class StreamWriter {\n"
+      " public:\n"
+      "  virtual ~StreamWriter() {}\n"
+      "\n"
+      "  // Queue message, blocking while the stream is full. Returns false\n"
+      "  // if the stream is closed.\n"
+      "  virtual bool Write(T&& message) = 0;\n"
+      "\n"
+      "  bool Write(const T& message) {\n"
+      "    T copy(message);\n"
+      "    return Write(std::move(copy));\n"
+      "  }\n"
+      "\n"
+      "  // Move the count messages at messages into the stream, blocking\n"
+      "  // whenever it is full. Returns the number of messages written,\n"
+      "  // which is less than count only if the stream is closed.\n"
+      "  virtual size_t WriteBatch(T* messages, size_t count) = 0;\n"
+      "\n"
+      "  // Signal that no more messages will be written.\n"
+      "  virtual void Close() = 0;\n"
+      "};\n"
+      "\n"
+      "// A stream that queues at most capacity messages between its writer\n"
+      "// and its reader. Writers block while the queue is full, so a\n"
+      "// producer cannot outrun its consumer by more than capacity\n"
+      "// messages. Safe to use from one writer and one reader thread.\n"
+      "template <class T>\n"
+      "class BoundedStream : public StreamReader<T>, public StreamWriter<T> {\n"
+      " public:\n"
+      "  explicit BoundedStream(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity), closed_(false) {}\n"
+      "\n"
+      "  using StreamWriter<T>::Write;\n"
+      "\n"
+      "  virtual bool Write(T&& message) {\n"
+      "    std::unique_lock<std::mutex> lock(mutex_);\n"
+      "    not_full_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });\n"
+      "    if (closed_) {\n"
+      "      return false;\n"
+      "    }\n"
+      "    queue_.push_back(std::move(message));\n"
+      "    not_empty_.notify_one();\n"
+      "    return true;\n"
+      "  }\n"
+      "\n"
+      "  virtual size_t WriteBatch(T* messages, size_t count) {\n"
+      "    std::unique_lock<std::mutex> lock(mutex_);\n"
+      "    size_t written = 0;\n"
+      "    while (written < count) {\n"
+      "      not_full_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });\n"
+      "      if (closed_) {\n"
+      "        break;\n"
+      "      }\n"
+      "      while (written < count && queue_.size() < capacity_) {\n"
+      "        queue_.push_back(std::move(messages[written++]));\n"
+      "      }\n"
+      "      not_empty_.notify_one();\n"
+      "    }\n"
+      "    return written;\n"
+      "  }\n"
+      "\n"
+      "  virtual void Close() {\n"
+      "    std::lock_guard<std::mutex> lock(mutex_);\n"
+      "    closed_ = true;\n"
+      "    not_empty_.notify_all();\n"
+      "    not_full_.notify_all();\n"
+      "  }\n"
+      "\n"
+      "  virtual bool Read(T* message) {\n"
+      "    std::unique_lock<std::mutex> lock(mutex_);\n"
+      "    not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });\n"
+      "    if (queue_.empty()) {\n"
+      "      return false;\n"
+      "    }\n"
+      "    *message = std::move(queue_.front());\n"
+      "    queue_.pop_front();\n"
+      "    not_full_.notify_one();\n"
+      "    return true;\n"
+      "  }\n"
+      "\n"
+      "  virtual size_t ReadBatch(std::vector<T>* messages, size_t max_count) {\n"
+      "    std::unique_lock<std::mutex> lock(mutex_);\n"
+      "    not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });\n"
+      "    size_t read = 0;\n"
+      "    while (read < max_count && !queue_.empty()) {\n"
+      "      messages->push_back(std::move(queue_.front()));\n"
+      "      queue_.pop_front();\n"
+      "      ++read;\n"
+      "    }\n"
+      "    not_full_.notify_one();\n"
+      "    return read;\n"
+      "  }\n"
+      "\n"
+      " private:\n"
+      "  const size_t capacity_;\n"
+      "  bool closed_;\n"
+      "  std::deque<T> queue_;\n"
+      "  std::mutex mutex_;\n"
+      "  std::condition_variable not_empty_;\n"
+      "  std::condition_variable not_full_;\n"
+      "};\n"
+      "\n"
+      "}  // namespace ddprpc\n"
+      "}  // namespace dotdashpay\n"
+      "\n"
+      "#endif  // __DOTDASHPAY_DDPRPC_STREAMS__\n"
+      "\n\n");
+}
+
+// Print RequestKey, which identifies requests by their serialization.
+// Guarded like InplaceFunction.
+void PrintHeaderRequestKey(google::protobuf::io::Printer *printer) {
+  printer->Print(
+      "#ifndef __DOTDASHPAY_DDPRPC_REQUEST_KEY__\n"
+      "#define __DOTDASHPAY_DDPRPC_REQUEST_KEY__\n"
+      "\n"
+      "#include <google/protobuf/io/zero_copy_stream_impl_lite.h>\n"
+      "\n"
+      "namespace dotdashpay {\n"
+      "namespace ddprpc {\n"
+      "\n"
+      "// The deterministic serialization of request, which byte-identical\n"
+      "// requests share.\n"
+      "inline std::string RequestKey(const ::google::protobuf::MessageLite& request) {\n"
+      "  std::string key;\n"
+      "  ::google::protobuf::io::StringOutputStream stream(&key);\n"
+      "  ::google::protobuf::io::CodedOutputStream output(&stream);\n"
+      "  output.SetSerializationDeterministic(true);\n"
+      "  request.SerializePartialToCodedStream(&output);\n"
+      "  output.Trim();\n"
+      "  return key;\n"
+      "}\n"
+      "\n"
+      "}  // namespace ddprpc\n"
+      "}  // namespace dotdashpay\n"
+      "\n"
+      "#endif  // __DOTDASHPAY_DDPRPC_REQUEST_KEY__\n"
+      "\n\n");
+}
+
+bool HasCacheableMethods(const google::protobuf::FileDescriptor *file) {
+  for (int i = 0; i < file->service_count(); ++i) {
+    if (ddprpc_generator::HasCacheableMethods(file->service(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HasIdempotentMethods(const google::protobuf::FileDescriptor *file) {
+  for (int i = 0; i < file->service_count(); ++i) {
+    if (ddprpc_generator::HasIdempotentMethods(file->service(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Print ResponseCache, the cache behind the Caching<Service> classes of
+// services with cacheable methods. Guarded like InplaceFunction.
+void PrintHeaderResponseCache(google::protobuf::io::Printer *printer) {
+  printer->Print(
+      "#ifndef __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__\n"
+      "#define __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__\n"
+      "\n"
+      "#include <chrono>\n"
+      "#include <list>\n"
+      "#include <mutex>\n"
+      "#include <unordered_map>\n"
+      "\n"
+      "namespace dotdashpay {\n"
+      "namespace ddprpc {\n"
+      "\n"
+      "// Maps request keys to the completion responses they produced.\n"
+      "// Every response is kept for the same time-to-live, so entries expire\n"
+      "// in insertion order and the oldest one is evicted to stay within\n"
+      "// capacity. Safe to use from several threads.\n"
+      "class ResponseCache {\n"
+      " public:\n"
+      "  typedef std::chrono::steady_clock Clock;\n"
+      "\n"
+      "  ResponseCache(size_t capacity, Clock::duration ttl) : capacity_(capacity), ttl_(ttl) {}\n"
+      "\n"
+      "  ResponseCache(const ResponseCache&) = delete;\n"
+      "  ResponseCache& operator=(const ResponseCache&) = delete;\n"
+      "\n"
+      "  // The response cached for the request with key, or NULL if there is\n"
+      "  // none or it has expired.\n"
+      "  std::shared_ptr<const ::google::protobuf::Message> Find(const std::string& key) {\n"
+      "    std::lock_guard<std::mutex> lock(mutex_);\n"
+      "    Entries::iterator entry = entries_.find(key);\n"
+      "    if (entry == entries_.end()) {\n"
+      "      return nullptr;\n"
+      "    }\n"
+      "    if (entry->second.expires <= Clock::now()) {\n"
+      "      Erase(entry);\n"
+      "      return nullptr;\n"
+      "    }\n"
+      "    return entry->second.response;\n"
+      "  }\n"
+      "\n"
+      "  // Cache a copy of response for the request with key.\n"
+      "  void Insert(const std::string& key, const ::google::protobuf::Message& response) {\n"
+      "    if (capacity_ == 0) {\n"
+      "      return;\n"
+      "    }\n"
+      "    ::google::protobuf::Message* copy = response.New();\n"
+      "    copy->CopyFrom(response);\n"
+      "    std::shared_ptr<const ::google::protobuf::Message> cached(copy);\n"
+      "    const Clock::time_point expires = Clock::now() + ttl_;\n"
+      "\n"
+      "    std::lock_guard<std::mutex> lock(mutex_);\n"
+      "    Entries::iterator entry = entries_.find(key);\n"
+      "    if (entry != entries_.end()) {\n"
+      "      Erase(entry);\n"
+      "    }\n"
+      "    while (entries_.size() >= capacity_) {\n"
+      "      Erase(entries_.find(*order_.front()));\n"
+      "    }\n"
+      "    entry = entries_.insert(std::make_pair(key, Entry())).first;\n"
+      "    entry->second.expires = expires;\n"
+      "    entry->second.response = std::move(cached);\n"
+      "    entry->second.position = order_.insert(order_.end(), &entry->first);\n"
+      "  }\n"
+      "\n"
+      "  void Clear() {\n"
+      "    std::lock_guard<std::mutex> lock(mutex_);\n"
+      "    entries_.clear();\n"
+      "    order_.clear();\n"
+      "  }\n"
+      "\n"
+      " private:\n"
+      "  struct Entry {\n"
+      "    Clock::time_point expires;\n"
+      "    std::shared_ptr<const ::google::protobuf::Message> response;\n"
+      "    std::list<const std::string*>::iterator position;\n"
+      "  };\n"
+      "  typedef std::unordered_map<std::string, Entry> Entries;\n"
+      "\n"
+      "  void Erase(Entries::iterator entry) {\n"
+      "    order_.erase(entry->second.position);\n"
+      "    entries_.erase(entry);\n"
+      "  }\n"
+      "\n"
+      "  const size_t capacity_;\n"
+      "  const Clock::duration ttl_;\n"
+      "  Entries entries_;\n"
+      "  // The keys of entries_, oldest first.\n"
+      "  std::list<const std::string*> order_;\n"
+      "  std::mutex mutex_;\n"
+      "};\n"
+      "\n"
+      "}  // namespace ddprpc\n"
+      "}  // namespace dotdashpay\n"
+      "\n"
+      "#endif  // __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__\n"
+      "\n\n");
+}
+
+// Print SingleFlight, the table of in-flight calls behind the
+// Coalescing<Service> classes of services with idempotent methods.
+// Guarded like InplaceFunction.
+void PrintHeaderSingleFlight(google::protobuf::io::Printer *printer) {
+  printer->Print(
+      "#ifndef __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__\n"
+      "#define __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__\n"
+      "\n"
+      "#include <mutex>\n"
+      "#include <unordered_map>\n"
+      "\n"
+      "namespace dotdashpay {\n"
+      "namespace ddprpc {\n"
+      "\n"
+      "// The calls of one method that are in flight, by request key. The\n"
+      "// handlers of identical requests made while one is in flight are\n"
+      "// attached to it and share its responses instead of sending the\n"
+      "// request again. Safe to use from several threads.\n"
+      "template <class UpdateFunction, class CompletionFunction>\n"
+      "class SingleFlight {\n"
+      " public:\n"
+      "  SingleFlight() {}\n"
+      "\n"
+      "  SingleFlight(const SingleFlight&) = delete;\n"
+      "  SingleFlight& operator=(const SingleFlight&) = delete;\n"
+      "\n"
+      "  // Attach the handlers to the call for the request with key. Returns\n"
+      "  // true if there was no such call yet and the caller has to send the\n"
+      "  // request.\n"
+      "  bool Join(const std::string& key, UpdateFunction update_handler, CompletionFunction completion_handler) {\n"
+      "    std::shared_ptr<Handlers> handlers(new Handlers(std::move(update_handler), std::move(completion_handler)));\n"
+      "    std::lock_guard<std::mutex> lock(mutex_);\n"
+      "    std::pair<typename Calls::iterator, bool> call = calls_.insert(std::make_pair(key, Call()));\n"
+      "    call.first->second.push_back(std::move(handlers));\n"
+      "    return call.second;\n"
+      "  }\n"
+      "\n"
+      "  // Pass an update response of the call for the request with key to\n"
+      "  // every handler attached so far.\n"
+      "  void Update(const std::string& key, const ::google::protobuf::Message& update) {\n"
+      "    Call call;\n"
+      "    {\n"
+      "      std::lock_guard<std::mutex> lock(mutex_);\n"
+      "      typename Calls::iterator found = calls_.find(key);\n"
+      "      if (found == calls_.end()) {\n"
+      "        return;\n"
+      "      }\n"
+      "      call = found->second;\n"
+      "    }\n"
+      "    for (size_t i = 0; i < call.size(); ++i) {\n"
+      "      if (call[i]->update_handler) {\n"
+      "        call[i]->update_handler(update);\n"
+      "      }\n"
+      "    }\n"
+      "  }\n"
+      "\n"
+      "  // Pass the completion response of the call for the request with key\n"
+      "  // to every attached handler. Identical requests made afterwards\n"
+      "  // start a new call.\n"
+      "  void Complete(const std::string& key, const ::google::protobuf::Message& completion) {\n"
+      "    Call call;\n"
+      "    {\n"
+      "      std::lock_guard<std::mutex> lock(mutex_);\n"
+      "      typename Calls::iterator found = calls_.find(key);\n"
+      "      if (found == calls_.end()) {\n"
+      "        return;\n"
+      "      }\n"
+      "      call.swap(found->second);\n"
+      "      calls_.erase(found);\n"
+      "    }\n"
+      "    for (size_t i = 0; i < call.size(); ++i) {\n"
+      "      call[i]->completion_handler(completion);\n"
+      "    }\n"
+      "  }\n"
+      "\n"
+      " private:\n"
+      "  struct Handlers {\n"
+      "    Handlers(UpdateFunction update_handler, CompletionFunction completion_handler)\n"
+      "        : update_handler(std::move(update_handler)), completion_handler(std::move(completion_handler)) {}\n"
+      "\n"
+      "    UpdateFunction update_handler;\n"
+      "    CompletionFunction completion_handler;\n"
+      "  };\n"
+      "  typedef std::vector<std::shared_ptr<Handlers> > Call;\n"
+      "  typedef std::unordered_map<std::string, Call> Calls;\n"
+      "\n"
+      "  Calls calls_;\n"
+      "  std::mutex mutex_;\n"
+      "};\n"
+      "\n"
+      "}  // namespace ddprpc\n"
+      "}  // namespace dotdashpay\n"
+      "\n"
+      "#endif  // __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__\n"
+      "\n\n");
+}
+
+}  // namespace
+
+void PrintHeaderIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars,
+                 "#include <dotdashpay/common/function.h>\n"
+                 "#include <google/protobuf/arena.h>\n"
+                 "#include <google/protobuf/io/coded_stream.h>\n"
+                 "#include <google/protobuf/io/zero_copy_stream.h>\n"
+                 "#include <google/protobuf/message.h>\n"
+                 "#include <google/protobuf/message_lite.h>\n"
+                 "#include <climits>\n"
+                 "#include <cstddef>\n"
+                 "#include <cstdint>\n"
+                 "#include <cstring>\n"
+                 "#include <functional>\n"
+                 "#include <memory>\n"
+                 "#include <string>\n"
+                 "#include <utility>\n"
+                 "#include <vector>\n"
+                 "\n\n");
+
+  if (params.callback_style == CALLBACKSTYLE_INPLACE) {
+    PrintHeaderInplaceFunction(printer);
+  }
+  if (HasStreamingMethods(file)) {
+    PrintHeaderStreams(printer);
+  }
+  if (HasCacheableMethods(file) || HasIdempotentMethods(file)) {
+    PrintHeaderRequestKey(printer);
+  }
+  if (HasCacheableMethods(file)) {
+    PrintHeaderResponseCache(printer);
+  }
+  if (HasIdempotentMethods(file)) {
+    PrintHeaderSingleFlight(printer);
+  }
 
   if (!file->package().empty()) {
     std::vector<string> parts =
         ddprpc_generator::tokenize(file->package(), ".");
 
     for (auto part = parts.begin(); part != parts.end(); part++) {
-      temp.append("namespace ");
-      temp.append(*part);
-      temp.append(" {\n");
+      vars["part"] = *part;
+      printer->Print(vars, "namespace $part$ {\n");
     }
-    temp.append("\n");
+    printer->Print(vars, "\n");
   }
-
-  return temp;
 }
 
 void PrintHeaderClientMethodInterfaces(
     google::protobuf::io::Printer *printer,
     const google::protobuf::MethodDescriptor *method,
+    const ddprpc_generator::DescriptorIndex &index,
+    const Parameters &params,
     map<string, string> *vars) {  
   (*vars)["Method"] = method->name();
   (*vars)["Request"] = ddprpc_cpp_generator::ClassName(method->input_type(), true);
   (*vars)["Response"] = ddprpc_cpp_generator::ClassName(method->output_type(), true);
-  
-  if (method->options().ExtensionSize(dotdashpay::api::common::update_response) > 0) {
+
+  // Streaming methods exchange their requests and responses through
+  // streams instead of a single request and update callbacks.
+  switch (ddprpc_generator::GetMethodType(method)) {
+    case ddprpc_generator::METHODTYPE_SERVER_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(const $Request$& request, $arena_parameter$"
+          "::dotdashpay::ddprpc::StreamWriter<$Response$>* responses, "
+          "$CompletionHandler$ completion_handler) = 0;\n");
+      return;
+    case ddprpc_generator::METHODTYPE_CLIENT_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(::dotdashpay::ddprpc::StreamReader<$Request$>* requests, $arena_parameter$"
+          "$CompletionHandler$ completion_handler) = 0;\n");
+      return;
+    case ddprpc_generator::METHODTYPE_BIDI_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(::dotdashpay::ddprpc::StreamReader<$Request$>* requests, $arena_parameter$"
+          "::dotdashpay::ddprpc::StreamWriter<$Response$>* responses, "
+          "$CompletionHandler$ completion_handler) = 0;\n");
+      return;
+    case ddprpc_generator::METHODTYPE_NO_STREAMING:
+      break;
+  }
+
+  if (!index.GetUpdateResponses(method).empty()) {
     printer->Print(
         *vars,
-        "virtual void $Method$(const $Request$& request, "
-        "::dotdashpay::common::UpdateFunction update_handler, "
-        "::dotdashpay::common::CompletionFunction completion_handler) = 0;\n");
+        "virtual void $Method$(const $Request$& request, $arena_parameter$"
+        "$UpdateHandler$ update_handler, "
+        "$CompletionHandler$ completion_handler) = 0;\n");
+    if (params.callback_style == CALLBACKSTYLE_INPLACE) {
+      printer->Print(
+          *vars,
+          "virtual void $Method$($Request$&& request, $arena_parameter$"
+          "$UpdateHandler$ update_handler, "
+          "$CompletionHandler$ completion_handler) {\n"
+          "  $Method$(static_cast<const $Request$&>(request), $arena_argument$"
+          "std::move(update_handler), std::move(completion_handler));\n"
+          "}\n");
+    }
   } else {
     printer->Print(
         *vars,
-        "virtual void $Method$(const $Request$& request, "
-        "::dotdashpay::common::CompletionFunction completion_handler) = 0;\n");
+        "virtual void $Method$(const $Request$& request, $arena_parameter$"
+        "$CompletionHandler$ completion_handler) = 0;\n");
+    if (params.callback_style == CALLBACKSTYLE_INPLACE) {
+      printer->Print(
+          *vars,
+          "virtual void $Method$($Request$&& request, $arena_parameter$"
+          "$CompletionHandler$ completion_handler) {\n"
+          "  $Method$(static_cast<const $Request$&>(request), $arena_argument$std::move(completion_handler));\n"
+          "}\n");
+    }
+  }
+}
+
+void PrintHeaderMethodIds(google::protobuf::io::Printer *printer,
+                          const google::protobuf::ServiceDescriptor *service,
+                          map<string, string> *vars) {
+  (*vars)["method_count"] = as_string(service->method_count());
+
+  printer->Print(*vars,
+                 "// Identifies the methods of $Service$ in declaration order.\n"
+                 "enum class MethodId : uint32_t {\n");
+  printer->Indent();
+  for (int i = 0; i < service->method_count(); ++i) {
+    (*vars)["Method"] = service->method(i)->name();
+    (*vars)["method_id"] = as_string(i);
+    printer->Print(*vars, "k$Method$ = $method_id$,\n");
+  }
+  printer->Outdent();
+  printer->Print(*vars,
+                 "};\n"
+                 "static constexpr uint32_t kMethodCount = $method_count$;\n"
+                 "\n");
+}
+
+void PrintHeaderMethodLookup(google::protobuf::io::Printer *printer,
+                             const google::protobuf::ServiceDescriptor *service,
+                             map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// Set id to the id of the method called name. Returns false if\n"
+                 "// $Service$ has no such method.\n"
+                 "static bool FindMethodId(const char* name, MethodId* id) {\n");
+  printer->Indent();
+
+  if (service->method_count() == 0) {
+    printer->Print("(void)name;\n"
+                   "(void)id;\n"
+                   "return false;\n");
+    printer->Outdent();
+    printer->Print("}\n");
+    return;
+  }
+
+  // The table is sorted at generation time so the lookup is a binary
+  // search over constant data.
+  std::vector<string> names;
+  for (int i = 0; i < service->method_count(); ++i) {
+    names.push_back(service->method(i)->name());
+  }
+  std::sort(names.begin(), names.end());
+
+  printer->Print("struct MethodName {\n"
+                 "  const char* name;\n"
+                 "  MethodId id;\n"
+                 "};\n"
+                 "static constexpr MethodName kMethodNames[] = {\n");
+  printer->Indent();
+  for (auto name = names.begin(); name != names.end(); name++) {
+    (*vars)["Method"] = *name;
+    printer->Print(*vars, "{\"$Method$\", MethodId::k$Method$},\n");
+  }
+  printer->Outdent();
+  printer->Print("};\n"
+                 "\n"
+                 "size_t low = 0;\n"
+                 "size_t high = kMethodCount;\n"
+                 "while (low < high) {\n"
+                 "  const size_t middle = low + (high - low) / 2;\n"
+                 "  const int order = strcmp(name, kMethodNames[middle].name);\n"
+                 "  if (order == 0) {\n"
+                 "    *id = kMethodNames[middle].id;\n"
+                 "    return true;\n"
+                 "  }\n"
+                 "  if (order < 0) {\n"
+                 "    high = middle;\n"
+                 "  } else {\n"
+                 "    low = middle + 1;\n"
+                 "  }\n"
+                 "}\n"
+                 "return false;\n");
+  printer->Outdent();
+  printer->Print("}\n");
+}
+
+void PrintHeaderDispatch(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor *service,
+                         const ddprpc_generator::DescriptorIndex &index,
+                         const Parameters &params,
+                         map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// Parse the request for the method id from the size bytes at data\n"
+                 "// and call the method. Methods without update responses ignore\n"
+                 "// update_handler. Returns false if id is unknown, names a\n"
+                 "// streaming method or the request does not parse.\n");
+  if (params.use_arena) {
+    printer->Print("// The request is allocated on arena, or on the heap for the\n"
+                   "// duration of the call when arena is NULL.\n");
+  }
+  printer->Print(*vars,
+                 "bool Dispatch(MethodId id, const void* data, size_t size,\n");
+  if (params.use_arena) {
+    printer->Print("              ::google::protobuf::Arena* arena,\n");
+  }
+  printer->Print(*vars,
+                 "              $UpdateHandler$ update_handler,\n"
+                 "              $CompletionHandler$ completion_handler) {\n");
+  printer->Indent();
+  printer->Print("if (size > static_cast<size_t>(INT_MAX)) {\n"
+                 "  return false;\n"
+                 "}\n"
+                 "switch (id) {\n");
+  printer->Indent();
+
+  bool has_streaming_methods = false;
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetMethodType(method) != ddprpc_generator::METHODTYPE_NO_STREAMING) {
+      has_streaming_methods = true;
+      continue;
+    }
+    (*vars)["Method"] = method->name();
+    (*vars)["Request"] = ddprpc_cpp_generator::ClassName(method->input_type(), true);
+
+    if (params.use_arena) {
+      printer->Print(*vars,
+                     "case MethodId::k$Method$: {\n"
+                     "  $Request$* request = ::google::protobuf::Arena::CreateMessage<$Request$>(arena);\n"
+                     "  std::unique_ptr<$Request$> owned_request(arena == NULL ? request : NULL);\n"
+                     "  if (!request->ParseFromArray(data, static_cast<int>(size))) {\n"
+                     "    return false;\n"
+                     "  }\n");
+    } else {
+      printer->Print(*vars,
+                     "case MethodId::k$Method$: {\n"
+                     "  $Request$ request;\n"
+                     "  if (!request.ParseFromArray(data, static_cast<int>(size))) {\n"
+                     "    return false;\n"
+                     "  }\n");
+    }
+    if (!index.GetUpdateResponses(method).empty()) {
+      printer->Print(*vars,
+                     "  $Method$($request_argument$, $arena_argument$std::move(update_handler), std::move(completion_handler));\n");
+    } else {
+      printer->Print(*vars,
+                     "  $Method$($request_argument$, $arena_argument$std::move(completion_handler));\n");
+    }
+    printer->Print("  return true;\n"
+                   "}\n");
+  }
+
+  if (has_streaming_methods) {
+    printer->Print("default:\n"
+                   "  break;\n");
+  }
+  printer->Outdent();
+  printer->Print("}\n"
+                 "(void)update_handler;\n"
+                 "(void)completion_handler;\n"
+                 "return false;\n");
+  printer->Outdent();
+  printer->Print("}\n");
+}
+
+// Print the $Service$Codec that frames requests as
+// [method id][payload length][payload], with the id and length as
+// little-endian 32-bit integers.
+void PrintHeaderCodec(google::protobuf::io::Printer *printer,
+                      const google::protobuf::ServiceDescriptor *service,
+                      map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// Frames $Service$ requests as [method id][payload length][payload],\n"
+                 "// with the id and length as little-endian 32-bit integers. Frames\n"
+                 "// are written straight into the caller's buffer or stream and\n"
+                 "// decoded in place, so the payload is never copied. Streaming\n"
+                 "// methods cannot be framed.\n"
+                 "class $Service$Codec {\n"
+                 " public:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "static constexpr size_t kHeaderSize = 8;\n"
+                 "\n"
+                 "enum class DecodeStatus {\n"
+                 "  kOk,\n"
+                 "  // data does not hold a whole frame yet.\n"
+                 "  kIncomplete,\n"
+                 "  // The frame is for a method $Service$ does not have.\n"
+                 "  kUnknownMethod,\n"
+                 "};\n"
+                 "\n"
+                 "// A decoded frame. payload points into the decoded buffer.\n"
+                 "struct Frame {\n"
+                 "  $Service$::MethodId id;\n"
+                 "  const void* payload;\n"
+                 "  size_t payload_size;\n"
+                 "  size_t frame_size;\n"
+                 "};\n"
+                 "\n"
+                 "// Number of bytes the frame for request takes up.\n"
+                 "static size_t FrameSize(const ::google::protobuf::MessageLite& request) {\n"
+                 "  return kHeaderSize + request.ByteSizeLong();\n"
+                 "}\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetMethodType(method) != ddprpc_generator::METHODTYPE_NO_STREAMING) {
+      continue;
+    }
+    (*vars)["Method"] = method->name();
+    (*vars)["Request"] = ddprpc_cpp_generator::ClassName(method->input_type(), true);
+    printer->Print(*vars,
+                   "\n"
+                   "static size_t Encode$Method$(const $Request$& request, void* buffer, size_t capacity) {\n"
+                   "  return EncodeFrame($Service$::MethodId::k$Method$, request, buffer, capacity);\n"
+                   "}\n"
+                   "static bool Encode$Method$(const $Request$& request,\n"
+                   "                           ::google::protobuf::io::ZeroCopyOutputStream* output) {\n"
+                   "  return EncodeFrame($Service$::MethodId::k$Method$, request, output);\n"
+                   "}\n");
+  }
+
+  printer->Print(*vars,
+                 "\n"
+                 "// Serialize request as a frame for id into the capacity bytes at\n"
+                 "// buffer. The payload size is computed once and reused for the\n"
+                 "// serialization. Returns the size of the frame, or 0 if it does\n"
+                 "// not fit.\n"
+                 "static size_t EncodeFrame($Service$::MethodId id, const ::google::protobuf::MessageLite& request,\n"
+                 "                          void* buffer, size_t capacity) {\n"
+                 "  const size_t payload_size = request.ByteSizeLong();\n"
+                 "  if (payload_size > static_cast<size_t>(INT_MAX) || capacity < kHeaderSize + payload_size) {\n"
+                 "    return 0;\n"
+                 "  }\n"
+                 "  uint8_t* bytes = static_cast<uint8_t*>(buffer);\n"
+                 "  WriteHeader(id, payload_size, bytes);\n"
+                 "  request.SerializeWithCachedSizesToArray(bytes + kHeaderSize);\n"
+                 "  return kHeaderSize + payload_size;\n"
+                 "}\n"
+                 "\n"
+                 "// Serialize request as a frame for id into output. Returns false\n"
+                 "// if output fails.\n"
+                 "static bool EncodeFrame($Service$::MethodId id, const ::google::protobuf::MessageLite& request,\n"
+                 "                        ::google::protobuf::io::ZeroCopyOutputStream* output) {\n"
+                 "  const size_t payload_size = request.ByteSizeLong();\n"
+                 "  if (payload_size > static_cast<size_t>(INT_MAX)) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  uint8_t header[kHeaderSize];\n"
+                 "  WriteHeader(id, payload_size, header);\n"
+                 "  ::google::protobuf::io::CodedOutputStream coded_output(output);\n"
+                 "  coded_output.WriteRaw(header, kHeaderSize);\n"
+                 "  request.SerializeWithCachedSizes(&coded_output);\n"
+                 "  return !coded_output.HadError();\n"
+                 "}\n"
+                 "\n"
+                 "// Decode the frame at the start of the size bytes at data into\n"
+                 "// frame without copying its payload, which can be passed on to\n"
+                 "// $Service$::Dispatch.\n"
+                 "static DecodeStatus DecodeFrame(const void* data, size_t size, Frame* frame) {\n"
+                 "  const uint8_t* bytes = static_cast<const uint8_t*>(data);\n"
+                 "  if (size < kHeaderSize) {\n"
+                 "    return DecodeStatus::kIncomplete;\n"
+                 "  }\n"
+                 "  const uint32_t id = ReadLittleEndian32(bytes);\n"
+                 "  const size_t payload_size = ReadLittleEndian32(bytes + 4);\n"
+                 "  if (size - kHeaderSize < payload_size) {\n"
+                 "    return DecodeStatus::kIncomplete;\n"
+                 "  }\n"
+                 "  if (id >= $Service$::kMethodCount) {\n"
+                 "    return DecodeStatus::kUnknownMethod;\n"
+                 "  }\n"
+                 "  frame->id = static_cast<$Service$::MethodId>(id);\n"
+                 "  frame->payload = bytes + kHeaderSize;\n"
+                 "  frame->payload_size = payload_size;\n"
+                 "  frame->frame_size = kHeaderSize + payload_size;\n"
+                 "  return DecodeStatus::kOk;\n"
+                 "}\n");
+  printer->Outdent();
+  printer->Print("\n"
+                 " private:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "static void WriteHeader($Service$::MethodId id, size_t payload_size, uint8_t* header) {\n"
+                 "  WriteLittleEndian32(static_cast<uint32_t>(id), header);\n"
+                 "  WriteLittleEndian32(static_cast<uint32_t>(payload_size), header + 4);\n"
+                 "}\n"
+                 "\n"
+                 "static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {\n"
+                 "  bytes[0] = static_cast<uint8_t>(value);\n"
+                 "  bytes[1] = static_cast<uint8_t>(value >> 8);\n"
+                 "  bytes[2] = static_cast<uint8_t>(value >> 16);\n"
+                 "  bytes[3] = static_cast<uint8_t>(value >> 24);\n"
+                 "}\n"
+                 "\n"
+                 "static uint32_t ReadLittleEndian32(const uint8_t* bytes) {\n"
+                 "  return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |\n"
+                 "         (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);\n"
+                 "}\n");
+  printer->Outdent();
+  printer->Print("};\n");
+}
+
+// Print the $Service$Batch that collects several calls into one frame
+// and routes their responses back to each call's handlers.
+void PrintHeaderBatch(google::protobuf::io::Printer *printer,
+                      const google::protobuf::ServiceDescriptor *service,
+                      const ddprpc_generator::DescriptorIndex &index,
+                      map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// Collects several $Service$ calls and sends them as one frame:\n"
+                 "// [call count] followed by [call id][method id][length][payload]\n"
+                 "// for every call, all little-endian 32-bit integers. Call ids are\n"
+                 "// the position of the call in the batch; responses are routed\n"
+                 "// back to each call's handlers by id. Streaming methods cannot be\n"
+                 "// batched.\n"
+                 "class $Service$Batch {\n"
+                 " public:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "static constexpr size_t kHeaderSize = 4;\n"
+                 "static constexpr size_t kCallHeaderSize = 12;\n"
+                 "\n"
+                 "// A call decoded from a batch frame. payload points into the\n"
+                 "// decoded buffer.\n"
+                 "struct DecodedCall {\n"
+                 "  uint32_t call_id;\n"
+                 "  $Service$::MethodId id;\n"
+                 "  const void* payload;\n"
+                 "  size_t payload_size;\n"
+                 "};\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetMethodType(method) != ddprpc_generator::METHODTYPE_NO_STREAMING) {
+      continue;
+    }
+    (*vars)["Method"] = method->name();
+    (*vars)["Request"] = ddprpc_cpp_generator::ClassName(method->input_type(), true);
+    if (!index.GetUpdateResponses(method).empty()) {
+      printer->Print(*vars,
+                     "\n"
+                     "uint32_t $Method$(const $Request$& request, $UpdateHandler$ update_handler,\n"
+                     "                  $CompletionHandler$ completion_handler) {\n"
+                     "  return Add($Service$::MethodId::k$Method$, request, std::move(update_handler),\n"
+                     "             std::move(completion_handler));\n"
+                     "}\n");
+    } else {
+      printer->Print(*vars,
+                     "\n"
+                     "uint32_t $Method$(const $Request$& request, $CompletionHandler$ completion_handler) {\n"
+                     "  return Add($Service$::MethodId::k$Method$, request, $UpdateFunction$(),\n"
+                     "             std::move(completion_handler));\n"
+                     "}\n");
+    }
+  }
+
+  printer->Print(*vars,
+                 "\n"
+                 "size_t size() const { return calls_.size(); }\n"
+                 "\n"
+                 "// Number of bytes Encode writes.\n"
+                 "size_t FrameSize() const {\n"
+                 "  size_t frame_size = kHeaderSize;\n"
+                 "  for (size_t i = 0; i < calls_.size(); ++i) {\n"
+                 "    frame_size += kCallHeaderSize + calls_[i].payload.size();\n"
+                 "  }\n"
+                 "  return frame_size;\n"
+                 "}\n"
+                 "\n"
+                 "// Serialize every call into the capacity bytes at buffer. Returns\n"
+                 "// the size of the frame, or 0 if it does not fit.\n"
+                 "size_t Encode(void* buffer, size_t capacity) const {\n"
+                 "  const size_t frame_size = FrameSize();\n"
+                 "  if (capacity < frame_size) {\n"
+                 "    return 0;\n"
+                 "  }\n"
+                 "  uint8_t* bytes = static_cast<uint8_t*>(buffer);\n"
+                 "  WriteLittleEndian32(static_cast<uint32_t>(calls_.size()), bytes);\n"
+                 "  bytes += kHeaderSize;\n"
+                 "  for (size_t i = 0; i < calls_.size(); ++i) {\n"
+                 "    WriteLittleEndian32(static_cast<uint32_t>(i), bytes);\n"
+                 "    WriteLittleEndian32(static_cast<uint32_t>(calls_[i].id), bytes + 4);\n"
+                 "    WriteLittleEndian32(static_cast<uint32_t>(calls_[i].payload.size()), bytes + 8);\n"
+                 "    memcpy(bytes + kCallHeaderSize, calls_[i].payload.data(), calls_[i].payload.size());\n"
+                 "    bytes += kCallHeaderSize + calls_[i].payload.size();\n"
+                 "  }\n"
+                 "  return frame_size;\n"
+                 "}\n"
+                 "\n"
+                 "// Pass an update response for call_id to its update handler.\n"
+                 "// Returns false if there is no such call or it has no update\n"
+                 "// handler.\n"
+                 "bool Update(uint32_t call_id, const ::google::protobuf::Message& response) {\n"
+                 "  if (call_id >= calls_.size() || !calls_[call_id].update_handler) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  calls_[call_id].update_handler(response);\n"
+                 "  return true;\n"
+                 "}\n"
+                 "\n"
+                 "// Pass the completion response for call_id to its completion\n"
+                 "// handler. Returns false if there is no such call or it has\n"
+                 "// already completed.\n"
+                 "bool Complete(uint32_t call_id, const ::google::protobuf::Message& response) {\n"
+                 "  if (call_id >= calls_.size() || !calls_[call_id].completion_handler) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  $CompletionFunction$ completion_handler(std::move(calls_[call_id].completion_handler));\n"
+                 "  calls_[call_id].completion_handler = nullptr;\n"
+                 "  calls_[call_id].update_handler = nullptr;\n"
+                 "  completion_handler(response);\n"
+                 "  return true;\n"
+                 "}\n"
+                 "\n"
+                 "// Decode the batch frame in the size bytes at data into calls,\n"
+                 "// without copying the payloads, so each call can be passed on to\n"
+                 "// $Service$::Dispatch. Returns false if the frame is truncated or\n"
+                 "// names a method $Service$ does not have.\n"
+                 "static bool Decode(const void* data, size_t size, std::vector<DecodedCall>* calls) {\n"
+                 "  const uint8_t* bytes = static_cast<const uint8_t*>(data);\n"
+                 "  if (size < kHeaderSize) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  const uint32_t call_count = ReadLittleEndian32(bytes);\n"
+                 "  bytes += kHeaderSize;\n"
+                 "  size -= kHeaderSize;\n"
+                 "  for (uint32_t i = 0; i < call_count; ++i) {\n"
+                 "    if (size < kCallHeaderSize) {\n"
+                 "      return false;\n"
+                 "    }\n"
+                 "    DecodedCall call;\n"
+                 "    call.call_id = ReadLittleEndian32(bytes);\n"
+                 "    const uint32_t id = ReadLittleEndian32(bytes + 4);\n"
+                 "    call.payload_size = ReadLittleEndian32(bytes + 8);\n"
+                 "    if (id >= $Service$::kMethodCount || size - kCallHeaderSize < call.payload_size) {\n"
+                 "      return false;\n"
+                 "    }\n"
+                 "    call.id = static_cast<$Service$::MethodId>(id);\n"
+                 "    call.payload = bytes + kCallHeaderSize;\n"
+                 "    calls->push_back(call);\n"
+                 "    bytes += kCallHeaderSize + call.payload_size;\n"
+                 "    size -= kCallHeaderSize + call.payload_size;\n"
+                 "  }\n"
+                 "  return true;\n"
+                 "}\n");
+  printer->Outdent();
+  printer->Print("\n"
+                 " private:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "struct Call {\n"
+                 "  $Service$::MethodId id;\n"
+                 "  std::string payload;\n"
+                 "  $UpdateFunction$ update_handler;\n"
+                 "  $CompletionFunction$ completion_handler;\n"
+                 "};\n"
+                 "\n"
+                 "uint32_t Add($Service$::MethodId id, const ::google::protobuf::MessageLite& request,\n"
+                 "             $UpdateFunction$ update_handler, $CompletionFunction$ completion_handler) {\n"
+                 "  calls_.push_back(Call());\n"
+                 "  Call& call = calls_.back();\n"
+                 "  call.id = id;\n"
+                 "  request.SerializeToString(&call.payload);\n"
+                 "  call.update_handler = std::move(update_handler);\n"
+                 "  call.completion_handler = std::move(completion_handler);\n"
+                 "  return static_cast<uint32_t>(calls_.size() - 1);\n"
+                 "}\n"
+                 "\n"
+                 "static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {\n"
+                 "  bytes[0] = static_cast<uint8_t>(value);\n"
+                 "  bytes[1] = static_cast<uint8_t>(value >> 8);\n"
+                 "  bytes[2] = static_cast<uint8_t>(value >> 16);\n"
+                 "  bytes[3] = static_cast<uint8_t>(value >> 24);\n"
+                 "}\n"
+                 "\n"
+                 "static uint32_t ReadLittleEndian32(const uint8_t* bytes) {\n"
+                 "  return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |\n"
+                 "         (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);\n"
+                 "}\n"
+                 "\n"
+                 "std::vector<Call> calls_;\n");
+  printer->Outdent();
+  printer->Print("};\n");
+}
+
+// Print the override of method in a class that wraps a $Service$ in
+// service_, up to the opening brace of its body, and set $method$ and
+// $update_argument$ for the body. Streaming methods are instead printed
+// whole, forwarding to service_, and false is returned.
+bool PrintHeaderWrapperMethodPrologue(google::protobuf::io::Printer *printer,
+                                      const google::protobuf::MethodDescriptor *method,
+                                      const ddprpc_generator::DescriptorIndex &index,
+                                      const Parameters &params,
+                                      map<string, string> *vars) {
+  (*vars)["Method"] = method->name();
+  (*vars)["method"] = ddprpc_generator::UpperCamelToLowerUnderscore(method->name());
+  (*vars)["Request"] = ddprpc_cpp_generator::ClassName(method->input_type(), true);
+  (*vars)["Response"] = ddprpc_cpp_generator::ClassName(method->output_type(), true);
+
+  switch (ddprpc_generator::GetMethodType(method)) {
+    case ddprpc_generator::METHODTYPE_SERVER_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(const $Request$& request, $arena_parameter$"
+          "::dotdashpay::ddprpc::StreamWriter<$Response$>* responses, "
+          "$CompletionHandler$ completion_handler) {\n"
+          "  service_->$Method$(request, $arena_argument$responses, std::move(completion_handler));\n"
+          "}\n");
+      return false;
+    case ddprpc_generator::METHODTYPE_CLIENT_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(::dotdashpay::ddprpc::StreamReader<$Request$>* requests, $arena_parameter$"
+          "$CompletionHandler$ completion_handler) {\n"
+          "  service_->$Method$(requests, $arena_argument$std::move(completion_handler));\n"
+          "}\n");
+      return false;
+    case ddprpc_generator::METHODTYPE_BIDI_STREAMING:
+      printer->Print(
+          *vars,
+          "virtual void $Method$(::dotdashpay::ddprpc::StreamReader<$Request$>* requests, $arena_parameter$"
+          "::dotdashpay::ddprpc::StreamWriter<$Response$>* responses, "
+          "$CompletionHandler$ completion_handler) {\n"
+          "  service_->$Method$(requests, $arena_argument$responses, std::move(completion_handler));\n"
+          "}\n");
+      return false;
+    case ddprpc_generator::METHODTYPE_NO_STREAMING:
+      break;
+  }
+
+  if (params.callback_style == CALLBACKSTYLE_INPLACE) {
+    // Keep the rvalue overload of $Service$ visible.
+    printer->Print(*vars, "using $Service$::$Method$;\n");
+  }
+
+  if (!index.GetUpdateResponses(method).empty()) {
+    printer->Print(*vars,
+                   "virtual void $Method$(const $Request$& request, $arena_parameter$"
+                   "$UpdateHandler$ update_handler, $CompletionHandler$ completion_handler) {\n");
+    (*vars)["update_argument"] = "std::move(update_handler), ";
+  } else {
+    printer->Print(*vars,
+                   "virtual void $Method$(const $Request$& request, $arena_parameter$"
+                   "$CompletionHandler$ completion_handler) {\n");
+    (*vars)["update_argument"] = "";
+  }
+  return true;
+}
+
+// Print Caching$Service$, which completes repeated calls to the
+// cacheable methods of service locally and forwards everything else.
+void PrintHeaderCachingService(google::protobuf::io::Printer *printer,
+                               const google::protobuf::ServiceDescriptor *service,
+                               const ddprpc_generator::DescriptorIndex &index,
+                               const Parameters &params,
+                               map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// A $Service$ that completes calls to its cacheable methods from\n"
+                 "// the completion responses of earlier identical requests, while\n"
+                 "// they are younger than the method's cache_ttl_ms, and forwards\n"
+                 "// every other call to service. Calls completed from the cache get\n"
+                 "// no update responses. At most capacity responses are cached per\n"
+                 "// method.\n"
+                 "class Caching$Service$ : public $Service$ {\n"
+                 " public:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "explicit Caching$Service$($Service$* service, size_t capacity = 64)\n"
+                 "    : service_(service)");
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetCacheTtlMs(method) == 0) {
+      continue;
+    }
+    (*vars)["method"] = ddprpc_generator::UpperCamelToLowerUnderscore(method->name());
+    (*vars)["ttl"] = as_string(ddprpc_generator::GetCacheTtlMs(method));
+    printer->Print(*vars,
+                   ",\n"
+                   "      $method$_cache_(capacity, std::chrono::milliseconds($ttl$))");
+  }
+  printer->Print(" {}\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    printer->Print("\n");
+    if (!PrintHeaderWrapperMethodPrologue(printer, method, index, params, vars)) {
+      continue;
+    }
+    printer->Indent();
+    if (ddprpc_generator::GetCacheTtlMs(method) == 0) {
+      printer->Print(*vars,
+                     "service_->$Method$(request, $arena_argument$$update_argument$std::move(completion_handler));\n");
+    } else {
+      printer->Print(*vars,
+                     "std::string key = ::dotdashpay::ddprpc::RequestKey(request);\n"
+                     "std::shared_ptr<const ::google::protobuf::Message> response = $method$_cache_.Find(key);\n"
+                     "if (response) {\n"
+                     "  completion_handler(*response);\n"
+                     "  return;\n"
+                     "}\n"
+                     "std::shared_ptr<PendingCall> call(\n"
+                     "    new PendingCall(&$method$_cache_, std::move(key), std::move(completion_handler)));\n"
+                     "service_->$Method$(request, $arena_argument$$update_argument$"
+                     "[call](const ::google::protobuf::Message& completion) {\n"
+                     "  call->Complete(completion);\n"
+                     "});\n");
+    }
+    printer->Outdent();
+    printer->Print("}\n");
+  }
+
+  printer->Print("\n"
+                 "// Drop every cached response.\n"
+                 "void Clear() {\n");
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetCacheTtlMs(method) > 0) {
+      (*vars)["method"] = ddprpc_generator::UpperCamelToLowerUnderscore(method->name());
+      printer->Print(*vars, "  $method$_cache_.Clear();\n");
+    }
   }
   printer->Print("}\n");
+
+  printer->Outdent();
+  printer->Print("\n"
+                 " private:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "// A forwarded call to a cacheable method, which caches its\n"
+                 "// completion response before passing it on.\n"
+                 "struct PendingCall {\n"
+                 "  PendingCall(::dotdashpay::ddprpc::ResponseCache* cache, std::string key,\n"
+                 "              $CompletionFunction$ completion_handler)\n"
+                 "      : cache(cache), key(std::move(key)), completion_handler(std::move(completion_handler)) {}\n"
+                 "\n"
+                 "  void Complete(const ::google::protobuf::Message& completion) {\n"
+                 "    cache->Insert(key, completion);\n"
+                 "    completion_handler(completion);\n"
+                 "  }\n"
+                 "\n"
+                 "  ::dotdashpay::ddprpc::ResponseCache* cache;\n"
+                 "  std::string key;\n"
+                 "  $CompletionFunction$ completion_handler;\n"
+                 "};\n"
+                 "\n"
+                 "$Service$* service_;\n");
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::GetCacheTtlMs(method) > 0) {
+      (*vars)["method"] = ddprpc_generator::UpperCamelToLowerUnderscore(method->name());
+      printer->Print(*vars, "::dotdashpay::ddprpc::ResponseCache $method$_cache_;\n");
+    }
+  }
+  printer->Outdent();
+  printer->Print("};\n");
+}
+
+// Print Coalescing$Service$, which sends identical concurrent calls to
+// the idempotent methods of service once.
+void PrintHeaderCoalescingService(google::protobuf::io::Printer *printer,
+                                  const google::protobuf::ServiceDescriptor *service,
+                                  const ddprpc_generator::DescriptorIndex &index,
+                                  const Parameters &params,
+                                  map<string, string> *vars) {
+  printer->Print(*vars,
+                 "\n"
+                 "// A $Service$ that sends a call to one of its idempotent methods\n"
+                 "// only if no byte-identical request is in flight; otherwise the\n"
+                 "// call shares the responses of the pending one, receiving the\n"
+                 "// updates from when it joined on. Every other call is forwarded to\n"
+                 "// service.\n"
+                 "class Coalescing$Service$ : public $Service$ {\n"
+                 " public:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "explicit Coalescing$Service$($Service$* service) : service_(service) {}\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    printer->Print("\n");
+    if (!PrintHeaderWrapperMethodPrologue(printer, method, index, params, vars)) {
+      continue;
+    }
+    printer->Indent();
+    if (!ddprpc_generator::IsIdempotent(method)) {
+      printer->Print(*vars,
+                     "service_->$Method$(request, $arena_argument$$update_argument$std::move(completion_handler));\n");
+    } else {
+      (*vars)["update_handler"] =
+          index.GetUpdateResponses(method).empty() ? (*vars)["UpdateFunction"] + "()" : "std::move(update_handler)";
+      printer->Print(*vars,
+                     "const std::string key = ::dotdashpay::ddprpc::RequestKey(request);\n"
+                     "if (!$method$_calls_.Join(key, $update_handler$, std::move(completion_handler))) {\n"
+                     "  return;\n"
+                     "}\n"
+                     "Calls* calls = &$method$_calls_;\n"
+                     "std::shared_ptr<const std::string> shared_key(new std::string(key));\n");
+      if (!index.GetUpdateResponses(method).empty()) {
+        printer->Print(*vars,
+                       "service_->$Method$(request, $arena_argument$"
+                       "[calls, shared_key](const ::google::protobuf::Message& update) {\n"
+                       "  calls->Update(*shared_key, update);\n"
+                       "}, [calls, shared_key](const ::google::protobuf::Message& completion) {\n"
+                       "  calls->Complete(*shared_key, completion);\n"
+                       "});\n");
+      } else {
+        printer->Print(*vars,
+                       "service_->$Method$(request, $arena_argument$"
+                       "[calls, shared_key](const ::google::protobuf::Message& completion) {\n"
+                       "  calls->Complete(*shared_key, completion);\n"
+                       "});\n");
+      }
+    }
+    printer->Outdent();
+    printer->Print("}\n");
+  }
+
+  printer->Outdent();
+  printer->Print("\n"
+                 " private:\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "typedef ::dotdashpay::ddprpc::SingleFlight<$UpdateFunction$, $CompletionFunction$> Calls;\n"
+                 "\n"
+                 "$Service$* service_;\n");
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor *method = service->method(i);
+    if (ddprpc_generator::IsIdempotent(method)) {
+      (*vars)["method"] = ddprpc_generator::UpperCamelToLowerUnderscore(method->name());
+      printer->Print(*vars, "Calls $method$_calls_;\n");
+    }
+  }
+  printer->Outdent();
+  printer->Print("};\n");
 }
 
 void PrintHeaderService(google::protobuf::io::Printer *printer,
                         const google::protobuf::ServiceDescriptor *service,
+                        const ddprpc_generator::DescriptorIndex &index,
+                        const Parameters &params,
                         map<string, string> *vars) {
   (*vars)["Service"] = service->name();
   
@@ -157,67 +1485,362 @@ void PrintHeaderService(google::protobuf::io::Printer *printer,
                  " public:\n");
 
   printer->Indent();
+  PrintHeaderMethodIds(printer, service, vars);
+  // Implementations, including Caching$Service$ and Coalescing$Service$,
+  // are used through $Service$ pointers and may be deleted through them.
+  printer->Print(*vars, "virtual ~$Service$() {}\n\n");
   for (int i = 0; i < service->method_count(); ++i) {
-    PrintHeaderClientMethodInterfaces(printer, service->method(i), vars);
+    PrintHeaderClientMethodInterfaces(printer, service->method(i), index, params, vars);
   }
+  PrintHeaderMethodLookup(printer, service, vars);
+  PrintHeaderDispatch(printer, service, index, params, vars);
   printer->Outdent();
   printer->Print("};\n");
 
+  PrintHeaderCodec(printer, service, vars);
+  PrintHeaderBatch(printer, service, index, vars);
+  if (ddprpc_generator::HasCacheableMethods(service)) {
+    PrintHeaderCachingService(printer, service, index, params, vars);
+  }
+  if (ddprpc_generator::HasIdempotentMethods(service)) {
+    PrintHeaderCoalescingService(printer, service, index, params, vars);
+  }
 }
 
-string GetHeaderServices(const google::protobuf::FileDescriptor *file,
-                               const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
+// Print the response registry of file: a <File>Responses struct with a
+// Tag for every response used by the services of file, the tag lookup,
+// ParseResponse and a Router that calls typed handlers. The struct keeps
+// the registries of files that share a package apart.
+void PrintHeaderResponseRegistry(google::protobuf::io::Printer *printer,
+                                 const google::protobuf::FileDescriptor *file,
+                                 const ddprpc_generator::DescriptorIndex &index,
+                                 map<string, string> *vars) {
+  // The set is sorted, so the tags are in name order and the lookup
+  // table below can be binary searched.
+  const std::set<string> responses = index.GetUniqueResponses(file);
+  if (responses.empty()) {
+    return;
+  }
+  (*vars)["response_count"] = as_string(responses.size());
+  (*vars)["Registry"] = ddprpc_generator::FileNameInUpperCamel(file, false) + "Responses";
 
-    if (!params.services_namespace.empty()) {
-      vars["services_namespace"] = params.services_namespace;
-      printer.Print(vars, "\nnamespace $services_namespace$ {\n\n");
-    }
+  printer->Print(*vars,
+                 "// Registry of every update and completion response of the services\n"
+                 "// in $filename$.\n"
+                 "struct $Registry$ {\n");
+  printer->Indent();
+  printer->Print(*vars,
+                 "// Tags are assigned in name order, so they are only stable between\n"
+                 "// peers built from the same API version.\n"
+                 "enum class Tag : uint32_t {\n");
+  printer->Indent();
+  int tag = 0;
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["Response"] = *response;
+    (*vars)["response_tag"] = as_string(tag++);
+    printer->Print(*vars, "k$Response$ = $response_tag$,\n");
+  }
+  printer->Outdent();
+  printer->Print(*vars,
+                 "};\n"
+                 "static constexpr uint32_t kTagCount = $response_count$;\n"
+                 "\n"
+                 "// Set tag to the tag of the response message called name. Returns\n"
+                 "// false if no service in the file uses such a response.\n"
+                 "static bool FindTag(const char* name, Tag* tag) {\n"
+                 "  struct ResponseName {\n"
+                 "    const char* name;\n"
+                 "    Tag tag;\n"
+                 "  };\n"
+                 "  static constexpr ResponseName kResponseNames[] = {\n");
+  printer->Indent();
+  printer->Indent();
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["Response"] = *response;
+    printer->Print(*vars, "{\"$Response$\", Tag::k$Response$},\n");
+  }
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print("  };\n"
+                 "\n"
+                 "  size_t low = 0;\n"
+                 "  size_t high = kTagCount;\n"
+                 "  while (low < high) {\n"
+                 "    const size_t middle = low + (high - low) / 2;\n"
+                 "    const int order = strcmp(name, kResponseNames[middle].name);\n"
+                 "    if (order == 0) {\n"
+                 "      *tag = kResponseNames[middle].tag;\n"
+                 "      return true;\n"
+                 "    }\n"
+                 "    if (order < 0) {\n"
+                 "      high = middle;\n"
+                 "    } else {\n"
+                 "      low = middle + 1;\n"
+                 "    }\n"
+                 "  }\n"
+                 "  return false;\n"
+                 "}\n"
+                 "\n");
 
-    for (int i = 0; i < file->service_count(); ++i) {
-      PrintHeaderService(&printer, file->service(i), &vars);
-      printer.Print("\n");
-    }
+  printer->Print("// Parse the size bytes at data as the response identified by tag.\n"
+                 "// The response is allocated on arena, or on the heap and owned by\n"
+                 "// the caller when arena is NULL. Returns NULL if tag is unknown or\n"
+                 "// the response does not parse.\n"
+                 "static ::google::protobuf::Message* ParseResponse(Tag tag, const void* data, size_t size,\n"
+                 "                                                  ::google::protobuf::Arena* arena) {\n"
+                 "  if (size > static_cast<size_t>(INT_MAX)) {\n"
+                 "    return NULL;\n"
+                 "  }\n"
+                 "  ::google::protobuf::Message* response = NULL;\n"
+                 "  switch (tag) {\n");
+  printer->Indent();
+  printer->Indent();
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["Response"] = *response;
+    (*vars)["ResponseClass"] = ClassName(index.FindMessageByName(file, *response), true);
+    printer->Print(*vars,
+                   "case Tag::k$Response$:\n"
+                   "  response = ::google::protobuf::Arena::CreateMessage<$ResponseClass$>(arena);\n"
+                   "  break;\n");
+  }
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print("  }\n"
+                 "  if (response != NULL && !response->ParseFromArray(data, static_cast<int>(size))) {\n"
+                 "    if (arena == NULL) {\n"
+                 "      delete response;\n"
+                 "    }\n"
+                 "    return NULL;\n"
+                 "  }\n"
+                 "  return response;\n"
+                 "}\n"
+                 "\n");
 
-    if (!params.services_namespace.empty()) {
-      printer.Print(vars, "}  // namespace $services_namespace$\n\n");
-    }
+  printer->Print("// Routes tagged responses to a typed handler per response type.\n"
+                 "// Responses without a handler are not parsed.\n"
+                 "class Router {\n"
+                 " public:\n");
+  printer->Indent();
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["Response"] = *response;
+    (*vars)["ResponseClass"] = ClassName(index.FindMessageByName(file, *response), true);
+    (*vars)["response_handler"] = ddprpc_generator::UpperCamelToLowerUnderscore(*response) + "_handler_";
+    printer->Print(*vars,
+                   "void On$Response$(std::function<void(const $ResponseClass$&)> handler) {\n"
+                   "  $response_handler$ = std::move(handler);\n"
+                   "}\n");
+  }
+  printer->Print("\n"
+                 "// Parse the response identified by tag and pass it to its\n"
+                 "// handler. Returns false if tag is unknown or the response does\n"
+                 "// not parse.\n"
+                 "bool Route(Tag tag, const void* data, size_t size,\n"
+                 "           ::google::protobuf::Arena* arena = NULL) const {\n"
+                 "  switch (tag) {\n");
+  printer->Indent();
+  printer->Indent();
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["Response"] = *response;
+    (*vars)["response_handler"] = ddprpc_generator::UpperCamelToLowerUnderscore(*response) + "_handler_";
+    printer->Print(*vars,
+                   "case Tag::k$Response$:\n"
+                   "  return Route($response_handler$, data, size, arena);\n");
+  }
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print("  }\n"
+                 "  return false;\n"
+                 "}\n");
+  printer->Outdent();
+  printer->Print("\n"
+                 " private:\n");
+  printer->Indent();
+  printer->Print("template <class Response>\n"
+                 "static bool Route(const std::function<void(const Response&)>& handler,\n"
+                 "                  const void* data, size_t size, ::google::protobuf::Arena* arena) {\n"
+                 "  if (!handler) {\n"
+                 "    return true;\n"
+                 "  }\n"
+                 "  if (size > static_cast<size_t>(INT_MAX)) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  Response* response = ::google::protobuf::Arena::CreateMessage<Response>(arena);\n"
+                 "  std::unique_ptr<Response> owned_response(arena == NULL ? response : NULL);\n"
+                 "  if (!response->ParseFromArray(data, static_cast<int>(size))) {\n"
+                 "    return false;\n"
+                 "  }\n"
+                 "  handler(*response);\n"
+                 "  return true;\n"
+                 "}\n"
+                 "\n");
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    (*vars)["ResponseClass"] = ClassName(index.FindMessageByName(file, *response), true);
+    (*vars)["response_handler"] = ddprpc_generator::UpperCamelToLowerUnderscore(*response) + "_handler_";
+    printer->Print(*vars, "std::function<void(const $ResponseClass$&)> $response_handler$;\n");
+  }
+  printer->Outdent();
+  printer->Print("};\n");
+  printer->Outdent();
+  printer->Print("};\n"
+                 "\n");
+}
+
+void PrintHeaderServices(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const ddprpc_generator::DescriptorIndex &index,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  if (!params.services_namespace.empty()) {
+    vars["services_namespace"] = params.services_namespace;
+    printer->Print(vars, "\nnamespace $services_namespace$ {\n\n");
+  }
+
+  if (params.use_arena) {
+    vars["arena_parameter"] = "::google::protobuf::Arena* arena, ";
+    vars["arena_argument"] = "arena, ";
+  } else {
+    vars["arena_parameter"] = "";
+    vars["arena_argument"] = "";
+  }
+
+  if (params.callback_style == CALLBACKSTYLE_INPLACE) {
+    // Handlers are moved in; requests parsed by Dispatch are moved into
+    // the rvalue overloads so implementations can take them over.
+    vars["UpdateFunction"] = "::dotdashpay::ddprpc::InplaceUpdateFunction";
+    vars["CompletionFunction"] = "::dotdashpay::ddprpc::InplaceCompletionFunction";
+    vars["UpdateHandler"] = vars["UpdateFunction"] + "&&";
+    vars["CompletionHandler"] = vars["CompletionFunction"] + "&&";
+    vars["request_argument"] = params.use_arena ? "*request" : "std::move(request)";
+  } else {
+    vars["UpdateFunction"] = "::dotdashpay::common::UpdateFunction";
+    vars["CompletionFunction"] = "::dotdashpay::common::CompletionFunction";
+    vars["UpdateHandler"] = vars["UpdateFunction"];
+    vars["CompletionHandler"] = vars["CompletionFunction"];
+    vars["request_argument"] = params.use_arena ? "*request" : "request";
+  }
+
+  vars["filename"] = file->name();
+  PrintHeaderResponseRegistry(printer, file, index, &vars);
+
+  for (int i = 0; i < file->service_count(); ++i) {
+    PrintHeaderService(printer, file->service(i), index, params, &vars);
+    printer->Print("\n");
+  }
+
+  if (!params.services_namespace.empty()) {
+    printer->Print(vars, "}  // namespace $services_namespace$\n\n");
   }
-  return output;
 }
 
-string GetHeaderEpilogue(const google::protobuf::FileDescriptor *file,
-                               const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
+void PrintHeaderEpilogue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  vars["filename"] = file->name();
+  vars["filename_identifier"] = FilenameIdentifier(file->name());
 
-    vars["filename"] = file->name();
-    vars["filename_identifier"] = FilenameIdentifier(file->name());
+  if (!file->package().empty()) {
+    std::vector<string> parts =
+        ddprpc_generator::tokenize(file->package(), ".");
+
+    for (auto part = parts.rbegin(); part != parts.rend(); part++) {
+      vars["part"] = *part;
+      printer->Print(vars, "}  // namespace $part$\n");
+    }
+    printer->Print(vars, "\n");
+  }
+
+  printer->Print(vars, "\n");
+  printer->Print(vars, "#endif  // __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
+}
+
+bool SetParameter(const string &key, const string &value,
+                  Parameters *params) {
+  if (key == "services_namespace") {
+    params->services_namespace = value;
+    return true;
+  }
+  if (key == "use_arena") {
+    if (value != "true" && value != "false") {
+      return false;
+    }
+    params->use_arena = value == "true";
+    return true;
+  }
+  if (key == "callback_style") {
+    if (value == "function") {
+      params->callback_style = CALLBACKSTYLE_FUNCTION;
+    } else if (value == "inplace") {
+      params->callback_style = CALLBACKSTYLE_INPLACE;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
 
-    if (!file->package().empty()) {
-      std::vector<string> parts =
-          ddprpc_generator::tokenize(file->package(), ".");
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const ddprpc_generator::DescriptorIndex &index,
+                   const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context,
+                   string *error) {
+  if (file->options().cc_generic_services()) {
+    *error =
+        "ddprpc compiler plugin does not work with generic "
+        "services. To generate cpp APIs, please set \""
+        "cc_generic_service = false\".";
+    return false;
+  }
 
-      for (auto part = parts.rbegin(); part != parts.rend(); part++) {
-        vars["part"] = *part;
-        printer.Print(vars, "}  // namespace $part$\n");
+  if (params.use_arena) {
+    std::set<const google::protobuf::FileDescriptor*> message_files;
+    message_files.insert(file);
+    for (int i = 0; i < file->service_count(); ++i) {
+      for (int j = 0; j < file->service(i)->method_count(); ++j) {
+        message_files.insert(file->service(i)->method(j)->input_type()->file());
       }
-      printer.Print(vars, "\n");
     }
+    const std::set<string> responses = index.GetUniqueResponses(file);
+    for (auto response = responses.begin(); response != responses.end(); response++) {
+      const google::protobuf::Descriptor *message = index.FindMessageByName(file, *response);
+      if (message != NULL) {
+        message_files.insert(message->file());
+      }
+    }
+    for (auto message_file = message_files.begin(); message_file != message_files.end(); message_file++) {
+      if (!(*message_file)->options().cc_enable_arenas()) {
+        *error = "use_arena=true requires arena allocation, but " + (*message_file)->name() +
+                 " sets \"cc_enable_arenas = false\".";
+        return false;
+      }
+    }
+  }
 
-    printer.Print(vars, "\n");
-    printer.Print(vars, "#endif  // __DOTDASHPAY_$filename_identifier$__INCLUDED\n");
+  // The response registry refers to every response by its C++ class.
+  const std::set<string> responses = index.GetUniqueResponses(file);
+  for (auto response = responses.begin(); response != responses.end(); response++) {
+    if (index.FindMessageByName(file, *response) == NULL) {
+      *error = "Unknown response type [" + *response + "]";
+      return false;
+    }
   }
-  return output;
+
+  string file_name = ddprpc_generator::StripProto(file->name());
+
+  // Print straight into the stream protoc hands us so the header is never
+  // held in an intermediate string.
+  std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(
+      context->Open(file_name + ".ddprpc.pb.h"));
+  google::protobuf::io::Printer printer(header_output.get(), '$');
+  PrintHeaderPrologue(&printer, file, params);
+  PrintHeaderIncludes(&printer, file, params);
+  PrintHeaderServices(&printer, file, index, params);
+  PrintHeaderEpilogue(&printer, file, params);
+
+  return true;
 }
 
 }  // namespace ddprpc_cpp_generator
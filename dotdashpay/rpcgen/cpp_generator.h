@@ -37,32 +37,73 @@
 
 #include "generator_helpers.h"
 
+#include <google/protobuf/compiler/code_generator.h>
 #include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/printer.h>
 #include <string>
 
 namespace ddprpc_cpp_generator {
 
+// How the generated interfaces take their update and completion
+// handlers.
+enum CallbackStyle {
+  // By value, as ::dotdashpay::common::UpdateFunction and
+  // CompletionFunction.
+  CALLBACKSTYLE_FUNCTION,
+  // By rvalue reference, as move-only function wrappers that keep the
+  // callable in a fixed inline buffer and so never allocate.
+  CALLBACKSTYLE_INPLACE
+};
+
 // Contains all the parameters that are parsed from the command line.
 struct Parameters {
+  Parameters() : callback_style(CALLBACKSTYLE_FUNCTION), use_arena(false) {}
+
   // Puts the service into a namespace
   std::string services_namespace;
-};
-
-// Return the prologue of the generated header file.
-std::string GetHeaderPrologue(const google::protobuf::FileDescriptor *file,
-                              const Parameters &params);
 
-// Return the includes needed for generated header file.
-std::string GetHeaderIncludes(const google::protobuf::FileDescriptor *file,
-                              const Parameters &params);
+  // Set with callback_style=function|inplace
+  CallbackStyle callback_style;
 
-// Return the epilogue of the generated header file.
-std::string GetHeaderEpilogue(const google::protobuf::FileDescriptor *file,
-                              const Parameters &params);
+  // Set with use_arena=true. Methods and Dispatch take the
+  // google::protobuf::Arena that requests and responses are allocated
+  // on.
+  bool use_arena;
+};
 
-// Return the services for generated header file.
-std::string GetHeaderServices(const google::protobuf::FileDescriptor *file,
-                              const Parameters &params);
+// Set the parameter key to value. Returns false if key is unknown.
+bool SetParameter(const std::string &key, const std::string &value,
+                  Parameters *params);
+
+// Generate all of the output files for file into context. The file
+// must already have passed ddprpc_generator::ValidateFile and be
+// covered by index.
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const ddprpc_generator::DescriptorIndex &index,
+                   const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context,
+                   std::string *error);
+
+// Print the prologue of the generated header file.
+void PrintHeaderPrologue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const Parameters &params);
+
+// Print the includes needed for generated header file.
+void PrintHeaderIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const Parameters &params);
+
+// Print the epilogue of the generated header file.
+void PrintHeaderEpilogue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const Parameters &params);
+
+// Print the services for generated header file.
+void PrintHeaderServices(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
+                         const ddprpc_generator::DescriptorIndex &index,
+                         const Parameters &params);
 
 // Helpers
 inline std::string DotsToColons(const std::string &name) {
@@ -15,6 +15,25 @@
      --plugin=protoc-gen-ddprpc=ddprpc_cpp_plugin \
      --ddprpc_out=OUT_DIR services.proto
    ```
+
+   Pass `jobs=N` (e.g. `--ddprpc_out=jobs=4:OUT_DIR`) to limit the
+   number of files that are generated concurrently. By default one file
+   is generated per hardware thread.
+
+   Pass `manifest=OUT_DIR/.ddprpc_manifest` to only write the files
+   whose content changed since the previous run. The plugin records a
+   hash of every output in the manifest; files that are unchanged keep
+   their modification time so dependent builds do not recompile them.
+
+   Methods that set the `(cache_ttl_ms)` option also get a
+   `Caching<Service>` wrapper that completes identical requests from a
+   bounded cache for that many milliseconds. Methods that set
+   `(idempotent) = true` get a `Coalescing<Service>` wrapper that sends
+   identical concurrent requests once and shares the responses.
+
+   Set `RPCGEN_DATA_FILE=<file>` to save the request protoc sends and
+   run the plugin with `--replay=<file> --iterations=N` to profile
+   generation without protoc (see `plugin_main.h`).
    
    This will generate an interface for each service defined in
    `services.proto` that an API implementation can "subclassed" to
@@ -61,14 +80,17 @@
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **/
 #include "cpp_generator.h"
+#include "generator_context.h"
+#include "plugin_main.h"
 
 #include <dotdashpay/api/common/protobuf/api_common.pb.h>
 #include <google/protobuf/compiler/code_generator.h>
-#include <google/protobuf/compiler/plugin.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 using std::string;
 
@@ -83,59 +105,44 @@ class CppGenerator : public google::protobuf::compiler::CodeGenerator {
                         const string &parameter,
                         google::protobuf::compiler::GeneratorContext *context,
                         string *error) const {
-    if (file->options().cc_generic_services()) {
-      *error =
-          "ddprpc compiler plugin does not work with generic "
-          "services. To generate cpp APIs, please set \""
-          "cc_generic_service = false\".";
-      return false;
-    }
-
-    if (!file->options().HasExtension(dotdashpay::api::common::api_major_version)
-        || !file->options().HasExtension(dotdashpay::api::common::api_minor_version)) {
-      *error = "ddprpc compiler requires that api_major_version and api_major_version "
-               "are set in the options";
-      return false;
-    }
+    std::vector<const google::protobuf::FileDescriptor*> files(1, file);
+    return GenerateAll(files, parameter, context, error);
+  }
 
+  // Files are independent of each other so they are generated
+  // concurrently; see ddprpc_generator::GenerateInParallel.
+  virtual bool GenerateAll(const std::vector<const google::protobuf::FileDescriptor*> &files,
+                           const string &parameter,
+                           google::protobuf::compiler::GeneratorContext *context,
+                           string *error) const {
     ddprpc_cpp_generator::Parameters generator_parameters;
+    ddprpc_generator::GenerationOptions generation_options;
 
-    if (!parameter.empty()) {
-      std::vector<string> parameters_list =
-        ddprpc_generator::tokenize(parameter, ",");
-      for (auto parameter_string = parameters_list.begin();
-           parameter_string != parameters_list.end();
-           parameter_string++) {
-        std::vector<string> param =
-          ddprpc_generator::tokenize(*parameter_string, "=");
-        if (param[0] == "services_namespace") {
-          generator_parameters.services_namespace = param[1];
-        } else {
-          *error = string("Unknown parameter: ") + *parameter_string;
-          return false;
-        }
-      }
-    }
-
-    // Ensure the protobuf file conforms to what we're expecting.
-    if (!ddprpc_generator::IsConformant(file, error)) {
+    std::vector<std::pair<string, string> > parameters;
+    if (!ddprpc_generator::ParseParameters(parameter, &parameters, error)) {
       return false;
     }
+    for (auto param = parameters.begin(); param != parameters.end(); param++) {
+      if (!ddprpc_generator::SetGenerationParameter(param->first, param->second, &generation_options)
+          && !ddprpc_cpp_generator::SetParameter(param->first, param->second, &generator_parameters)) {
+        *error = string("Unknown parameter: ") + param->first;
+        return false;
+      }
+    }
 
-    string file_name = ddprpc_generator::StripProto(file->name());
-
-    string header_code =
-        ddprpc_cpp_generator::GetHeaderPrologue(file, generator_parameters) +
-        ddprpc_cpp_generator::GetHeaderIncludes(file, generator_parameters) +
-        ddprpc_cpp_generator::GetHeaderServices(file, generator_parameters) +
-        ddprpc_cpp_generator::GetHeaderEpilogue(file, generator_parameters);
-    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(
-        context->Open(file_name + ".ddprpc.pb.h"));
-    google::protobuf::io::CodedOutputStream header_coded_out(
-        header_output.get());
-    header_coded_out.WriteRaw(header_code.data(), header_code.size());
-    
-    return true;
+    // Analyze the descriptors once up front; every job shares the index.
+    const ddprpc_generator::DescriptorIndex index(files);
+
+    return ddprpc_generator::GenerateInParallel(
+        files.size(), generation_options, context, error,
+        [&](int i, google::protobuf::compiler::GeneratorContext *file_context, string *file_error) {
+          if (!ddprpc_generator::ValidateFile(files[i], file_error)
+              || !ddprpc_cpp_generator::GenerateFiles(files[i], index, generator_parameters, file_context, file_error)) {
+            *file_error = files[i]->name() + ": " + *file_error;
+            return false;
+          }
+          return true;
+        });
   }
 
  private:
@@ -154,5 +161,5 @@ class CppGenerator : public google::protobuf::compiler::CodeGenerator {
 
 int main(int argc, char** argv) {
   dotdashpay::rpcgen::CppGenerator generator;
-  return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+  return ddprpc_generator::PluginMain(argc, argv, &generator);
 }
@@ -40,6 +40,12 @@ A good practical way to do this is:
 RPCGEN_DATA_FILE=/tmp/datafile.bin protoc ... --plugin=protoc-gen-ddprpc=./generator.py ...
 RPCGEN_DATA_FILE=/tmp/datafile.bin RPCGEN_DEBUG_MODE=1 ./generator.py
 
+== RPCGEN_JOBS
+
+The number of processes that render and beautify the output files.
+Defaults to the number of CPUs. Set this to 1 to render everything in
+the generator process, e.g. when using breakpoints in debug mode.
+
 """
 
 from __future__ import print_function
@@ -48,27 +54,105 @@ from google.protobuf.compiler import plugin_pb2 as plugin
 from google.protobuf.descriptor_pb2 import DescriptorProto, EnumDescriptorProto
 from jinja2 import Environment, FileSystemLoader
 import json
+import multiprocessing
 import os
 import pickle
 import re
 import sys
 
 # The various markup tags you can use in your templates to specify the
-# way docs are generated.
-TAGS = {
-    "example": re.compile(r"// ?@example(.*?)// ?@example-end\(\)\n?", re.DOTALL),
-    "reference": re.compile(r"// ?@reference(.*?)// ?@reference-end\(\)\n?", re.DOTALL),
-    "test": re.compile(r"// ?@test(.*?)// ?@test-end\(\)\n?", re.DOTALL),
-    "lib_setup": re.compile(ur"// ?@example-lib-setup(.*?)// ?@example-lib-setup-end\(\)\n?", re.DOTALL),
-    "singles": re.compile(ur"// ?@single\((.*?)\)(.*?)// ?@single-end\(\)\n?", re.DOTALL),
-    "standalones": re.compile(ur"// ?@standalone\((.*?)\)(.*?)// ?@standalone-end\(\)\n?", re.DOTALL),
-    "example-args": re.compile(ur"// ?@example-args\((.*?)\)(.*?)// ?@example-args-end\(\)\n?", re.DOTALL),
-    "generic-tag-open": re.compile(r"[ \t]*// ?@[a-zA-Z0-9\-_]+\(.*\)[ \t]*\n"),
-    "generic-tag-close": re.compile(r"[ \t]*// ?@[a-zA-Z0-9\-_]-end+\(.*\)[ \t]*\n"),
-};
-
-def remove_tags(target):
-    return TAGS["generic-tag-open"].sub("", TAGS["generic-tag-close"].sub("", target))
+# way docs are generated. A tag opens with a line like
+# "// @reference()" or "// @single(identifier)" and closes with
+# "// @reference-end()". The tags are: example, reference, test,
+# example-lib-setup, example-args, example-request, single and
+# standalone. Tags of the same kind do not nest.
+TAG_MARKER = re.compile(r"// ?@([a-zA-Z0-9\-_]+)\(")
+
+# The views scan_tags makes of a rendered example. Each is the tags
+# whose blocks it drops and whether it strips the remaining tag lines.
+EXAMPLE_VIEW = (("test", "reference"), True)
+TEST_VIEW = (("example", "reference"), True)
+REFERENCE_VIEW = (("single", "test"), False)
+
+def _strip_indent(pieces):
+    """_strip_indent drops the spaces and tabs at the end of the text
+    collected in pieces.
+
+    """
+    while len(pieces) > 0:
+        piece = pieces[-1].rstrip(" \t")
+        if len(piece) > 0:
+            pieces[-1] = piece
+            return
+        pieces.pop()
+
+def scan_tags(content, views, collect = None):
+    """scan_tags makes every view of content in a single pass over its
+    tags.
+
+    A view is a pair of the tags whose blocks it drops and whether it
+    strips the lines of the tags it keeps. The blocks of the collect
+    tag are also returned as (identifier, block) pairs, where the
+    identifier is the text up to the first ")" after the tag.
+
+    Returns a tuple of the list of view contents and the collected
+    blocks.
+
+    """
+    markers = []
+    last_end = {}
+    for match in TAG_MARKER.finditer(content):
+        name = match.group(1)
+        closing = name.endswith("-end") and content.startswith(")", match.end())
+        if closing:
+            name = name[:-len("-end")]
+            last_end[name] = match.start()
+        markers.append((match.start(), match.end(), name, closing))
+
+    outputs = [[] for view in views]
+    positions = [0] * len(views)
+    skipping = [None] * len(views)
+    collected = []
+    collecting = None
+
+    for (start, paren, name, closing) in markers:
+        # A block runs from its opening tag through the closing tag and
+        # the newline after it. An opening tag without a closing tag
+        # after it does not start a block.
+        block_end = paren + 1
+        if content.startswith("\n", block_end):
+            block_end += 1
+        opens_block = (not closing) and start < last_end.get(name, -1)
+
+        for (index, (skip, strip)) in enumerate(views):
+            if start < positions[index]:
+                continue
+            if skipping[index] is not None:
+                if closing and name == skipping[index]:
+                    skipping[index] = None
+                    positions[index] = block_end
+            elif opens_block and name in skip:
+                outputs[index].append(content[positions[index]:start])
+                skipping[index] = name
+                positions[index] = start
+            elif strip:
+                line_end = content.find("\n", paren)
+                if line_end != -1 and content[paren:line_end].rstrip(" \t").endswith(")"):
+                    outputs[index].append(content[positions[index]:start])
+                    _strip_indent(outputs[index])
+                    positions[index] = line_end + 1
+
+        if collecting is not None:
+            if closing and name == collect:
+                collected.append((collecting[0], content[collecting[1]:start]))
+                collecting = None
+        elif opens_block and name == collect:
+            close_paren = content.find(")", paren)
+            collecting = (content[paren:close_paren], close_paren + 1)
+
+    for index in range(len(views)):
+        outputs[index].append(content[positions[index]:])
+    return (["".join(output) for output in outputs], collected)
 
 EXAMPLE_VALUES_FILENAME = os.path.join(os.path.dirname(os.path.realpath(__file__)),
                                        "..", "api", "common", "spec", "example-values.json")
@@ -106,29 +190,34 @@ def proto_field_number_bytes_to_number(proto_bytes_as_str):
 
     return total
 
-def lookup_option_values(option_name, option_declaration_container, option_definition_container):
-    """lookup_option_values attempts to locate the option_name, which is
-    declared in the declaration container, in the definition
-    container.
+def decode_options(option_definition_container):
+    """decode_options returns the options set on a proto entity as a dict
+    from field number to a list of (wire type, raw value) tuples.
 
     """
-    extension = None
-    for option in option_declaration_container.extension:
-        if option.name == option_name:
-            extension = option
-            break
-    if extension is None:
-        return (None, None)
-
-    options = []
+    options = {}
     for option in option_definition_container.options._unknown_fields:
-        if proto_field_number_bytes_to_number(option[0]) == extension.number:
-            options.append((ord(option[0][0]) & 0x7, option[1]))
+        number = proto_field_number_bytes_to_number(option[0])
+        options.setdefault(number, []).append((ord(option[0][0]) & 0x7, option[1]))
+    return options
 
-    if len(options) == 0:
-        return (extension, None)
-    else:
-        return (extension, options)
+def decode_option_value(option_value):
+    """decode_option_value converts a (wire type, raw value) tuple from
+    decode_options into a number or a string.
+
+    """
+    if option_value[0] == 0x0:
+        # Varints such as cache_ttl_ms can take several bytes.
+        value = 0
+        for (index, byte) in enumerate(bytes(option_value[1])):
+            value |= (ord(byte) & 0x7f) << (7 * index)
+        return value
+    elif option_value[0] == 0x02:
+        offset = 1
+        while ord(option_value[1][offset - 1]) > 0x7f:
+            offset += 1
+        return str(option_value[1][offset:])
+    return None
 
 def get_method_options(method):
     """
@@ -140,6 +229,10 @@ def get_method_options(method):
     """
     responses = []
     for resp in method.options._unknown_fields:
+        # Other method options, such as cache_ttl_ms, do not name a
+        # response.
+        if resp[0] not in RESPONSE_TYPE:
+            continue
         responses.append({
             "type": RESPONSE_TYPE[resp[0]],
             "name": resp[1][1:].split(".")[-1]
@@ -156,6 +249,17 @@ def to_camel_case(snake_str):
     combined = components[0] + "".join(x.title() for x in components[1:])
     return combined[0].lower() + combined[1:]
 
+# The generator used by the job worker processes. Workers are forked
+# from the generating process, so they inherit the parsed request.
+_job_generator = None
+
+def _init_job_worker(generator):
+    global _job_generator
+    _job_generator = generator
+
+def _run_job(job):
+    return _job_generator.run_job(job)
+
 class DDPGenerator:
     """DDPGenerator is an abstract class that is used to generate the API
     in a target language.
@@ -194,6 +298,7 @@ class DDPGenerator:
     def __init__(self):
         with open(EXAMPLE_VALUES_FILENAME) as examples_file:
             self.examples = json.load(examples_file)
+        self._environment = None
 
     def find_arguments_proto_by_method_name(self, proto):
         """find_proto_by_name returns a DescriptorProto of the argument
@@ -202,7 +307,7 @@ class DDPGenerator:
         This is meant to be 'installed' as a jinja filter.
 
         """
-        return self.find_proto_by_name("{}Args".format(proto))
+        return self.protos.get(proto + "Args")
 
     def find_response_args_proto_by_response_name(self, proto):
         """find_response_args_proto_by_response_name
@@ -211,18 +316,29 @@ class DDPGenerator:
         This is meant to be 'installed' as a jinja filter.
         """
 
-        return self.find_proto_by_name(proto)
+        return self.protos.get(proto)
 
     def find_proto_by_name(self, proto):
         """find_proto_by_name returns a DescriptorProto of the named proto
 
-        This is meant to be 'installed' as a jinja filter.
+        This is meant to be 'installed' as a jinja filter. The lookup
+        uses the index built by find_services.
 
         """
-        for proto_file in self.fileset.proto_file:
-            for message in proto_file.message_type:
-                if message.name == proto:
-                    return message
+        return self.protos.get(proto)
+
+    def get_method_options(self, method):
+        """get_method_options returns the update and completion responses
+        of the method, see the module-level get_method_options.
+
+        This is meant to be 'installed' as a jinja filter. The
+        responses of every method are decoded once by find_services.
+
+        """
+        responses = self.method_responses.get(id(method))
+        if responses is None:
+            responses = get_method_options(method)
+        return responses
 
     def service_file(self, service_name):
         """service_file is meant to be used as a jinja filter to lookup a file
@@ -251,27 +367,64 @@ class DDPGenerator:
         payment.proto file as the second argument.
 
         """
+        options = self.entity_options.get(id(option_definition_container))
+        if options is None:
+            options = self.index_options(option_definition_container)
+
+        # Should only be one declaration that is set on the entity.
         values = []
-        for pfile in self.files:
-            (extension, option_values) = lookup_option_values(option_name, pfile, option_definition_container)
-            if option_values is not None:
-                for option_value in option_values:
-                    if option_value[0] == 0x0:
-                        values.append(ord(option_value[1]))
-                    elif option_value[0] == 0x02:
-                        offset = 1
-                        while ord(option_value[1][offset - 1]) > 0x7f:
-                            offset += 1
-                        values.append(str(option_value[1][offset:]))
-                # Should only be one
+        extension = None
+        for declaration in self.option_declarations.get(option_name, []):
+            if declaration.number in options:
+                extension = declaration
+                values = options[declaration.number]
                 break
 
         # LABEL_REPEATED = 3
-        #import ipdb; ipdb.set_trace()
         if (extension is not None) and (extension.label != 3):
             return values[0]
         return values
 
+    def index_options(self, option_definition_container):
+        """index_options decodes the option values set on a proto entity
+        into a dict from field number to a list of values.
+
+        """
+        options = {}
+        for (number, option_values) in decode_options(option_definition_container).items():
+            values = [decode_option_value(option_value) for option_value in option_values]
+            options[number] = [value for value in values if value is not None]
+        return options
+
+    def build_index(self, fileset):
+        """build_index makes the lookups done by the jinja filters dict
+        hits.
+
+        It maps each message name to its DescriptorProto (the first one
+        wins, as the files are listed by protoc), each option name to
+        the extensions declaring it, and each file, service and method
+        to its decoded options. Methods also get their decoded
+        responses. Entities are keyed by id() since the descriptor
+        protos are not hashable and live as long as the fileset.
+
+        """
+        self.protos = {}
+        self.option_declarations = {}
+        self.entity_options = {}
+        self.method_responses = {}
+        for pfile in fileset.proto_file:
+            for message in pfile.message_type:
+                self.protos.setdefault(message.name, message)
+            for extension in pfile.extension:
+                self.option_declarations.setdefault(extension.name, []).append(extension)
+
+            self.entity_options[id(pfile)] = self.index_options(pfile)
+            for service in pfile.service:
+                self.entity_options[id(service)] = self.index_options(service)
+                for method in service.method:
+                    self.entity_options[id(method)] = self.index_options(method)
+                    self.method_responses[id(method)] = get_method_options(method)
+
 
     def find_services(self, fileset):
 
@@ -294,6 +447,7 @@ class DDPGenerator:
             for service in pfile.service:
                 self.service_files[service.name] = pfile
                 services.append(service)
+        self.build_index(fileset)
         return services
 
     def output_dir(self, typename):
@@ -483,14 +637,17 @@ class DDPGenerator:
         rendered = environment.get_template(template_filename).render(generator = self, **kwargs)
         return rendered
 
-    def generate(self, services, outputs):
-        """generate is the main method of the generators.
+    def environment(self):
+        """environment returns the jinja environment with the generator
+        filters installed.
 
-        It takes an object outputs, which should be created via:
-        outputs = plugin.CodeGeneratorResponse()
+        It is created on first use, so every process that renders
+        templates builds its own.
 
         """
-        PATH = os.path.dirname(os.path.abspath(__file__))
+        if self._environment is not None:
+            return self._environment
+
         environment = Environment(
             autoescape=False,
             loader=FileSystemLoader(TEMPLATES_DIR),
@@ -499,8 +656,7 @@ class DDPGenerator:
             lambda content: content[0].lower() + content[1:]
         environment.filters["remove_package"] = \
             lambda content: content.split(".")[-1]
-        environment.filters["get_method_options"] = \
-            lambda content: get_method_options(content)
+        environment.filters["get_method_options"] = self.get_method_options
         environment.filters["get_example_value_for_field"] = self.get_example_value_for_field
         environment.filters["find_arguments_proto_by_method_name"] = self.find_arguments_proto_by_method_name
         environment.filters["find_response_args_proto_by_response_name"] = self.find_response_args_proto_by_response_name
@@ -509,87 +665,150 @@ class DDPGenerator:
         environment.filters["service_file"] = self.service_file
         environment.filters["option_values"] = self.option_values
 
-        # Generate API files.
-        for service in services:
-            header_name = self.api_header_name(service)
-            if header_name is not None:
-                generated_header_descriptor = outputs.file.add()
-                generated_header_descriptor.name = header_name
-                generated_header_descriptor.content = self.beautify(
-                    self.render(environment, "api", "header", service = service))
-
-        for service in services:
-            source_name = self.api_source_name(service)
-            if source_name is not None:
-                generated_source_descriptor = outputs.file.add()
-                generated_source_descriptor.name = source_name
-                generated_source_descriptor.content = self.beautify(
-                    self.render(environment, "api", "source", service = service))
-
-        # Generate simulator files.
-        for service in services:
-            header_name = self.simulator_header_name(service)
-            if header_name is not None:
-                generated_header_descriptor = outputs.file.add()
-                generated_header_descriptor.name = "{}/{}".format(self.output_dir("simulator"), header_name)
-                generated_header_descriptor.content = self.beautify(
-                    self.render(environment, "simulator", "header", service = service))
-
-        for service in services:
-            source_name = self.simulator_source_name(service)
-            if source_name is not None:
-                generated_source_descriptor = outputs.file.add()
-                generated_source_descriptor.name = "{}/{}".format(self.output_dir("simulator"), source_name)
-                generated_source_descriptor.content = self.beautify(
-                    self.render(environment, "simulator", "source", service = service))
+        self._environment = environment
+        return environment
+
+    def jobs(self, services):
+        """jobs returns the list of rendering jobs for generate, in the
+        order their files are added to the response.
+
+        A job is a small tuple of names and indexes into services so
+        that it is cheap to send to a worker process. Each job renders
+        one api or simulator file, or one method's example together
+        with its test since both come from the same rendered template.
+
+        """
+        jobs = []
+        for typename in ["api", "simulator"]:
+            for filetype in ["header", "source"]:
+                for index, service in enumerate(services):
+                    name = getattr(self, "{}_{}_name".format(typename, filetype))(service)
+                    if name is not None:
+                        jobs.append((typename, filetype, index, name))
+
+        for index, service in enumerate(services):
+            for method_index in range(len(service.method)):
+                jobs.append(("examples", "source", index, method_index))
+        return jobs
+
+    def run_job(self, job):
+        """run_job renders and beautifies the output of a job returned by
+        jobs.
+
+        For api and simulator jobs the result is the file content. For
+        example jobs it is a tuple of the example content, the test
+        content, the part of the reference content for the method and
+        the singles found in it. Contents that are not generated for
+        the language are None.
+
+        """
+        (typename, filetype, index, detail) = job
+        service = self.services[index]
+        if typename != "examples":
+            return self.beautify(self.render(self.environment(), typename, filetype, service = service))
+
+        method = service.method[detail]
+        if self.examples_source_name(method.name) is None:
+            return (None, None, "", [])
+
+        content = self.render(self.environment(), "examples", "source", method = method, service = service)
+        ((example_content, test_content, reference_content), singles) = \
+            scan_tags(content, [EXAMPLE_VIEW, TEST_VIEW, REFERENCE_VIEW], "single")
+
+        if self.tests_source_name(method.name) is None:
+            test_content = None
+        else:
+            test_content = self.beautify(test_content)
+
+        return (self.beautify(example_content), test_content, reference_content, singles)
+
+    def run_jobs(self, jobs):
+        """run_jobs runs the jobs and returns their results in the same
+        order.
+
+        The jobs are spread over a pool of RPCGEN_JOBS processes, or
+        one per CPU by default. With a single job process everything
+        runs in this process.
+
+        """
+        processes = int(os.environ.get("RPCGEN_JOBS", multiprocessing.cpu_count()))
+        if processes <= 1 or len(jobs) <= 1:
+            return [self.run_job(job) for job in jobs]
+
+        pool = multiprocessing.Pool(min(processes, len(jobs)), _init_job_worker, (self,))
+        try:
+            results = pool.map(_run_job, jobs, 1)
+        finally:
+            pool.close()
+            pool.join()
+        return results
+
+    def generate(self, services, outputs):
+        """generate is the main method of the generators.
+
+        It takes an object outputs, which should be created via:
+        outputs = plugin.CodeGeneratorResponse()
+
+        """
+        self.services = services
+        jobs = self.jobs(services)
+        results = self.run_jobs(jobs)
 
         # Generate example files. Standalone example files are for
         # reading purposes. The singular file (which is appended with
         # ".reference" is meant to be passed to generate-reference.js
         # in the api/common/spec directory.
-        reference_content = ""
+        reference_contents = []
 
         singles_lines = {}
         singles_dedup = {}
 
-        for service in services:
-            for method in service.method:
-                source_name = self.examples_source_name(method.name)
-                if source_name is None:
-                    continue
+        for (job, result) in zip(jobs, results):
+            (typename, filetype, index, detail) = job
 
-                generated_source_descriptor = outputs.file.add()
-                generated_source_descriptor.name = "{}/{}".format(self.output_dir("examples"), source_name)
+            # Generate API and simulator files.
+            if typename != "examples":
+                generated_descriptor = outputs.file.add()
+                if typename == "api":
+                    generated_descriptor.name = detail
+                else:
+                    generated_descriptor.name = "{}/{}".format(self.output_dir(typename), detail)
+                generated_descriptor.content = result
+                continue
 
-                content = self.render(environment, "examples", "source", method = method, service = service)
-                example_content = remove_tags(TAGS["reference"].sub("", TAGS["test"].sub("", content)))
-                generated_source_descriptor.content = self.beautify(example_content)
+            (example_content, test_content, method_reference_content, singles) = result
+            if example_content is None:
+                continue
 
-                reference_content += TAGS["test"].sub("", TAGS["singles"].sub("", content))
+            method = services[index].method[detail]
+            generated_source_descriptor = outputs.file.add()
+            generated_source_descriptor.name = "{}/{}".format(self.output_dir("examples"),
+                                                              self.examples_source_name(method.name))
+            generated_source_descriptor.content = example_content
 
-                singles = TAGS["singles"].findall(content)
-                for single in singles:
-                    identifier = single[0]
-                    block = single[1]
+            reference_contents.append(method_reference_content)
 
-                    if identifier not in singles_dedup:
-                        singles_lines[identifier] = []
-                        singles_dedup[identifier] = set()
+            for single in singles:
+                identifier = single[0]
+                block = single[1]
 
-                    for line in iter(block.splitlines()):
-                        if line not in singles_lines[identifier]:
-                            singles_lines[identifier].append(line)
-                            singles_dedup[identifier].add(line)
+                if identifier not in singles_dedup:
+                    singles_lines[identifier] = []
+                    singles_dedup[identifier] = set()
 
-                # Generate the test file as well
-                source_name = self.tests_source_name(method.name)
-                if source_name is None:
-                    continue
+                for line in iter(block.splitlines()):
+                    if line not in singles_lines[identifier]:
+                        singles_lines[identifier].append(line)
+                        singles_dedup[identifier].add(line)
 
-                generated_source_descriptor = outputs.file.add()
-                generated_source_descriptor.name = "{}/{}".format(self.output_dir("tests"), source_name)
-                test_content = remove_tags(TAGS["example"].sub("", TAGS["reference"].sub("", content)))
-                generated_source_descriptor.content = self.beautify(test_content)
+            # Generate the test file as well
+            if test_content is None:
+                continue
+
+            generated_source_descriptor = outputs.file.add()
+            generated_source_descriptor.name = "{}/{}".format(self.output_dir("tests"),
+                                                              self.tests_source_name(method.name))
+            generated_source_descriptor.content = test_content
 
 
         source_name = self.examples_source_name("reference")
@@ -604,11 +823,13 @@ class DDPGenerator:
                 lines = "\n".join(singles_lines[identifier])
                 reference_single_content += "// @{}{}\n// @{}\n\n".format(identifier, lines, end_tag)
 
-            reference_content = self.beautify("{}\n\n{}".format(reference_single_content, reference_content))
+            reference_content = self.beautify("{}\n\n{}".format(reference_single_content, "".join(reference_contents)))
 
             # The reference can contain standalone examples which we
-            # denote in order to render them into separate files.
-            standalones = TAGS["standalones"].findall(reference_content)
+            # denote in order to render them into separate files. They
+            # are removed from the reference in the same pass.
+            ((reference_content,), standalones) = \
+                scan_tags(reference_content, [(("standalone",), False)], "standalone")
             standalone_dedup = set()
             for standalone in standalones:
                 identifier = standalone[0]
@@ -628,8 +849,7 @@ class DDPGenerator:
 
                 standalone_dedup.add(identifier)
 
-            # Remove standalones from reference.
-            reference_source_descriptor.content = re.sub(TAGS["standalones"], "", reference_content)
+            reference_source_descriptor.content = reference_content
 
 
     def _map_raw_example_value_to_language(self, raw_value):
@@ -0,0 +1,225 @@
+/**
+   `ddprpc_plugin` is a binary utility that generates the C++,
+   Objective-C and Node.js API interfaces in a single protoc pass. It
+   runs the same back-ends as `ddprpc_cpp_plugin`, `ddprpc_objc_plugin`
+   and `ddprpc_nodejs_plugin`, but the import graph is parsed and each
+   file is validated only once for all of the languages.
+
+   Use the plugin by executing the following command:
+
+   ```bash
+   protoc                                                          \
+   --plugin=protoc-gen-ddprpc=ddprpc_plugin                        \
+   --ddprpc_out=languages=cpp,objc,nodejs,objc_out=ios:OUT_DIR     \
+   services.proto
+   ```
+
+   The `languages` parameter selects the back-ends to run and defaults
+   to all of them. By default every language is written to OUT_DIR;
+   `cpp_out`, `objc_out` and `nodejs_out` place a language's files in a
+   subdirectory of OUT_DIR instead. `jobs=N` limits the number of
+   files generated concurrently (one per hardware thread by default).
+   `manifest=OUT_DIR/.ddprpc_manifest` skips writing files whose
+   content has not changed since the previous run.
+   All other parameters are passed along to the back-ends that accept
+   them (e.g. `services_namespace` for C++).
+
+   ===============================================================
+
+   
+   This file borrows heavily from the grpc library. The LICENSE for
+   that library is included because of the high degree of similarity:
+
+   Copyright 2015, Google Inc.
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are
+   met:
+   
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer
+   in the documentation and/or other materials provided with the
+   distribution.
+   * Neither the name of Google Inc. nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+#include "cpp_generator.h"
+#include "generator_context.h"
+#include "plugin_main.h"
+#include "nodejs_generator.h"
+#include "objc_generator.h"
+
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+
+namespace dotdashpay {
+namespace rpcgen {
+namespace {
+
+const char* const kLanguages[] = {"cpp", "objc", "nodejs"};
+const int kLanguageCount = sizeof(kLanguages) / sizeof(kLanguages[0]);
+
+// Forwards every output file into a subdirectory of another context.
+class SubdirectoryGeneratorContext : public google::protobuf::compiler::GeneratorContext {
+ public:
+  SubdirectoryGeneratorContext(google::protobuf::compiler::GeneratorContext *context,
+                               const string &subdirectory)
+      : context_(context), prefix_(subdirectory.empty() ? "" : subdirectory + "/") {}
+  virtual ~SubdirectoryGeneratorContext() {}
+
+  virtual google::protobuf::io::ZeroCopyOutputStream* Open(const string &filename) {
+    return context_->Open(prefix_ + filename);
+  }
+
+  virtual google::protobuf::io::ZeroCopyOutputStream* OpenForInsert(
+      const string &filename, const string &insertion_point) {
+    return context_->OpenForInsert(prefix_ + filename, insertion_point);
+  }
+
+  virtual void ListParsedFiles(std::vector<const google::protobuf::FileDescriptor*>* output) {
+    context_->ListParsedFiles(output);
+  }
+
+ private:
+  google::protobuf::compiler::GeneratorContext *context_;
+  string prefix_;
+};
+}  // namespace
+
+class MultiLanguageGenerator : public google::protobuf::compiler::CodeGenerator {
+ public:
+  MultiLanguageGenerator() {}
+  virtual ~MultiLanguageGenerator() {}
+
+  virtual bool Generate(const google::protobuf::FileDescriptor *file,
+                        const string &parameter,
+                        google::protobuf::compiler::GeneratorContext *context,
+                        string *error) const {
+    std::vector<const google::protobuf::FileDescriptor*> files(1, file);
+    return GenerateAll(files, parameter, context, error);
+  }
+
+  // Every (file, language) pair is an independent job, so a single
+  // services.proto still fans out across the back-ends.
+  virtual bool GenerateAll(const std::vector<const google::protobuf::FileDescriptor*> &files,
+                           const string &parameter,
+                           google::protobuf::compiler::GeneratorContext *context,
+                           string *error) const {
+    ddprpc_cpp_generator::Parameters cpp_parameters;
+    ddprpc_objc_generator::Parameters objc_parameters;
+    ddprpc_nodejs_generator::Parameters nodejs_parameters;
+    ddprpc_generator::GenerationOptions generation_options;
+    std::map<string, string> output_directories;
+    std::vector<string> languages(kLanguages, kLanguages + kLanguageCount);
+
+    std::vector<std::pair<string, string> > parameters;
+    if (!ddprpc_generator::ParseParameters(parameter, &parameters, error)) {
+      return false;
+    }
+    for (auto param = parameters.begin(); param != parameters.end(); param++) {
+      if (param->first == "languages") {
+        languages = ddprpc_generator::tokenize(param->second, ",");
+        for (auto language = languages.begin(); language != languages.end(); language++) {
+          if (!IsLanguage(*language)) {
+            *error = string("Unknown language: ") + *language;
+            return false;
+          }
+        }
+      } else if (IsOutputDirectoryParameter(param->first)) {
+        output_directories[param->first] = param->second;
+      } else if (!ddprpc_generator::SetGenerationParameter(param->first, param->second,
+                                                           &generation_options)) {
+        // A parameter only has to be understood by one of the back-ends.
+        bool known = ddprpc_cpp_generator::SetParameter(param->first, param->second, &cpp_parameters);
+        known = ddprpc_objc_generator::SetParameter(param->first, param->second, &objc_parameters) || known;
+        known = ddprpc_nodejs_generator::SetParameter(param->first, param->second, &nodejs_parameters) || known;
+        if (!known) {
+          *error = string("Unknown parameter: ") + param->first;
+          return false;
+        }
+      }
+    }
+
+    // Resolve the subdirectories up front; the jobs below only read them.
+    std::vector<string> language_directories;
+    for (auto language = languages.begin(); language != languages.end(); language++) {
+      language_directories.push_back(output_directories[*language + "_out"]);
+    }
+
+    for (auto file = files.begin(); file != files.end(); file++) {
+      if (!ddprpc_generator::ValidateFile(*file, error)) {
+        *error = (*file)->name() + ": " + *error;
+        return false;
+      }
+    }
+
+    // Analyze the descriptors once; every language and job shares the index.
+    const ddprpc_generator::DescriptorIndex index(files);
+
+    return ddprpc_generator::GenerateInParallel(
+        files.size() * languages.size(), generation_options, context, error,
+        [&](int job, google::protobuf::compiler::GeneratorContext *job_context, string *job_error) {
+          const google::protobuf::FileDescriptor *file = files[job / languages.size()];
+          const string &language = languages[job % languages.size()];
+
+          SubdirectoryGeneratorContext language_context(job_context,
+                                                        language_directories[job % languages.size()]);
+          bool generated = false;
+          if (language == "cpp") {
+            generated = ddprpc_cpp_generator::GenerateFiles(file, index, cpp_parameters, &language_context, job_error);
+          } else if (language == "objc") {
+            generated = ddprpc_objc_generator::GenerateFiles(file, index, objc_parameters, &language_context, job_error);
+          } else if (language == "nodejs") {
+            generated = ddprpc_nodejs_generator::GenerateFiles(file, index, nodejs_parameters, &language_context, job_error);
+          }
+          if (!generated) {
+            *job_error = file->name() + ": " + *job_error;
+          }
+          return generated;
+        });
+  }
+
+ private:
+  static bool IsLanguage(const string &language) {
+    for (int i = 0; i < kLanguageCount; ++i) {
+      if (language == kLanguages[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool IsOutputDirectoryParameter(const string &key) {
+    string language = key;
+    return ddprpc_generator::StripSuffix(&language, "_out") && IsLanguage(language);
+  }
+};
+}  // namespace rpcgen
+}  // namespace dotdashpay
+
+int main(int argc, char** argv) {
+  dotdashpay::rpcgen::MultiLanguageGenerator generator;
+  return ddprpc_generator::PluginMain(argc, argv, &generator);
+}
@@ -0,0 +1,194 @@
+/**
+   Helpers for running the language back-ends against a protoc
+   GeneratorContext.
+**/
+
+#include "generator_context.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+
+namespace ddprpc_generator {
+
+namespace {
+
+// 64-bit FNV-1a; only used to detect changes, not as a checksum.
+uint64_t HashContent(const string &content) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < content.size(); ++i) {
+    hash ^= static_cast<unsigned char>(content[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool FileExists(const string &path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+// Read the manifest at path into hashes. Each line is the hex hash of a
+// file followed by a space and its name relative to the output
+// directory. A missing manifest is simply empty.
+void ReadManifest(const string &path, std::map<string, uint64_t> *hashes) {
+  std::ifstream input(path.c_str());
+  string line;
+  while (std::getline(input, line)) {
+    const size_t space_pos = line.find(' ');
+    if (space_pos != string::npos) {
+      (*hashes)[line.substr(space_pos + 1)] = strtoull(line.substr(0, space_pos).c_str(), NULL, 16);
+    }
+  }
+}
+
+// Flush the files in outputs that changed since the manifest was last
+// written, followed by the updated manifest. Entries for files that this
+// run did not generate are kept as long as the file still exists, so
+// separate protoc runs can share an output directory and a manifest.
+void FlushChangedFiles(const std::deque<MemoryGeneratorContext> &outputs, const string &manifest,
+                       google::protobuf::compiler::GeneratorContext *context) {
+  const size_t slash_pos = manifest.rfind('/');
+  const string directory = slash_pos == string::npos ? "" : manifest.substr(0, slash_pos + 1);
+  const string manifest_name = manifest.substr(directory.size());
+
+  std::map<string, uint64_t> previous_hashes;
+  ReadManifest(manifest, &previous_hashes);
+
+  std::map<string, uint64_t> updated_hashes;
+  for (auto previous_hash = previous_hashes.begin(); previous_hash != previous_hashes.end(); previous_hash++) {
+    if (FileExists(directory + previous_hash->first)) {
+      updated_hashes.insert(*previous_hash);
+    }
+  }
+
+  for (auto output = outputs.begin(); output != outputs.end(); output++) {
+    for (auto file = output->files().begin(); file != output->files().end(); file++) {
+      const uint64_t hash = HashContent(file->content);
+      auto previous_hash = updated_hashes.find(file->name);
+      const bool unchanged = previous_hash != updated_hashes.end() && previous_hash->second == hash;
+      updated_hashes[file->name] = hash;
+      if (unchanged) {
+        continue;
+      }
+
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> stream(context->Open(file->name));
+      google::protobuf::io::CodedOutputStream coded_out(stream.get());
+      coded_out.WriteRaw(file->content.data(), file->content.size());
+    }
+  }
+
+  std::ostringstream updated_manifest;
+  for (auto hash = updated_hashes.begin(); hash != updated_hashes.end(); hash++) {
+    char hash_text[17];
+    snprintf(hash_text, sizeof(hash_text), "%016" PRIx64, hash->second);
+    updated_manifest << hash_text << " " << hash->first << "\n";
+  }
+
+  const string manifest_content = updated_manifest.str();
+  std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> stream(context->Open(manifest_name));
+  google::protobuf::io::CodedOutputStream coded_out(stream.get());
+  coded_out.WriteRaw(manifest_content.data(), manifest_content.size());
+}
+
+}  // namespace
+
+bool SetGenerationParameter(const string &key, const string &value,
+                            GenerationOptions *options) {
+  if (key == "jobs") {
+    options->jobs = std::max(0, atoi(value.c_str()));
+    return true;
+  }
+  if (key == "manifest") {
+    options->manifest = value;
+    return true;
+  }
+  return false;
+}
+
+google::protobuf::io::ZeroCopyOutputStream* MemoryGeneratorContext::Open(const string &filename) {
+  files_.push_back(File());
+  files_.back().name = filename;
+  return new google::protobuf::io::StringOutputStream(&files_.back().content);
+}
+
+void MemoryGeneratorContext::Flush(google::protobuf::compiler::GeneratorContext *context) const {
+  for (auto file = files_.begin(); file != files_.end(); file++) {
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> output(context->Open(file->name));
+    google::protobuf::io::CodedOutputStream coded_out(output.get());
+    coded_out.WriteRaw(file->content.data(), file->content.size());
+  }
+}
+
+bool GenerateInParallel(int job_count, const GenerationOptions &options,
+                        google::protobuf::compiler::GeneratorContext *context,
+                        string *error, const GenerationJob &job) {
+  int worker_count = options.jobs > 0 ? options.jobs : static_cast<int>(std::thread::hardware_concurrency());
+  worker_count = std::min(worker_count, job_count);
+
+  // Nothing to overlap or compare, so skip the buffering and write
+  // straight through.
+  if (worker_count <= 1 && options.manifest.empty()) {
+    for (int i = 0; i < job_count; ++i) {
+      if (!job(i, context, error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::deque<MemoryGeneratorContext> outputs(job_count);
+  std::vector<string> errors(job_count);
+  std::vector<char> succeeded(job_count, false);
+  std::atomic<int> next_job(0);
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < worker_count; ++i) {
+    workers.push_back(std::thread([&]() {
+      for (int j = next_job++; j < job_count; j = next_job++) {
+        succeeded[j] = job(j, &outputs[j], &errors[j]);
+      }
+    }));
+  }
+  // The calling thread is the last worker.
+  for (int j = next_job++; j < job_count; j = next_job++) {
+    succeeded[j] = job(j, &outputs[j], &errors[j]);
+  }
+  for (auto worker = workers.begin(); worker != workers.end(); worker++) {
+    worker->join();
+  }
+
+  // Report the first failure in job order so errors are deterministic too.
+  for (int i = 0; i < job_count; ++i) {
+    if (!succeeded[i]) {
+      *error = errors[i];
+      return false;
+    }
+  }
+
+  if (!options.manifest.empty()) {
+    FlushChangedFiles(outputs, options.manifest, context);
+    return true;
+  }
+  for (int i = 0; i < job_count; ++i) {
+    outputs[i].Flush(context);
+  }
+  return true;
+}
+
+}  // namespace ddprpc_generator
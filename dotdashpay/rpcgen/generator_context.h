@@ -0,0 +1,87 @@
+/**
+   Helpers for running the language back-ends against a protoc
+   GeneratorContext: an in-memory context that buffers generated files,
+   a worker pool that generates independent files concurrently and a
+   manifest of content hashes that skips files that did not change.
+**/
+
+#ifndef __DOTDASHPAY_RPCGEN_GENERATOR_CONTEXT_H__
+#define __DOTDASHPAY_RPCGEN_GENERATOR_CONTEXT_H__
+
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <deque>
+#include <functional>
+#include <string>
+
+namespace ddprpc_generator {
+
+// Contains the parameters that control how files are generated rather
+// than what is generated. These are accepted by every plugin.
+struct GenerationOptions {
+  GenerationOptions() : jobs(0) {}
+
+  // Number of generation jobs that run concurrently. Zero uses one job
+  // per hardware thread.
+  int jobs;
+
+  // Path of the manifest that records the content hash of every file
+  // generated by the previous run, e.g. `OUT_DIR/.ddprpc_manifest`. It
+  // must be at the root of the output directory. When set, files whose
+  // hash is unchanged and that still exist are not written again, so
+  // their modification times are left alone. Each run merges its files
+  // into the manifest, so separate protoc runs may share it. Plugins
+  // that share an output directory within one protoc run need different
+  // manifests. Empty disables it.
+  std::string manifest;
+};
+
+// Set the generation parameter key to value. Returns false if key is
+// not a generation parameter.
+bool SetGenerationParameter(const std::string &key, const std::string &value,
+                            GenerationOptions *options);
+
+// A GeneratorContext that keeps every opened file in memory until it is
+// flushed into another context.
+class MemoryGeneratorContext : public google::protobuf::compiler::GeneratorContext {
+ public:
+  struct File {
+    std::string name;
+    std::string content;
+  };
+
+  MemoryGeneratorContext() {}
+  virtual ~MemoryGeneratorContext() {}
+
+  virtual google::protobuf::io::ZeroCopyOutputStream* Open(const std::string &filename);
+
+  // Files in the order they were opened.
+  const std::deque<File>& files() const { return files_; }
+
+  // Write every buffered file into context, in the order they were opened.
+  void Flush(google::protobuf::compiler::GeneratorContext *context) const;
+
+ private:
+  // A deque keeps the content strings at stable addresses while the
+  // output streams returned by Open are still writing into them.
+  std::deque<File> files_;
+};
+
+// Generates a single job (e.g. one file) into context. Returns false and
+// sets error on failure.
+typedef std::function<bool(int job, google::protobuf::compiler::GeneratorContext *context,
+                           std::string *error)> GenerationJob;
+
+// Run job_count independent generation jobs on a pool of worker
+// threads. Each job writes into its own MemoryGeneratorContext and the
+// results are flushed into context in job order, so the output does not
+// depend on scheduling and only the calling thread touches context. If
+// options.manifest is set, only changed files are flushed and the
+// manifest is rewritten along with them.
+bool GenerateInParallel(int job_count, const GenerationOptions &options,
+                        google::protobuf::compiler::GeneratorContext *context,
+                        std::string *error, const GenerationJob &job);
+
+}  // namespace ddprpc_generator
+
+#endif  // __DOTDASHPAY_RPCGEN_GENERATOR_CONTEXT_H__
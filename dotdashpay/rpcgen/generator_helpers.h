@@ -38,9 +38,13 @@
 #include <dotdashpay/api/common/protobuf/api_common.pb.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/unknown_field_set.h>
+#include <cstdint>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace ddprpc_generator {
@@ -130,6 +134,17 @@ inline std::string LowerUnderscoreToUpperCamel(std::string str) {
   return result;
 }
 
+inline std::string UpperCamelToLowerUnderscore(const std::string &str) {
+  std::string result = "";
+  for (unsigned int i = 0; i < str.size(); i++) {
+    if (::isupper(str[i]) && i > 0) {
+      result += "_";
+    }
+    result += ::tolower(str[i]);
+  }
+  return result;
+}
+
 inline std::string FileNameInUpperCamel(const google::protobuf::FileDescriptor *file,
                                          bool include_package_path) {
   std::vector<std::string> tokens = tokenize(StripProto(file->name()), "/");
@@ -147,6 +162,33 @@ inline std::string FileNameInUpperCamel(const google::protobuf::FileDescriptor *
   return FileNameInUpperCamel(file, true);
 }
 
+// Split the plugin parameter string "key=value,key=value" into key/value
+// pairs. An entry without "=" continues the value of the previous key, so
+// list values such as "languages=cpp,objc,nodejs" survive the split.
+inline bool ParseParameters(const std::string& parameter,
+                            std::vector<std::pair<std::string, std::string> >* pairs,
+                            std::string* error) {
+  if (parameter.empty()) {
+    return true;
+  }
+
+  std::vector<std::string> entries = tokenize(parameter, ",");
+  for (unsigned int i = 0; i < entries.size(); ++i) {
+    const size_t equals_pos = entries[i].find('=');
+    if (equals_pos != std::string::npos) {
+      pairs->push_back(std::make_pair(entries[i].substr(0, equals_pos),
+                                      entries[i].substr(equals_pos + 1)));
+    } else if (!pairs->empty()) {
+      pairs->back().second += "," + entries[i];
+    } else {
+      (*error) = "Malformed parameter: " + entries[i];
+      return false;
+    }
+  }
+
+  return true;
+}
+
 enum MethodType {
   METHODTYPE_NO_STREAMING,
   METHODTYPE_CLIENT_STREAMING,
@@ -170,6 +212,76 @@ inline MethodType GetMethodType(const google::protobuf::MethodDescriptor *method
   }
 }
 
+// Field numbers of the method options that api_common.proto declares as
+// `cache_ttl_ms` and `idempotent`.
+const int kCacheTtlMsFieldNumber = 50005;
+const int kIdempotentFieldNumber = 50006;
+
+// The value of the integer or bool method option with the given field
+// number, or 0 if it is not set. The option is read by number rather
+// than through its generated extension so that the plugins build against
+// an api_common that does not declare it yet. Such options are kept in
+// the unknown fields of the options.
+inline uint64_t GetMethodOptionVarint(const google::protobuf::MethodDescriptor* method, int number) {
+  const google::protobuf::MethodOptions& options = method->options();
+  const google::protobuf::Reflection* reflection = options.GetReflection();
+
+  const google::protobuf::FieldDescriptor* extension = reflection->FindKnownExtensionByNumber(number);
+  if (extension != NULL) {
+    if (!reflection->HasField(options, extension)) {
+      return 0;
+    }
+    switch (extension->cpp_type()) {
+      case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+        return reflection->GetUInt32(options, extension);
+      case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+        return reflection->GetBool(options, extension);
+      default:
+        return 0;
+    }
+  }
+
+  // The last occurrence of a non-repeated field wins.
+  uint64_t value = 0;
+  const google::protobuf::UnknownFieldSet& unknown_fields = reflection->GetUnknownFields(options);
+  for (int i = 0; i < unknown_fields.field_count(); ++i) {
+    const google::protobuf::UnknownField& field = unknown_fields.field(i);
+    if (field.number() == number && field.type() == google::protobuf::UnknownField::TYPE_VARINT) {
+      value = field.varint();
+    }
+  }
+  return value;
+}
+
+// How long the completion response of method may be reused for an
+// identical request, in milliseconds. 0 means method is not cacheable.
+inline uint32_t GetCacheTtlMs(const google::protobuf::MethodDescriptor* method) {
+  return static_cast<uint32_t>(GetMethodOptionVarint(method, kCacheTtlMsFieldNumber));
+}
+
+inline bool HasCacheableMethods(const google::protobuf::ServiceDescriptor* service) {
+  for (int i = 0; i < service->method_count(); ++i) {
+    if (GetCacheTtlMs(service->method(i)) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether identical concurrent calls to method may share one call.
+inline bool IsIdempotent(const google::protobuf::MethodDescriptor* method) {
+  return GetMethodOptionVarint(method, kIdempotentFieldNumber) != 0;
+}
+
+inline bool HasIdempotentMethods(const google::protobuf::ServiceDescriptor* service) {
+  for (int i = 0; i < service->method_count(); ++i) {
+    if (IsIdempotent(service->method(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
 inline bool IsConformant(const google::protobuf::FileDescriptor* file, std::string* error) {
   for (int i = 0; i < file->service_count(); ++i) {
     for (int j = 0; j < file->service(i)->method_count(); ++j) {
@@ -178,67 +290,184 @@ inline bool IsConformant(const google::protobuf::FileDescriptor* file, std::stri
         (*error) = "Service [" + file->service(i)->name() + "] does not contain a completion response";
         return false;
       }
+      if (GetCacheTtlMs(method) > 0 && GetMethodType(method) != METHODTYPE_NO_STREAMING) {
+        (*error) = "Method [" + method->full_name() + "] is streaming and cannot set cache_ttl_ms";
+        return false;
+      }
+      if (IsIdempotent(method) && GetMethodType(method) != METHODTYPE_NO_STREAMING) {
+        (*error) = "Method [" + method->full_name() + "] is streaming and cannot be idempotent";
+        return false;
+      }
     }
   }
 
   return true;
 }
 
-inline std::vector<std::string> GetUpdateResponses(
-    const google::protobuf::MethodDescriptor* method, const bool& get_package = false) {
-  std::vector<std::string> responses;
-  const int index = get_package ? 0 : 1;
-  for (int i = 0; i < method->options().ExtensionSize(dotdashpay::api::common::update_response); ++i) {
-    const std::string response_name = method->options().GetExtension(dotdashpay::api::common::update_response, i);
-    responses.push_back(tokenize(response_name, ".")[index]);
+// Run the checks shared by every language generator. This only needs to
+// happen once per file regardless of how many languages are generated.
+inline bool ValidateFile(const google::protobuf::FileDescriptor* file, std::string* error) {
+  if (!file->options().HasExtension(dotdashpay::api::common::api_major_version)
+      || !file->options().HasExtension(dotdashpay::api::common::api_minor_version)) {
+    (*error) = "ddprpc compiler requires that api_major_version and api_major_version "
+               "are set in the options";
+    return false;
   }
-  return responses;
-}
 
-inline std::string GetCompletionResponse(
-    const google::protobuf::MethodDescriptor* method, bool get_package = false) {
-  const int index = get_package ? 0 : 1;
-  const std::string response_name = method->options().GetExtension(dotdashpay::api::common::completion_response);
-  return tokenize(response_name, ".")[index];
+  // Ensure the protobuf file conforms to what we're expecting.
+  return IsConformant(file, error);
 }
 
-inline std::set<std::string> GetUniqueResponses(const google::protobuf::ServiceDescriptor* service,
-                                                const bool& get_package = false) {
-  std::set<std::string> responses;
-  for (int j = 0; j < service->method_count(); ++j) {
-    const google::protobuf::MethodDescriptor* method = service->method(j);
-    const std::vector<std::string> method_responses = ddprpc_generator::GetUpdateResponses(method, get_package);
-    responses.insert(method_responses.begin(), method_responses.end());
-    responses.insert(ddprpc_generator::GetCompletionResponse(method, get_package));
+// Index of the descriptors in a CodeGeneratorRequest, built once per
+// request and shared by every language back-end. Messages are hashed by
+// name across the transitive dependency closure of the request's files
+// and the response options of every method are split up front, so the
+// generators never rescan files or re-tokenize option strings.
+//
+// The index is immutable after construction and can be read from
+// several generation jobs at once.
+class DescriptorIndex {
+ public:
+  explicit DescriptorIndex(const std::vector<const google::protobuf::FileDescriptor*>& files) {
+    std::vector<const google::protobuf::FileDescriptor*> pending(files.rbegin(), files.rend());
+    std::set<const google::protobuf::FileDescriptor*> visited;
+
+    // Walk the files depth first in request order so that, just like the
+    // old per-file lookup, an unqualified name resolves to the first
+    // message with that name that is reachable from the request.
+    while (!pending.empty()) {
+      const google::protobuf::FileDescriptor* file = pending.back();
+      pending.pop_back();
+      if (!visited.insert(file).second) {
+        continue;
+      }
+
+      for (int i = 0; i < file->message_type_count(); ++i) {
+        const google::protobuf::Descriptor* message = file->message_type(i);
+        messages_.insert(std::make_pair(message->full_name(), message));
+        messages_.insert(std::make_pair(message->name(), message));
+      }
+      for (int i = 0; i < file->service_count(); ++i) {
+        IndexService(file->service(i));
+      }
+      for (int i = file->dependency_count() - 1; i >= 0; --i) {
+        pending.push_back(file->dependency(i));
+      }
+    }
   }
-  return responses;
-}
 
-inline std::set<std::string> GetUniqueResponses(const google::protobuf::FileDescriptor* file,
-                                                const bool& get_package = false) {
-  std::set<std::string> responses;
-  for (int i = 0; i < file->service_count(); ++i) {
-    const std::set<std::string> service_responses = GetUniqueResponses(file->service(i), get_package);
-    responses.insert(service_responses.begin(), service_responses.end());
+  // Find a top level message by its fully qualified or unqualified name.
+  // Returns NULL if there is no such message.
+  const google::protobuf::Descriptor* FindMessageByName(const std::string& name) const {
+    std::unordered_map<std::string, const google::protobuf::Descriptor*>::const_iterator it =
+        messages_.find(name);
+    return it == messages_.end() ? NULL : it->second;
+  }
+
+  // Find a top level message by name as seen from file: in the package
+  // of file first, then in its direct dependencies, and only then
+  // anywhere in the request. Returns NULL if there is no such message.
+  const google::protobuf::Descriptor* FindMessageByName(const google::protobuf::FileDescriptor* file,
+                                                        const std::string& name) const {
+    const google::protobuf::Descriptor* message = file->FindMessageTypeByName(name);
+    for (int i = 0; message == NULL && i < file->dependency_count(); ++i) {
+      message = file->dependency(i)->FindMessageTypeByName(name);
+    }
+    return message != NULL ? message : FindMessageByName(name);
+  }
+
+  // The update responses of method, either the message names or their
+  // packages when get_package is set. Empty if method was not indexed.
+  const std::vector<std::string>& GetUpdateResponses(
+      const google::protobuf::MethodDescriptor* method, const bool& get_package = false) const {
+    const Responses& responses = FindResponses(method);
+    return get_package ? responses.update_packages : responses.update_names;
+  }
+
+  // The completion response of method, either the message name or its
+  // package when get_package is set. Empty if method was not indexed.
+  const std::string& GetCompletionResponse(
+      const google::protobuf::MethodDescriptor* method, const bool& get_package = false) const {
+    const Responses& responses = FindResponses(method);
+    return get_package ? responses.completion_package : responses.completion_name;
+  }
+
+  // Every update and completion response used by the methods of service.
+  // Empty if service was not indexed.
+  const std::set<std::string>& GetUniqueResponses(
+      const google::protobuf::ServiceDescriptor* service, const bool& get_package = false) const {
+    static const std::set<std::string> kNoResponses;
+    const std::unordered_map<const google::protobuf::ServiceDescriptor*, std::set<std::string> >&
+        service_responses = service_responses_[get_package ? 1 : 0];
+    std::unordered_map<const google::protobuf::ServiceDescriptor*, std::set<std::string> >::const_iterator it =
+        service_responses.find(service);
+    return it == service_responses.end() ? kNoResponses : it->second;
+  }
+
+  // Every update and completion response used by the services of file.
+  std::set<std::string> GetUniqueResponses(
+      const google::protobuf::FileDescriptor* file, const bool& get_package = false) const {
+    std::set<std::string> responses;
+    for (int i = 0; i < file->service_count(); ++i) {
+      const std::set<std::string>& service_responses = GetUniqueResponses(file->service(i), get_package);
+      responses.insert(service_responses.begin(), service_responses.end());
+    }
+    return responses;
   }
-  return responses;
-}
 
-inline const google::protobuf::Descriptor* FindMessageByName(const google::protobuf::FileDescriptor* file,
-                                                             const std::string& messageName) {
-  const google::protobuf::Descriptor* response = file->FindMessageTypeByName(messageName);
-  if (response == NULL) {
-    for (int i = 0; i < file->dependency_count(); ++i) {
-      const google::protobuf::FileDescriptor* dep = file->dependency(i);
-      response = dep->FindMessageTypeByName(messageName);
-      if (response != NULL) {
-        break;
+ private:
+  struct Responses {
+    std::vector<std::string> update_names;
+    std::vector<std::string> update_packages;
+    std::string completion_name;
+    std::string completion_package;
+  };
+
+  const Responses& FindResponses(const google::protobuf::MethodDescriptor* method) const {
+    static const Responses kNoResponses;
+    std::unordered_map<const google::protobuf::MethodDescriptor*, Responses>::const_iterator it =
+        method_responses_.find(method);
+    return it == method_responses_.end() ? kNoResponses : it->second;
+  }
+
+  // Split a response option of the form "package.Name".
+  static void SplitResponse(const std::string& response, std::string* package, std::string* name) {
+    const std::vector<std::string> tokens = tokenize(response, ".");
+    (*package) = tokens[0];
+    (*name) = tokens.size() > 1 ? tokens[1] : "";
+  }
+
+  void IndexService(const google::protobuf::ServiceDescriptor* service) {
+    std::set<std::string>& names = service_responses_[0][service];
+    std::set<std::string>& packages = service_responses_[1][service];
+
+    for (int i = 0; i < service->method_count(); ++i) {
+      const google::protobuf::MethodDescriptor* method = service->method(i);
+      const google::protobuf::MethodOptions& options = method->options();
+      Responses& responses = method_responses_[method];
+
+      const int update_count = options.ExtensionSize(dotdashpay::api::common::update_response);
+      responses.update_packages.resize(update_count);
+      responses.update_names.resize(update_count);
+      for (int j = 0; j < update_count; ++j) {
+        SplitResponse(options.GetExtension(dotdashpay::api::common::update_response, j),
+                      &responses.update_packages[j], &responses.update_names[j]);
       }
+      SplitResponse(options.GetExtension(dotdashpay::api::common::completion_response),
+                    &responses.completion_package, &responses.completion_name);
+
+      names.insert(responses.update_names.begin(), responses.update_names.end());
+      names.insert(responses.completion_name);
+      packages.insert(responses.update_packages.begin(), responses.update_packages.end());
+      packages.insert(responses.completion_package);
     }
   }
 
-  return response;
-}
+  std::unordered_map<std::string, const google::protobuf::Descriptor*> messages_;
+  std::unordered_map<const google::protobuf::MethodDescriptor*, Responses> method_responses_;
+  // Indexed by get_package.
+  std::unordered_map<const google::protobuf::ServiceDescriptor*, std::set<std::string> > service_responses_[2];
+};
 
 }  // namespace ddprpc_generator
 
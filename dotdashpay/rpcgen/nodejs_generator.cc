@@ -37,8 +37,12 @@
 #include <dotdashpay/api/common/protobuf/api_common.pb.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/printer.h>
-#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 #include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
@@ -80,13 +84,11 @@ const char* GetLodashChecker(const google::protobuf::FieldDescriptor* descriptor
   return nullptr;
 }
 
+// The lodash checks the generator emitted before it compiled a
+// validator per message. They are only printed as the baseline of the
+// validator benchmarks.
 string GetFieldCheckingStatements(const string& field_name, const google::protobuf::FieldDescriptor* descriptor) {
   if (!descriptor->is_required() || (descriptor->is_required() && descriptor->has_default_value())) {
-    if (descriptor->is_required()) {
-      fprintf(stderr,
-              "FYI: The field [%s] is required, but has a default set so it will be allowed to be undefined.\n",
-              field_name.c_str());
-    }
     return "false";
   }
 
@@ -100,120 +102,1521 @@ string GetFieldCheckingStatements(const string& field_name, const google::protob
   }
 }
 
+// Only required fields without a default have to be passed.
+bool IsValidatedField(const google::protobuf::FieldDescriptor* descriptor) {
+  return descriptor->is_required() && !descriptor->has_default_value();
+}
+
+// The name of a message or enum within its package, usable as part of
+// a JavaScript identifier.
+template <class Descriptor>
+string GetLocalName(const Descriptor* descriptor) {
+  string name = descriptor->full_name();
+  if (!descriptor->file()->package().empty()) {
+    name = name.substr(descriptor->file()->package().size() + 1);
+  }
+  return StringReplace(name, ".", "_");
+}
+
+// A condition on `value` that holds when it cannot be passed as the
+// field.
+string GetInvalidCondition(const google::protobuf::FieldDescriptor* descriptor) {
+  switch (descriptor->type()) {
+    case google::protobuf::FieldDescriptor::TYPE_INT32:
+    case google::protobuf::FieldDescriptor::TYPE_SINT32:
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+      return "typeof value !== \"number\" || (value | 0) !== value";
+    case google::protobuf::FieldDescriptor::TYPE_UINT32:
+    case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+      return "typeof value !== \"number\" || (value >>> 0) !== value";
+    case google::protobuf::FieldDescriptor::TYPE_INT64:
+    case google::protobuf::FieldDescriptor::TYPE_SINT64:
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+      return "!isInt64(value)";
+    case google::protobuf::FieldDescriptor::TYPE_UINT64:
+    case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+      return "!isUint64(value)";
+    case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+    case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+      return "typeof value !== \"number\"";
+    case google::protobuf::FieldDescriptor::TYPE_BOOL:
+      return "typeof value !== \"boolean\"";
+    case google::protobuf::FieldDescriptor::TYPE_STRING:
+      return "typeof value !== \"string\"";
+    case google::protobuf::FieldDescriptor::TYPE_MESSAGE:
+    case google::protobuf::FieldDescriptor::TYPE_GROUP:
+      return "typeof value !== \"object\" || value === null";
+    case google::protobuf::FieldDescriptor::TYPE_ENUM:
+      return "!is" + GetLocalName(descriptor->enum_type()) + "(value)";
+    case google::protobuf::FieldDescriptor::TYPE_BYTES:
+    default:
+      return "value === undefined || value === null";
+  }
+}
+
+// A valid example of the field for the validator benchmarks.
+string GetSampleValue(const google::protobuf::FieldDescriptor* descriptor) {
+  if (descriptor->is_repeated()) {
+    return "[]";
+  }
+  switch (descriptor->type()) {
+    case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+    case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+      return "1.5";
+    case google::protobuf::FieldDescriptor::TYPE_BOOL:
+      return "true";
+    case google::protobuf::FieldDescriptor::TYPE_STRING:
+      return "\"example\"";
+    case google::protobuf::FieldDescriptor::TYPE_BYTES:
+      return "\"\"";
+    case google::protobuf::FieldDescriptor::TYPE_MESSAGE:
+    case google::protobuf::FieldDescriptor::TYPE_GROUP:
+      return "{}";
+    case google::protobuf::FieldDescriptor::TYPE_ENUM:
+      return std::to_string(descriptor->enum_type()->value(0)->number());
+    default:
+      return "1";
+  }
+}
+
+// A JavaScript string literal holding bytes.
+string GetStringLiteral(const string& bytes) {
+  string literal = "\"";
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    const unsigned char c = bytes[i];
+    if (c == '"' || c == '\\') {
+      literal += '\\';
+      literal += c;
+    } else if (c < 0x20 || c >= 0x7f) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+      literal += escaped;
+    } else {
+      literal += c;
+    }
+  }
+  return literal + "\"";
+}
+
+// The shortest JavaScript number literal that reads back as value in
+// the given number of significant digits.
+string GetNumberLiteral(double value, bool is_float) {
+  if (value != value) {
+    return "NaN";
+  }
+  if (value == std::numeric_limits<double>::infinity()) {
+    return "Infinity";
+  }
+  if (value == -std::numeric_limits<double>::infinity()) {
+    return "-Infinity";
+  }
+  char literal[40];
+  for (int precision = is_float ? 6 : 15; precision <= 17; ++precision) {
+    snprintf(literal, sizeof(literal), "%.*g", precision, value);
+    const double parsed = strtod(literal, NULL);
+    if (is_float ? static_cast<float>(parsed) == static_cast<float>(value) : parsed == value) {
+      break;
+    }
+  }
+  return literal;
+}
+
+// A 64-bit integer as a number literal while it is exactly
+// representable, and as a decimal string beyond that.
+template <class Integer>
+string GetInt64Literal(Integer value) {
+  const Integer max_safe_integer = 9007199254740991LL;
+  const string digits = std::to_string(value);
+  if (value <= max_safe_integer && !(value < 0 && -(value + 1) >= max_safe_integer)) {
+    return digits;
+  }
+  return "\"" + digits + "\"";
+}
+
+// A JavaScript literal for the default value of descriptor, computed
+// from the descriptor so that no default is looked up at run time.
+string GetDefaultValueLiteral(const google::protobuf::FieldDescriptor* descriptor) {
+  switch (descriptor->cpp_type()) {
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+      return std::to_string(descriptor->default_value_int32());
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+      return std::to_string(descriptor->default_value_uint32());
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+      return GetInt64Literal(descriptor->default_value_int64());
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+      return GetInt64Literal(descriptor->default_value_uint64());
+    case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+      return GetNumberLiteral(descriptor->default_value_float(), true);
+    case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+      return GetNumberLiteral(descriptor->default_value_double(), false);
+    case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+      return descriptor->default_value_bool() ? "true" : "false";
+    case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+      return std::to_string(descriptor->default_value_enum()->number());
+    case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+      return GetStringLiteral(descriptor->default_value_string());
+    case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+    default:
+      return "undefined";
+  }
+}
+
+// The argument messages of the methods of service, in the order they
+// are first used.
+vector<const google::protobuf::Descriptor*> GetArgsMessages(const google::protobuf::ServiceDescriptor* service) {
+  vector<const google::protobuf::Descriptor*> messages;
+  set<const google::protobuf::Descriptor*> seen;
+  for (int i = 0; i < service->method_count(); ++i) {
+    if (seen.insert(service->method(i)->input_type()).second) {
+      messages.push_back(service->method(i)->input_type());
+    }
+  }
+  return messages;
+}
+
+
+// The wire type of a field that is not packed.
+int GetWireType(const google::protobuf::FieldDescriptor* descriptor) {
+  switch (descriptor->type()) {
+    case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+    case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+      return 1;
+    case google::protobuf::FieldDescriptor::TYPE_STRING:
+    case google::protobuf::FieldDescriptor::TYPE_BYTES:
+    case google::protobuf::FieldDescriptor::TYPE_MESSAGE:
+      return 2;
+    case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+    case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+      return 5;
+    default:
+      return 0;
+  }
+}
+
+// The method of Writer and Reader that handles a scalar field.
+const char* GetWireMethod(const google::protobuf::FieldDescriptor* descriptor) {
+  switch (descriptor->type()) {
+    case google::protobuf::FieldDescriptor::TYPE_SINT32:
+      return "sint32";
+    case google::protobuf::FieldDescriptor::TYPE_UINT32:
+      return "uint32";
+    case google::protobuf::FieldDescriptor::TYPE_INT64:
+      return "int64";
+    case google::protobuf::FieldDescriptor::TYPE_UINT64:
+      return "uint64";
+    case google::protobuf::FieldDescriptor::TYPE_SINT64:
+      return "sint64";
+    case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+      return "fixed32";
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+      return "sfixed32";
+    case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+      return "fixed64";
+    case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+      return "sfixed64";
+    case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+      return "float";
+    case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+      return "double";
+    case google::protobuf::FieldDescriptor::TYPE_BOOL:
+      return "bool";
+    case google::protobuf::FieldDescriptor::TYPE_STRING:
+      return "string";
+    case google::protobuf::FieldDescriptor::TYPE_BYTES:
+      return "bytes";
+    case google::protobuf::FieldDescriptor::TYPE_INT32:
+    case google::protobuf::FieldDescriptor::TYPE_ENUM:
+    default:
+      return "int32";
+  }
+}
+
+// The value a decoded message holds for a field that is not on the
+// wire.
+string GetDecodedDefault(const google::protobuf::FieldDescriptor* descriptor) {
+  if (descriptor->is_repeated()) {
+    return "[]";
+  }
+  if (descriptor->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+    return "null";
+  }
+  if (descriptor->type() == google::protobuf::FieldDescriptor::TYPE_BYTES) {
+    if (descriptor->default_value_string().empty()) {
+      return "Buffer.alloc(0)";
+    }
+    return "Buffer.from(" + GetStringLiteral(descriptor->default_value_string()) + ", \"latin1\")";
+  }
+  return GetDefaultValueLiteral(descriptor);
+}
+
+void AddCodecMessage(const google::protobuf::Descriptor* message,
+                     set<const google::protobuf::Descriptor*>* seen,
+                     vector<const google::protobuf::Descriptor*>* messages) {
+  if (message == NULL || !seen->insert(message).second) {
+    return;
+  }
+  messages->push_back(message);
+  for (int i = 0; i < message->field_count(); ++i) {
+    if (message->field(i)->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE) {
+      AddCodecMessage(message->field(i)->message_type(), seen, messages);
+    }
+  }
+}
+
+// The messages the methods of service send and receive and every
+// message they contain, in the order they are first used.
+vector<const google::protobuf::Descriptor*> GetCodecMessages(const google::protobuf::ServiceDescriptor* service,
+                                                             const DescriptorIndex &index) {
+  vector<const google::protobuf::Descriptor*> messages;
+  set<const google::protobuf::Descriptor*> seen;
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor* method = service->method(i);
+    AddCodecMessage(method->input_type(), &seen, &messages);
+    const vector<string>& update_responses = index.GetUpdateResponses(method);
+    for (auto response = update_responses.begin(); response != update_responses.end(); response++) {
+      AddCodecMessage(index.FindMessageByName(method->file(), *response), &seen, &messages);
+    }
+    AddCodecMessage(index.FindMessageByName(method->file(), index.GetCompletionResponse(method)),
+                    &seen, &messages);
+  }
+  return messages;
+}
+
 }  // namespace
 
-string GetPrologue(const google::protobuf::FileDescriptor *file, const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
+void PrintPrologue(google::protobuf::io::Printer *printer,
+                   const google::protobuf::FileDescriptor *file,
+                   const Parameters &params) {
+  map<string, string> vars;
+
+  vars["filename"] = file->name();
+
+  vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
+  vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
+
+  printer->Print(vars, "//\n");
+  printer->Print(vars, "//  Automatically generated from $filename$\n");
+  printer->Print(vars, "//  DO NOT EDIT THIS FILE DIRECTLY.\n");
+  printer->Print(vars, "//\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "const DDP_API_MAJOR_VERSION = $major_version$;\n");
+  printer->Print(vars, "const DDP_API_MINOR_VERSION = $minor_version$;\n");
+  printer->Print(vars, "\n");
+}
+
+void PrintArgsValidators(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  const vector<const google::protobuf::Descriptor*> messages = GetArgsMessages(service);
+
+  // The helpers the validators share: an is<Enum> function per enum
+  // and the 64-bit integer checks.
+  set<const google::protobuf::EnumDescriptor*> enums;
+  bool has_int64 = false;
+  bool has_uint64 = false;
+  for (auto message = messages.begin(); message != messages.end(); message++) {
+    for (int i = 0; i < (*message)->field_count(); ++i) {
+      const google::protobuf::FieldDescriptor* field = (*message)->field(i);
+      if (!IsValidatedField(field)) {
+        continue;
+      }
+      switch (field->type()) {
+        case google::protobuf::FieldDescriptor::TYPE_ENUM:
+          if (enums.insert(field->enum_type()).second) {
+            vars["Enum"] = GetLocalName(field->enum_type());
+            printer->Print(vars, "function is$Enum$(value) {\n");
+            printer->Print(vars, "  switch (value) {\n");
+            set<int> numbers;
+            for (int j = 0; j < field->enum_type()->value_count(); ++j) {
+              if (numbers.insert(field->enum_type()->value(j)->number()).second) {
+                vars["Value"] = std::to_string(field->enum_type()->value(j)->number());
+                printer->Print(vars, "    case $Value$:\n");
+              }
+            }
+            for (int j = 0; j < field->enum_type()->value_count(); ++j) {
+              vars["Value"] = field->enum_type()->value(j)->name();
+              printer->Print(vars, "    case \"$Value$\":\n");
+            }
+            printer->Print(vars, "      return true;\n");
+            printer->Print(vars, "    default:\n");
+            printer->Print(vars, "      return false;\n");
+            printer->Print(vars, "  }\n");
+            printer->Print(vars, "}\n\n");
+          }
+          break;
+        case google::protobuf::FieldDescriptor::TYPE_INT64:
+        case google::protobuf::FieldDescriptor::TYPE_SINT64:
+        case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+          has_int64 = true;
+          break;
+        case google::protobuf::FieldDescriptor::TYPE_UINT64:
+        case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+          has_uint64 = true;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  if (has_int64) {
+    printer->Print(vars, "// An integral number, a decimal string or a Long.\n");
+    printer->Print(vars, "function isInt64(value) {\n");
+    printer->Print(vars, "  switch (typeof value) {\n");
+    printer->Print(vars, "    case \"number\":\n");
+    printer->Print(vars, "      return value === Math.floor(value) && isFinite(value);\n");
+    printer->Print(vars, "    case \"string\":\n");
+    printer->Print(vars, "      return /^-?[0-9]+$$/.test(value);\n");
+    printer->Print(vars, "    case \"object\":\n");
+    printer->Print(vars, "      return value !== null && typeof value.low === \"number\" && typeof value.high === \"number\";\n");
+    printer->Print(vars, "    default:\n");
+    printer->Print(vars, "      return false;\n");
+    printer->Print(vars, "  }\n");
+    printer->Print(vars, "}\n\n");
+  }
+  if (has_uint64) {
+    printer->Print(vars, "// A non-negative integral number, a decimal string or a Long.\n");
+    printer->Print(vars, "function isUint64(value) {\n");
+    printer->Print(vars, "  switch (typeof value) {\n");
+    printer->Print(vars, "    case \"number\":\n");
+    printer->Print(vars, "      return value === Math.floor(value) && isFinite(value) && value >= 0;\n");
+    printer->Print(vars, "    case \"string\":\n");
+    printer->Print(vars, "      return /^[0-9]+$$/.test(value);\n");
+    printer->Print(vars, "    case \"object\":\n");
+    printer->Print(vars, "      return value !== null && typeof value.low === \"number\" && typeof value.high === \"number\";\n");
+    printer->Print(vars, "    default:\n");
+    printer->Print(vars, "      return false;\n");
+    printer->Print(vars, "  }\n");
+    printer->Print(vars, "}\n\n");
+  }
+
+  for (auto message = messages.begin(); message != messages.end(); message++) {
+    vars["Message"] = GetLocalName(*message);
+    printer->Print(vars, "// Throw if $Message$ is missing a required field or has one of\n");
+    printer->Print(vars, "// the wrong type. method names the call in the error.\n");
+    printer->Print(vars, "function validate$Message$(method, args) {\n");
+    printer->Indent();
+    bool first = true;
+    for (int i = 0; i < (*message)->field_count(); ++i) {
+      const google::protobuf::FieldDescriptor* field = (*message)->field(i);
+      if (!IsValidatedField(field)) {
+        continue;
+      }
+      vars["FieldName"] = field->name();
+      vars["Invalid"] = GetInvalidCondition(field);
+      if (!first) {
+        printer->Print("\n");
+      }
+      printer->Print(vars, first ? "var value = args.$FieldName$;\n" : "value = args.$FieldName$;\n");
+      printer->Print(vars, "if ($Invalid$) {\n");
+      printer->Print(vars, "  throw Error(\"in `\" + method + \"`, `$FieldName$` has incorrect type: \" + typeof(value));\n");
+      printer->Print(vars, "}\n");
+      first = false;
+    }
+    printer->Outdent();
+    printer->Print(vars, "}\n\n");
+  }
+}
+
+void PrintArgsDefaults(google::protobuf::io::Printer *printer,
+                       const google::protobuf::ServiceDescriptor* service,
+                       const Parameters &params) {
+  map<string, string> vars;
+
+  const vector<const google::protobuf::Descriptor*> messages = GetArgsMessages(service);
+  for (auto message = messages.begin(); message != messages.end(); message++) {
+    vector<const google::protobuf::FieldDescriptor*> fields;
+    for (int i = 0; i < (*message)->field_count(); ++i) {
+      if ((*message)->field(i)->has_default_value()) {
+        fields.push_back((*message)->field(i));
+      }
+    }
+    if (fields.empty()) {
+      continue;
+    }
+
+    vars["Message"] = GetLocalName(*message);
+    printer->Print(vars, "// The default values of the $Message$ fields that have one.\n");
+    printer->Print(vars, "var $Message$Defaults = {\n");
+    printer->Indent();
+    for (size_t i = 0; i < fields.size(); ++i) {
+      vars["FieldName"] = fields[i]->name();
+      vars["Default"] = GetDefaultValueLiteral(fields[i]);
+      printer->Print(vars, i + 1 < fields.size() ? "$FieldName$: $Default$,\n" : "$FieldName$: $Default$\n");
+    }
+    printer->Outdent();
+    printer->Print(vars, "};\n\n");
+  }
+}
+
+void PrintCodecRuntime(google::protobuf::io::Printer *printer, const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars, "// The low and high 32 bits of a 64-bit integer given as a number, a\n");
+  printer->Print(vars, "// decimal string or a Long.\n");
+  printer->Print(vars, "function splitInt64(value) {\n");
+  printer->Print(vars, "  if (typeof value === \"object\") {\n");
+  printer->Print(vars, "    return [value.low >>> 0, value.high >>> 0];\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  var negative, lo = 0, hi = 0;\n");
+  printer->Print(vars, "  if (typeof value === \"number\") {\n");
+  printer->Print(vars, "    negative = value < 0;\n");
+  printer->Print(vars, "    value = Math.abs(value);\n");
+  printer->Print(vars, "    lo = value >>> 0;\n");
+  printer->Print(vars, "    hi = Math.floor(value / 4294967296) >>> 0;\n");
+  printer->Print(vars, "  } else {\n");
+  printer->Print(vars, "    var digits = String(value);\n");
+  printer->Print(vars, "    negative = digits.charAt(0) === \"-\";\n");
+  printer->Print(vars, "    for (var i = negative ? 1 : 0; i < digits.length; i += 6) {\n");
+  printer->Print(vars, "      var chunk = digits.slice(i, i + 6);\n");
+  printer->Print(vars, "      var scale = Math.pow(10, chunk.length);\n");
+  printer->Print(vars, "      var low = lo * scale + Number(chunk);\n");
+  printer->Print(vars, "      hi = (hi * scale + Math.floor(low / 4294967296)) % 4294967296;\n");
+  printer->Print(vars, "      lo = low % 4294967296;\n");
+  printer->Print(vars, "    }\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  if (negative) {\n");
+  printer->Print(vars, "    lo = (~lo + 1) >>> 0;\n");
+  printer->Print(vars, "    hi = (~hi + (lo === 0 ? 1 : 0)) >>> 0;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  return [lo, hi];\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// A 64-bit integer as a number while it is exactly representable and\n");
+  printer->Print(vars, "// as a decimal string beyond that.\n");
+  printer->Print(vars, "function joinInt64(lo, hi, signed) {\n");
+  printer->Print(vars, "  var negative = signed && hi >>> 31 === 1;\n");
+  printer->Print(vars, "  if (negative) {\n");
+  printer->Print(vars, "    lo = (~lo + 1) >>> 0;\n");
+  printer->Print(vars, "    hi = (~hi + (lo === 0 ? 1 : 0)) >>> 0;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  if (hi < 0x200000) {\n");
+  printer->Print(vars, "    var value = hi * 4294967296 + lo;\n");
+  printer->Print(vars, "    return negative ? -value : value;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  var digits = \"\";\n");
+  printer->Print(vars, "  while (hi) {\n");
+  printer->Print(vars, "    var low = (hi % 1000000) * 4294967296 + lo;\n");
+  printer->Print(vars, "    hi = Math.floor(hi / 1000000);\n");
+  printer->Print(vars, "    lo = Math.floor(low / 1000000);\n");
+  printer->Print(vars, "    digits = String(1000000 + low % 1000000).slice(1) + digits;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  return (negative ? \"-\" : \"\") + lo + digits;\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Appends the wire format of fields to a Buffer that grows as needed.\n");
+  printer->Print(vars, "function Writer() {\n");
+  printer->Print(vars, "  this.buffer = Buffer.allocUnsafe(64);\n");
+  printer->Print(vars, "  this.length = 0;\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.reserve = function(size) {\n");
+  printer->Print(vars, "  if (this.length + size > this.buffer.length) {\n");
+  printer->Print(vars, "    var buffer = Buffer.allocUnsafe(Math.max(this.buffer.length * 2, this.length + size));\n");
+  printer->Print(vars, "    this.buffer.copy(buffer, 0, 0, this.length);\n");
+  printer->Print(vars, "    this.buffer = buffer;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.uint32 = function(value) {\n");
+  printer->Print(vars, "  this.reserve(5);\n");
+  printer->Print(vars, "  value >>>= 0;\n");
+  printer->Print(vars, "  while (value > 127) {\n");
+  printer->Print(vars, "    this.buffer[this.length++] = (value & 127) | 128;\n");
+  printer->Print(vars, "    value >>>= 7;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  this.buffer[this.length++] = value;\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.varint64 = function(lo, hi) {\n");
+  printer->Print(vars, "  this.reserve(10);\n");
+  printer->Print(vars, "  while (hi) {\n");
+  printer->Print(vars, "    this.buffer[this.length++] = (lo & 127) | 128;\n");
+  printer->Print(vars, "    lo = ((lo >>> 7) | (hi << 25)) >>> 0;\n");
+  printer->Print(vars, "    hi >>>= 7;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  return this.uint32(lo);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.int32 = function(value) {\n");
+  printer->Print(vars, "  return value < 0 ? this.varint64(value >>> 0, 4294967295) : this.uint32(value);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.sint32 = function(value) {\n");
+  printer->Print(vars, "  return this.uint32((value << 1) ^ (value >> 31));\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.bool = function(value) {\n");
+  printer->Print(vars, "  return this.uint32(value ? 1 : 0);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.int64 = Writer.prototype.uint64 = function(value) {\n");
+  printer->Print(vars, "  var bits = splitInt64(value);\n");
+  printer->Print(vars, "  return this.varint64(bits[0], bits[1]);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.sint64 = function(value) {\n");
+  printer->Print(vars, "  var bits = splitInt64(value);\n");
+  printer->Print(vars, "  var sign = bits[1] >> 31;\n");
+  printer->Print(vars, "  return this.varint64(((bits[0] << 1) ^ sign) >>> 0, (((bits[1] << 1) | (bits[0] >>> 31)) ^ sign) >>> 0);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.fixed32 = function(value) {\n");
+  printer->Print(vars, "  this.reserve(4);\n");
+  printer->Print(vars, "  this.length = this.buffer.writeUInt32LE(value >>> 0, this.length);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.sfixed32 = function(value) {\n");
+  printer->Print(vars, "  this.reserve(4);\n");
+  printer->Print(vars, "  this.length = this.buffer.writeInt32LE(value | 0, this.length);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.fixed64 = Writer.prototype.sfixed64 = function(value) {\n");
+  printer->Print(vars, "  var bits = splitInt64(value);\n");
+  printer->Print(vars, "  this.reserve(8);\n");
+  printer->Print(vars, "  this.buffer.writeUInt32LE(bits[0], this.length);\n");
+  printer->Print(vars, "  this.length = this.buffer.writeUInt32LE(bits[1], this.length + 4);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.float = function(value) {\n");
+  printer->Print(vars, "  this.reserve(4);\n");
+  printer->Print(vars, "  this.length = this.buffer.writeFloatLE(value, this.length);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.double = function(value) {\n");
+  printer->Print(vars, "  this.reserve(8);\n");
+  printer->Print(vars, "  this.length = this.buffer.writeDoubleLE(value, this.length);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.string = function(value) {\n");
+  printer->Print(vars, "  var size = Buffer.byteLength(value);\n");
+  printer->Print(vars, "  this.uint32(size);\n");
+  printer->Print(vars, "  this.reserve(size);\n");
+  printer->Print(vars, "  this.length += this.buffer.write(value, this.length, size, \"utf8\");\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Takes a Buffer or a base64 string, just like protobuf.js.\n");
+  printer->Print(vars, "Writer.prototype.bytes = function(value) {\n");
+  printer->Print(vars, "  if (!Buffer.isBuffer(value)) {\n");
+  printer->Print(vars, "    value = Buffer.from(value, \"base64\");\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  this.uint32(value.length);\n");
+  printer->Print(vars, "  this.reserve(value.length);\n");
+  printer->Print(vars, "  this.length += value.copy(this.buffer, this.length);\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Starts a length delimited field whose size is not known yet. Pass the\n");
+  printer->Print(vars, "// result to ldelim once its content is written.\n");
+  printer->Print(vars, "Writer.prototype.fork = function() {\n");
+  printer->Print(vars, "  return this.length;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.ldelim = function(start) {\n");
+  printer->Print(vars, "  var size = this.length - start;\n");
+  printer->Print(vars, "  var prefix = 1;\n");
+  printer->Print(vars, "  for (var rest = size >>> 7; rest; rest >>>= 7) {\n");
+  printer->Print(vars, "    prefix++;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  this.reserve(prefix);\n");
+  printer->Print(vars, "  this.buffer.copy(this.buffer, start + prefix, start, this.length);\n");
+  printer->Print(vars, "  this.length = start;\n");
+  printer->Print(vars, "  this.uint32(size);\n");
+  printer->Print(vars, "  this.length += size;\n");
+  printer->Print(vars, "  return this;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Writer.prototype.finish = function() {\n");
+  printer->Print(vars, "  return this.buffer.slice(0, this.length);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Reads fields from the wire format in a Buffer.\n");
+  printer->Print(vars, "function Reader(buffer) {\n");
+  printer->Print(vars, "  this.buffer = buffer;\n");
+  printer->Print(vars, "  this.pos = 0;\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.advance = function(size) {\n");
+  printer->Print(vars, "  if (this.pos + size > this.buffer.length) {\n");
+  printer->Print(vars, "    throw Error(\"truncated message\");\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  var pos = this.pos;\n");
+  printer->Print(vars, "  this.pos += size;\n");
+  printer->Print(vars, "  return pos;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.uint32 = function() {\n");
+  printer->Print(vars, "  var value = 0;\n");
+  printer->Print(vars, "  for (var shift = 0; ; shift += 7) {\n");
+  printer->Print(vars, "    var b = this.buffer[this.advance(1)];\n");
+  printer->Print(vars, "    if (shift < 32) {\n");
+  printer->Print(vars, "      value |= (b & 127) << shift;\n");
+  printer->Print(vars, "    }\n");
+  printer->Print(vars, "    if (b < 128) {\n");
+  printer->Print(vars, "      return value >>> 0;\n");
+  printer->Print(vars, "    }\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Reads a varint into lo and hi.\n");
+  printer->Print(vars, "Reader.prototype.varint64 = function() {\n");
+  printer->Print(vars, "  this.lo = 0;\n");
+  printer->Print(vars, "  this.hi = 0;\n");
+  printer->Print(vars, "  for (var shift = 0; ; shift += 7) {\n");
+  printer->Print(vars, "    var b = this.buffer[this.advance(1)];\n");
+  printer->Print(vars, "    if (shift < 28) {\n");
+  printer->Print(vars, "      this.lo |= (b & 127) << shift;\n");
+  printer->Print(vars, "    } else if (shift === 28) {\n");
+  printer->Print(vars, "      this.lo |= (b & 127) << 28;\n");
+  printer->Print(vars, "      this.hi |= (b & 127) >>> 4;\n");
+  printer->Print(vars, "    } else if (shift < 64) {\n");
+  printer->Print(vars, "      this.hi |= (b & 127) << (shift - 32);\n");
+  printer->Print(vars, "    }\n");
+  printer->Print(vars, "    if (b < 128) {\n");
+  printer->Print(vars, "      this.lo >>>= 0;\n");
+  printer->Print(vars, "      this.hi >>>= 0;\n");
+  printer->Print(vars, "      return;\n");
+  printer->Print(vars, "    }\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.int32 = function() {\n");
+  printer->Print(vars, "  return this.uint32() | 0;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.sint32 = function() {\n");
+  printer->Print(vars, "  var value = this.uint32();\n");
+  printer->Print(vars, "  return (value >>> 1) ^ -(value & 1);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.bool = function() {\n");
+  printer->Print(vars, "  return this.uint32() !== 0;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.int64 = function() {\n");
+  printer->Print(vars, "  this.varint64();\n");
+  printer->Print(vars, "  return joinInt64(this.lo, this.hi, true);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.uint64 = function() {\n");
+  printer->Print(vars, "  this.varint64();\n");
+  printer->Print(vars, "  return joinInt64(this.lo, this.hi, false);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.sint64 = function() {\n");
+  printer->Print(vars, "  this.varint64();\n");
+  printer->Print(vars, "  var sign = -(this.lo & 1);\n");
+  printer->Print(vars, "  return joinInt64((((this.lo >>> 1) | (this.hi << 31)) ^ sign) >>> 0, ((this.hi >>> 1) ^ sign) >>> 0, true);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.fixed32 = function() {\n");
+  printer->Print(vars, "  return this.buffer.readUInt32LE(this.advance(4));\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.sfixed32 = function() {\n");
+  printer->Print(vars, "  return this.buffer.readInt32LE(this.advance(4));\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.fixed64 = function() {\n");
+  printer->Print(vars, "  var pos = this.advance(8);\n");
+  printer->Print(vars, "  return joinInt64(this.buffer.readUInt32LE(pos), this.buffer.readUInt32LE(pos + 4), false);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.sfixed64 = function() {\n");
+  printer->Print(vars, "  var pos = this.advance(8);\n");
+  printer->Print(vars, "  return joinInt64(this.buffer.readUInt32LE(pos), this.buffer.readUInt32LE(pos + 4), true);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.float = function() {\n");
+  printer->Print(vars, "  return this.buffer.readFloatLE(this.advance(4));\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.double = function() {\n");
+  printer->Print(vars, "  return this.buffer.readDoubleLE(this.advance(8));\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.string = function() {\n");
+  printer->Print(vars, "  var size = this.uint32();\n");
+  printer->Print(vars, "  var pos = this.advance(size);\n");
+  printer->Print(vars, "  return this.buffer.toString(\"utf8\", pos, pos + size);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "Reader.prototype.bytes = function() {\n");
+  printer->Print(vars, "  var size = this.uint32();\n");
+  printer->Print(vars, "  var pos = this.advance(size);\n");
+  printer->Print(vars, "  return this.buffer.slice(pos, pos + size);\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// The end of a length delimited field that starts at the current\n");
+  printer->Print(vars, "// position.\n");
+  printer->Print(vars, "Reader.prototype.end = function() {\n");
+  printer->Print(vars, "  var size = this.uint32();\n");
+  printer->Print(vars, "  if (this.pos + size > this.buffer.length) {\n");
+  printer->Print(vars, "    throw Error(\"truncated message\");\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  return this.pos + size;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "// Skips a field of an unknown number.\n");
+  printer->Print(vars, "Reader.prototype.skip = function(wireType) {\n");
+  printer->Print(vars, "  switch (wireType) {\n");
+  printer->Print(vars, "    case 0:\n");
+  printer->Print(vars, "      this.uint32();\n");
+  printer->Print(vars, "      break;\n");
+  printer->Print(vars, "    case 1:\n");
+  printer->Print(vars, "      this.advance(8);\n");
+  printer->Print(vars, "      break;\n");
+  printer->Print(vars, "    case 2:\n");
+  printer->Print(vars, "      this.advance(this.uint32());\n");
+  printer->Print(vars, "      break;\n");
+  printer->Print(vars, "    case 3:\n");
+  printer->Print(vars, "      for (var tag = this.uint32(); (tag & 7) !== 4; tag = this.uint32()) {\n");
+  printer->Print(vars, "        this.skip(tag & 7);\n");
+  printer->Print(vars, "      }\n");
+  printer->Print(vars, "      break;\n");
+  printer->Print(vars, "    case 5:\n");
+  printer->Print(vars, "      this.advance(4);\n");
+  printer->Print(vars, "      break;\n");
+  printer->Print(vars, "    default:\n");
+  printer->Print(vars, "      throw Error(\"invalid wire type \" + wireType);\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "\n");
+}
+
+void PrintMessageCodec(google::protobuf::io::Printer *printer,
+                       const google::protobuf::Descriptor* message,
+                       const Parameters &params) {
+  map<string, string> vars;
+
+  vars["Message"] = GetLocalName(message);
+
+  printer->Print(vars, "function encode$Message$(message, writer) {\n");
+  printer->Indent();
+  for (int i = 0; i < message->field_count(); ++i) {
+    const google::protobuf::FieldDescriptor* field = message->field(i);
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_GROUP) {
+      continue;
+    }
+
+    vars["FieldName"] = field->name();
+    vars["WireMethod"] = GetWireMethod(field);
+    vars["Tag"] = std::to_string(static_cast<uint32_t>(field->number()) << 3 | GetWireType(field));
+    vars["Value"] = field->is_repeated() ? "message." + field->name() + "[i]" : "message." + field->name();
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE) {
+      vars["Field"] = GetLocalName(field->message_type());
+    }
+    // Enum values may be given by name, just like the validators accept.
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_ENUM) {
+      vars["Value"] = "numberOf" + GetLocalName(field->enum_type()) + "(" + vars["Value"] + ")";
+    }
+
+    if (field->is_packed()) {
+      vars["Tag"] = std::to_string(static_cast<uint32_t>(field->number()) << 3 | 2);
+      printer->Print(vars, "if (message.$FieldName$ != null && message.$FieldName$.length) {\n");
+      printer->Print(vars, "  var start = writer.uint32($Tag$).fork();\n");
+      printer->Print(vars, "  for (var i = 0; i < message.$FieldName$.length; ++i) {\n");
+      printer->Print(vars, "    writer.$WireMethod$($Value$);\n");
+      printer->Print(vars, "  }\n");
+      printer->Print(vars, "  writer.ldelim(start);\n");
+      printer->Print(vars, "}\n");
+      continue;
+    }
+
+    printer->Print(vars, "if (message.$FieldName$ != null) {\n");
+    printer->Indent();
+    if (field->is_repeated()) {
+      printer->Print(vars, "for (var i = 0; i < message.$FieldName$.length; ++i) {\n");
+      printer->Indent();
+    }
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE) {
+      printer->Print(vars, "var start = writer.uint32($Tag$).fork();\n");
+      printer->Print(vars, "encode$Field$($Value$, writer).ldelim(start);\n");
+    } else {
+      printer->Print(vars, "writer.uint32($Tag$).$WireMethod$($Value$);\n");
+    }
+    if (field->is_repeated()) {
+      printer->Outdent();
+      printer->Print(vars, "}\n");
+    }
+    printer->Outdent();
+    printer->Print(vars, "}\n");
+  }
+  printer->Print(vars, "return writer;\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
+
+  printer->Print(vars, "function decode$Message$(reader, end) {\n");
+  printer->Indent();
+  if (message->field_count() == 0) {
+    printer->Print(vars, "var message = {};\n");
+  } else {
+    printer->Print(vars, "var message = {\n");
+    printer->Indent();
+    for (int i = 0; i < message->field_count(); ++i) {
+      vars["FieldName"] = message->field(i)->name();
+      vars["Default"] = GetDecodedDefault(message->field(i));
+      printer->Print(vars, i + 1 < message->field_count() ? "$FieldName$: $Default$,\n" : "$FieldName$: $Default$\n");
+    }
+    printer->Outdent();
+    printer->Print(vars, "};\n");
+  }
+  printer->Print(vars, "while (reader.pos < end) {\n");
+  printer->Print(vars, "  var tag = reader.uint32();\n");
+  printer->Print(vars, "  switch (tag >>> 3) {\n");
+  printer->Indent();
+  printer->Indent();
+  for (int i = 0; i < message->field_count(); ++i) {
+    const google::protobuf::FieldDescriptor* field = message->field(i);
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_GROUP) {
+      continue;
+    }
 
-    vars["filename"] = file->name();
+    vars["FieldName"] = field->name();
+    vars["FieldNumber"] = std::to_string(field->number());
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE) {
+      vars["Read"] = "decode" + GetLocalName(field->message_type()) + "(reader, reader.end())";
+    } else {
+      vars["Read"] = string("reader.") + GetWireMethod(field) + "()";
+    }
+
+    printer->Print(vars, "case $FieldNumber$:\n");
+    printer->Indent();
+    if (!field->is_repeated()) {
+      printer->Print(vars, "message.$FieldName$ = $Read$;\n");
+    } else if (field->is_packable()) {
+      // Parsers must accept packed and unpacked encodings of either.
+      printer->Print(vars, "if ((tag & 7) === 2) {\n");
+      printer->Print(vars, "  for (var packedEnd = reader.end(); reader.pos < packedEnd; ) {\n");
+      printer->Print(vars, "    message.$FieldName$.push($Read$);\n");
+      printer->Print(vars, "  }\n");
+      printer->Print(vars, "} else {\n");
+      printer->Print(vars, "  message.$FieldName$.push($Read$);\n");
+      printer->Print(vars, "}\n");
+    } else {
+      printer->Print(vars, "message.$FieldName$.push($Read$);\n");
+    }
+    printer->Print(vars, "break;\n");
+    printer->Outdent();
+  }
+  printer->Print(vars, "default:\n");
+  printer->Print(vars, "  reader.skip(tag & 7);\n");
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "return message;\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
+}
+
+void PrintEnumCodec(google::protobuf::io::Printer *printer,
+                    const google::protobuf::EnumDescriptor* enum_type,
+                    const Parameters &params) {
+  map<string, string> vars;
+
+  vars["Enum"] = GetLocalName(enum_type);
+
+  printer->Print(vars, "// The number of a $Enum$ value given by number or by name.\n");
+  printer->Print(vars, "function numberOf$Enum$(value) {\n");
+  printer->Print(vars, "  switch (value) {\n");
+  for (int i = 0; i < enum_type->value_count(); ++i) {
+    vars["Name"] = enum_type->value(i)->name();
+    vars["Number"] = std::to_string(enum_type->value(i)->number());
+    printer->Print(vars, "    case \"$Name$\":\n");
+    printer->Print(vars, "      return $Number$;\n");
+  }
+  printer->Print(vars, "    default:\n");
+  printer->Print(vars, "      if (typeof value === \"string\") {\n");
+  printer->Print(vars, "        throw Error(\"`\" + value + \"` is not a $Enum$ value\");\n");
+  printer->Print(vars, "      }\n");
+  printer->Print(vars, "      return value;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "}\n\n");
+}
 
-    vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
-    vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
+void PrintServiceCodecs(google::protobuf::io::Printer *printer,
+                        const google::protobuf::ServiceDescriptor* service,
+                        const DescriptorIndex &index,
+                        const Parameters &params) {
+  PrintCodecRuntime(printer, params);
 
-    printer.Print(vars, "//\n");
-    printer.Print(vars, "//  Automatically generated from $filename$\n");
-    printer.Print(vars, "//  DO NOT EDIT THIS FILE DIRECTLY.\n");
-    printer.Print(vars, "//\n");
-    printer.Print(vars, "\n");
-    printer.Print(vars, "const DDP_API_MAJOR_VERSION = $major_version$;\n");
-    printer.Print(vars, "const DDP_API_MINOR_VERSION = $minor_version$;\n");
-    printer.Print(vars, "\n");
+  const vector<const google::protobuf::Descriptor*> messages = GetCodecMessages(service, index);
+  set<const google::protobuf::EnumDescriptor*> enums;
+  for (auto message = messages.begin(); message != messages.end(); message++) {
+    for (int i = 0; i < (*message)->field_count(); ++i) {
+      const google::protobuf::FieldDescriptor* field = (*message)->field(i);
+      if (field->type() == google::protobuf::FieldDescriptor::TYPE_ENUM && enums.insert(field->enum_type()).second) {
+        PrintEnumCodec(printer, field->enum_type(), params);
+      }
+    }
+  }
+  for (auto message = messages.begin(); message != messages.end(); message++) {
+    PrintMessageCodec(printer, *message, params);
   }
-  return output;
 }
 
-string GetServiceImplementation(const google::protobuf::ServiceDescriptor* service,
+void PrintServiceBenchmark(google::protobuf::io::Printer *printer,
+                           const google::protobuf::ServiceDescriptor* service,
+                           const DescriptorIndex &index,
+                           const Parameters &params) {
+  map<string, string> vars;
+
+  vars["ServiceCanonical"] = service->name();
+
+  // The benchmark lives in tests_dir and the runtime next to the
+  // generated modules.
+  vars["OutputRoot"] = "";
+  for (size_t start = 0; start < params.tests_dir.size(); ) {
+    size_t end = params.tests_dir.find('/', start);
+    if (end == string::npos) {
+      end = params.tests_dir.size();
+    }
+    if (end > start && params.tests_dir.compare(start, end - start, ".") != 0) {
+      vars["OutputRoot"] += "../";
+    }
+    start = end + 1;
+  }
+  if (vars["OutputRoot"].empty()) {
+    vars["OutputRoot"] = "./";
+  }
+
+  printer->Print(vars, "// Measures each $ServiceCanonical$ method in calls per second: the\n");
+  printer->Print(vars, "// argument checks, for the compiled validators and for the lodash\n");
+  printer->Print(vars, "// checks they replaced, and the wire format of the arguments, for the\n");
+  printer->Print(vars, "// static codecs and for the reflective protobuf.js builder. Run with\n");
+  printer->Print(vars, "// `node`.\n");
+  printer->Print(vars, "var _ = require(\"lodash\");\n");
+  printer->Print(vars, "var builder = require(\"$OutputRoot$internal/request-protobufs\").getProtobufBuilder();\n\n");
+  printer->Print(vars, "var ITERATIONS = 1000000;\n\n");
+  printer->Print(vars, "function bench(name, check, args) {\n");
+  printer->Print(vars, "  var start = process.hrtime();\n");
+  printer->Print(vars, "  for (var i = 0; i < ITERATIONS; i++) {\n");
+  printer->Print(vars, "    check(args);\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  var elapsed = process.hrtime(start);\n");
+  printer->Print(vars, "  var seconds = elapsed[0] + elapsed[1] / 1e9;\n");
+  printer->Print(vars, "  console.log(name + \": \" + Math.round(ITERATIONS / seconds) + \" calls/s\");\n");
+  printer->Print(vars, "}\n\n");
+
+  PrintArgsValidators(printer, service, params);
+  PrintArgsDefaults(printer, service, params);
+  PrintServiceCodecs(printer, service, index, params);
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor* method = service->method(i);
+    const google::protobuf::Descriptor* request = method->input_type();
+
+    vars["Method"] = LowercaseFirstLetter(method->name());
+    vars["MethodArgs"] = ddprpc_nodejs_generator::GetClassPrefix() + request->name();
+    vars["MethodArgsFull"] = request->full_name();
+    vars["Message"] = GetLocalName(request);
+
+    printer->Print(vars, "function lodashCheck$MethodArgs$($MethodArgs$) {\n");
+    printer->Indent();
+    for (int j = 0; j < request->field_count(); ++j) {
+      const google::protobuf::FieldDescriptor* field = request->field(j);
+
+      vars["FieldName"] = field->name();
+      vars["Checker"] = GetFieldCheckingStatements(vars["MethodArgs"] + "." + field->name(), field);
+      if (vars["Checker"] != "false") {
+        printer->Print(vars, "if ($Checker$) {\n");
+        printer->Print(vars, "  throw Error(\"in `$Method$`, `$FieldName$` has incorrect type: ");
+        printer->Print(vars, "\" + typeof($MethodArgs$.$FieldName$));\n");
+        printer->Print(vars, "}\n");
+      }
+    }
+    printer->Outdent();
+    printer->Print(vars, "}\n\n");
+
+    printer->Print(vars, "var $Method$Args = {");
+    for (int j = 0; j < request->field_count(); ++j) {
+      vars["FieldName"] = request->field(j)->name();
+      vars["Sample"] = GetSampleValue(request->field(j));
+      printer->Print(vars, j == 0 ? "$FieldName$: $Sample$" : ", $FieldName$: $Sample$");
+    }
+    printer->Print(vars, "};\n");
+    printer->Print(vars, "bench(\"$Method$ lodash\", lodashCheck$MethodArgs$, $Method$Args);\n");
+    printer->Print(vars, "bench(\"$Method$ compiled\", function(args) {\n");
+    printer->Print(vars, "  validate$Message$(\"$Method$\", args);\n");
+    printer->Print(vars, "}, $Method$Args);\n\n");
+
+    printer->Print(vars, "var $Method$Buffer = encode$Message$($Method$Args, new Writer()).finish();\n");
+    printer->Print(vars, "bench(\"$Method$ encode reflective\", function(args) {\n");
+    printer->Print(vars, "  new builder.$MethodArgsFull$(args).toBuffer();\n");
+    printer->Print(vars, "}, $Method$Args);\n");
+    printer->Print(vars, "bench(\"$Method$ encode static\", function(args) {\n");
+    printer->Print(vars, "  encode$Message$(args, new Writer()).finish();\n");
+    printer->Print(vars, "}, $Method$Args);\n");
+    printer->Print(vars, "bench(\"$Method$ decode reflective\", function(buffer) {\n");
+    printer->Print(vars, "  builder.$MethodArgsFull$.decode(buffer);\n");
+    printer->Print(vars, "}, $Method$Buffer);\n");
+    printer->Print(vars, "bench(\"$Method$ decode static\", function(buffer) {\n");
+    printer->Print(vars, "  decode$Message$(new Reader(buffer), buffer.length);\n");
+    printer->Print(vars, "}, $Method$Buffer);\n\n");
+  }
+}
+
+void PrintServiceBatch(google::protobuf::io::Printer *printer,
+                       const google::protobuf::ServiceDescriptor* service,
+                       const Parameters &params) {
+  map<string, string> vars;
+
+  vars["ServiceCanonical"] = service->name();
+
+  printer->Print(vars, "// Collects several $ServiceCanonical$ calls into the frame that the C++\n");
+  printer->Print(vars, "// $ServiceCanonical$Batch encodes: [call count] followed by [call id]\n");
+  printer->Print(vars, "// [method id][length][payload] for every call, all little-endian 32-bit\n");
+  printer->Print(vars, "// integers. Call ids are the position of the call in the batch and\n");
+  printer->Print(vars, "// method ids the position of the method in the service. Streaming\n");
+  printer->Print(vars, "// methods cannot be batched.\n");
+  printer->Print(vars, "//\n");
+  printer->Print(vars, "// The runtime cannot send a batch frame yet, so send() still sends one\n");
+  printer->Print(vars, "// request per call and returns them in order, to attach handlers to\n");
+  printer->Print(vars, "// just like the single calls. encode() gives the frame for a runtime\n");
+  printer->Print(vars, "// that can.\n");
+  printer->Print(vars, "function $ServiceCanonical$Batch() {\n");
+  printer->Print(vars, "  this.calls = [];\n");
+  printer->Print(vars, "}\n\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor* method = service->method(i);
+    if (GetMethodType(method) != METHODTYPE_NO_STREAMING) {
+      continue;
+    }
+
+    vars["Method"] = LowercaseFirstLetter(method->name());
+    vars["MethodId"] = std::to_string(i);
+    vars["MethodArgs"] = ddprpc_nodejs_generator::GetClassPrefix() + method->input_type()->name();
+    vars["Message"] = GetLocalName(method->input_type());
+
+    printer->Print(vars, "$ServiceCanonical$Batch.prototype.$Method$ = function($MethodArgs$) {\n");
+    printer->Print(vars, "  this.calls.push({method: \"$Method$\", methodId: $MethodId$, args: $Method$Request($MethodArgs$), encode: encode$Message$});\n");
+    printer->Print(vars, "  return this;\n");
+    printer->Print(vars, "};\n\n");
+  }
+
+  printer->Print(vars, "$ServiceCanonical$Batch.prototype.encode = function() {\n");
+  printer->Indent();
+  printer->Print(vars, "var writer = new Writer().fixed32(this.calls.length);\n");
+  printer->Print(vars, "for (var i = 0; i < this.calls.length; i++) {\n");
+  printer->Print(vars, "  var call = this.calls[i];\n");
+  printer->Print(vars, "  writer.fixed32(i).fixed32(call.methodId).fixed32(0);\n");
+  printer->Print(vars, "  var start = writer.length;\n");
+  printer->Print(vars, "  call.encode(call.args, writer);\n");
+  printer->Print(vars, "  writer.buffer.writeUInt32LE(writer.length - start, start - 4);\n");
+  printer->Print(vars, "}\n");
+  printer->Print(vars, "return writer.finish();\n");
+  printer->Outdent();
+  printer->Print(vars, "};\n\n");
+
+  printer->Print(vars, "$ServiceCanonical$Batch.prototype.send = function() {\n");
+  printer->Indent();
+  printer->Print(vars, "var calls = this.calls;\n");
+  printer->Print(vars, "this.calls = [];\n");
+  printer->Print(vars, "return calls.map(function(call) {\n");
+  printer->Print(vars, "  return module.exports[call.method](call.args);\n");
+  printer->Print(vars, "});\n");
+  printer->Outdent();
+  printer->Print(vars, "};\n\n");
+
+  printer->Print(vars, "module.exports.$ServiceCanonical$Batch = $ServiceCanonical$Batch;\n\n");
+}
+
+void PrintServiceResponseCache(google::protobuf::io::Printer *printer,
+                               const google::protobuf::ServiceDescriptor* service,
+                               const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars, "// Number of responses kept for each cacheable method.\n");
+  printer->Print(vars, "var RESPONSE_CACHE_CAPACITY = 64;\n\n");
+  printer->Print(vars, "// Maps serialized requests to the completion responses they produced.\n");
+  printer->Print(vars, "// Every response is kept for the same ttl, so entries expire in\n");
+  printer->Print(vars, "// insertion order, which is also the order a Map iterates in, and the\n");
+  printer->Print(vars, "// oldest one is evicted to stay within capacity.\n");
+  printer->Print(vars, "function ResponseCache(capacity, ttl) {\n");
+  printer->Print(vars, "  this.capacity = capacity;\n");
+  printer->Print(vars, "  this.ttl = ttl;\n");
+  printer->Print(vars, "  this.entries = new Map();\n");
+  printer->Print(vars, "}\n\n");
+
+  printer->Print(vars, "ResponseCache.prototype.get = function(key) {\n");
+  printer->Print(vars, "  var entry = this.entries.get(key);\n");
+  printer->Print(vars, "  if (entry === undefined) {\n");
+  printer->Print(vars, "    return undefined;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  if (entry.expires <= Date.now()) {\n");
+  printer->Print(vars, "    this.entries.delete(key);\n");
+  printer->Print(vars, "    return undefined;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  return entry.response;\n");
+  printer->Print(vars, "};\n\n");
+
+  printer->Print(vars, "ResponseCache.prototype.set = function(key, response) {\n");
+  printer->Print(vars, "  if (this.capacity <= 0) {\n");
+  printer->Print(vars, "    return;\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  this.entries.delete(key);\n");
+  printer->Print(vars, "  while (this.entries.size >= this.capacity) {\n");
+  printer->Print(vars, "    this.entries.delete(this.entries.keys().next().value);\n");
+  printer->Print(vars, "  }\n");
+  printer->Print(vars, "  this.entries.set(key, {response: response, expires: Date.now() + this.ttl});\n");
+  printer->Print(vars, "};\n\n");
+
+  printer->Print(vars, "ResponseCache.prototype.clear = function() {\n");
+  printer->Print(vars, "  this.entries.clear();\n");
+  printer->Print(vars, "};\n\n");
+}
+
+void PrintMethodResponseCache(google::protobuf::io::Printer *printer,
+                              const google::protobuf::MethodDescriptor* method,
+                              const DescriptorIndex &index,
+                              const Parameters &params) {
+  map<string, string> vars;
+
+  vars["Method"] = LowercaseFirstLetter(method->name());
+  vars["MethodCanonical"] = method->name();
+  vars["MethodArgs"] = ddprpc_nodejs_generator::GetClassPrefix() + method->input_type()->name();
+  vars["CompletionResponseName"] = index.GetCompletionResponse(method);
+  vars["ttl"] = std::to_string(GetCacheTtlMs(method));
+  if (IsIdempotent(method)) {
+    vars["send"] = vars["Method"] + "Join(key, args)";
+  } else {
+    vars["send"] = "Server.createRequestThenSend(\"" + method->name() + "\", args)";
+  }
+
+  printer->Print(vars, "var $Method$Cache = new ResponseCache(RESPONSE_CACHE_CAPACITY, $ttl$);\n\n");
+
+  // A cached call still hands back something that looks like a
+  // request, so callers attach their handlers the same way.
+  printer->Print(vars, "// A `$Method$` request that completes with a cached response and\n");
+  printer->Print(vars, "// never receives updates or errors.\n");
+  printer->Print(vars, "function $Method$CachedRequest(response) {\n");
+  printer->Indent();
+  printer->Print(vars, "var request = {\n");
+  printer->Print(vars, "  onError: function() {\n");
+  printer->Print(vars, "    return request;\n");
+  printer->Print(vars, "  },\n");
+  printer->Print(vars, "  on$CompletionResponseName$: function(handler) {\n");
+  printer->Print(vars, "    process.nextTick(handler, response);\n");
+  printer->Print(vars, "    return request;\n");
+  printer->Print(vars, "  }");
+  const vector<string>& update_responses = index.GetUpdateResponses(method);
+  const set<string> updates(update_responses.begin(), update_responses.end());
+  for (auto update = updates.begin(); update != updates.end(); update++) {
+    if (*update == vars["CompletionResponseName"]) {
+      continue;
+    }
+    vars["UpdateResponseName"] = *update;
+    printer->Print(vars, ",\n");
+    printer->Print(vars, "  on$UpdateResponseName$: function() {\n");
+    printer->Print(vars, "    return request;\n");
+    printer->Print(vars, "  }");
+  }
+  printer->Print(vars, "\n};\n");
+  printer->Print(vars, "return request;\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
+
+  printer->Print(vars, "// Completes locally while an identical request completed less than\n");
+  printer->Print(vars, "// $ttl$ms ago.\n");
+  printer->Print(vars, "module.exports.$Method$ = function($MethodArgs$) {\n");
+  printer->Indent();
+  printer->Print(vars, "var args = $Method$Request($MethodArgs$);\n");
+  printer->Print(vars, "var key = JSON.stringify(args);\n");
+  printer->Print(vars, "var response = $Method$Cache.get(key);\n");
+  printer->Print(vars, "if (response !== undefined) {\n");
+  printer->Print(vars, "  return $Method$CachedRequest(response);\n");
+  printer->Print(vars, "}\n\n");
+  // The cache is filled by a completion handler of its own, so it does
+  // not depend on the caller attaching one.
+  printer->Print(vars, "var request = $send$;\n");
+  printer->Print(vars, "var handlers = [];\n");
+  printer->Print(vars, "request.on$CompletionResponseName$(function(completion) {\n");
+  printer->Print(vars, "  $Method$Cache.set(key, completion);\n");
+  printer->Print(vars, "  _.each(handlers, function(handler) {\n");
+  printer->Print(vars, "    handler(completion);\n");
+  printer->Print(vars, "  });\n");
+  printer->Print(vars, "});\n");
+  printer->Print(vars, "request.on$CompletionResponseName$ = function(handler) {\n");
+  printer->Print(vars, "  handlers.push(handler);\n");
+  printer->Print(vars, "  return request;\n");
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "return request;\n");
+  printer->Outdent();
+  printer->Print(vars, "};\n\n");
+}
+
+void PrintMethodSingleFlight(google::protobuf::io::Printer *printer,
+                             const google::protobuf::MethodDescriptor* method,
+                             const DescriptorIndex &index,
+                             const Parameters &params) {
+  map<string, string> vars;
+
+  vars["Method"] = LowercaseFirstLetter(method->name());
+  vars["MethodCanonical"] = method->name();
+  vars["CompletionResponseName"] = index.GetCompletionResponse(method);
+
+  vector<string> updates;
+  const vector<string>& update_responses = index.GetUpdateResponses(method);
+  const set<string> unique_updates(update_responses.begin(), update_responses.end());
+  for (auto update = unique_updates.begin(); update != unique_updates.end(); update++) {
+    if (*update != vars["CompletionResponseName"]) {
+      updates.push_back(*update);
+    }
+  }
+
+  printer->Print(vars, "var $Method$InFlight = new Map();\n\n");
+
+  printer->Print(vars, "// Send a `$Method$` request unless one with the same key is already\n");
+  printer->Print(vars, "// in flight, and return a request whose handlers get the responses of\n");
+  printer->Print(vars, "// the call in flight from now on. The call stops being in flight when\n");
+  printer->Print(vars, "// it completes or fails.\n");
+  printer->Print(vars, "function $Method$Join(key, args) {\n");
+  printer->Indent();
+  printer->Print(vars, "var handlers = $Method$InFlight.get(key);\n");
+  printer->Print(vars, "if (handlers === undefined) {\n");
+  printer->Indent();
+  printer->Print(vars, "handlers = {Error: [], $CompletionResponseName$: []");
+  for (auto update = updates.begin(); update != updates.end(); update++) {
+    vars["UpdateResponseName"] = *update;
+    printer->Print(vars, ", $UpdateResponseName$: []");
+  }
+  printer->Print(vars, "};\n");
+  printer->Print(vars, "$Method$InFlight.set(key, handlers);\n");
+  printer->Print(vars, "Server.createRequestThenSend(\"$MethodCanonical$\", args)");
+  printer->Indent();
+  for (auto update = updates.begin(); update != updates.end(); update++) {
+    vars["UpdateResponseName"] = *update;
+    printer->Print(vars, "\n.on$UpdateResponseName$(function(update) {\n");
+    printer->Print(vars, "  _.each(handlers.$UpdateResponseName$, function(handler) {\n");
+    printer->Print(vars, "    handler(update);\n");
+    printer->Print(vars, "  });\n");
+    printer->Print(vars, "})");
+  }
+  printer->Print(vars, "\n.onError(function(error) {\n");
+  printer->Print(vars, "  $Method$InFlight.delete(key);\n");
+  printer->Print(vars, "  _.each(handlers.Error, function(handler) {\n");
+  printer->Print(vars, "    handler(error);\n");
+  printer->Print(vars, "  });\n");
+  printer->Print(vars, "})");
+  printer->Print(vars, "\n.on$CompletionResponseName$(function(completion) {\n");
+  printer->Print(vars, "  $Method$InFlight.delete(key);\n");
+  printer->Print(vars, "  _.each(handlers.$CompletionResponseName$, function(handler) {\n");
+  printer->Print(vars, "    handler(completion);\n");
+  printer->Print(vars, "  });\n");
+  printer->Print(vars, "});\n");
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
+
+  printer->Print(vars, "var request = {\n");
+  printer->Print(vars, "  onError: function(handler) {\n");
+  printer->Print(vars, "    handlers.Error.push(handler);\n");
+  printer->Print(vars, "    return request;\n");
+  printer->Print(vars, "  },\n");
+  printer->Print(vars, "  on$CompletionResponseName$: function(handler) {\n");
+  printer->Print(vars, "    handlers.$CompletionResponseName$.push(handler);\n");
+  printer->Print(vars, "    return request;\n");
+  printer->Print(vars, "  }");
+  for (auto update = updates.begin(); update != updates.end(); update++) {
+    vars["UpdateResponseName"] = *update;
+    printer->Print(vars, ",\n");
+    printer->Print(vars, "  on$UpdateResponseName$: function(handler) {\n");
+    printer->Print(vars, "    handlers.$UpdateResponseName$.push(handler);\n");
+    printer->Print(vars, "    return request;\n");
+    printer->Print(vars, "  }");
+  }
+  printer->Print(vars, "\n};\n");
+  printer->Print(vars, "return request;\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
+}
+
+void PrintServiceImplementation(google::protobuf::io::Printer *printer,
+                                const google::protobuf::ServiceDescriptor* service,
+                                const DescriptorIndex &index,
                                 const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
+  map<string, string> vars;
 
-    vars["ServiceCanonical"] = service->name();
-    vars["Service"] = LowercaseFirstLetter(service->name());
+  vars["ServiceCanonical"] = service->name();
+  vars["Service"] = LowercaseFirstLetter(service->name());
 
-    for (int i = 0; i < service->method_count(); ++i) {
-      const google::protobuf::MethodDescriptor* method = service->method(i);
-
-      vars["Method"] = LowercaseFirstLetter(method->name());
-      vars["MethodCanonical"] = method->name();
-      vars["MethodArgs"] = ddprpc_nodejs_generator::GetClassPrefix() + method->input_type()->name();
-      vars["MethodArgsFull"] = method->input_type()->full_name();
-      vars["CompletionResponseName"] = GetCompletionResponse(method);
-      vars["CompletionResponseClass"] = ddprpc_nodejs_generator::GetClassPrefix() + GetCompletionResponse(method);
-      const vector<string> update_responses = GetUpdateResponses(method);
-
-      const google::protobuf::Descriptor* request = FindMessageByName(service->file(), vars["MethodArgs"]);
-
-      printer.Print(vars, "module.exports.$Method$ = function($MethodArgs$) {\n");
-      printer.Indent();
-      for (int j = 0; j < request->field_count(); ++j) {
-        const google::protobuf::FieldDescriptor* field = request->field(j);
-
-        vars["FieldName"] = field->name();
-        vars["Checker"] = GetFieldCheckingStatements(vars["MethodArgs"] + "." + field->name(), field);
-
-        if (vars["Checker"] != "false") {
-          printer.Print(vars, "if ($Checker$) {\n");
-          printer.Indent();
-          printer.Print(vars, "throw Error(\"in `$Method$`, `$FieldName$` has incorrect type: ");
-          printer.Print(vars, "\" + typeof($MethodArgs$.$FieldName$));\n");
-          printer.Outdent();
-          printer.Print(vars, "}\n\n");
-        }
+  PrintArgsValidators(printer, service, params);
+  PrintArgsDefaults(printer, service, params);
+  PrintServiceCodecs(printer, service, index, params);
+
+  // A service without methods has no messages to encode.
+  const vector<const google::protobuf::Descriptor*> messages = GetCodecMessages(service, index);
+  if (!messages.empty()) {
+    vars["Example"] = GetLocalName(messages.front());
+    printer->Print(vars, "// Encodes and decodes the messages of the $ServiceCanonical$ methods without\n");
+    printer->Print(vars, "// reflection, e.g. `codecs.$Example$.decode(buffer)`.\n");
+    printer->Print(vars, "module.exports.codecs = {\n");
+    for (auto message = messages.begin(); message != messages.end(); message++) {
+      vars["Message"] = GetLocalName(*message);
+      printer->Print(vars, "  $Message$: {\n");
+      printer->Print(vars, "    encode: function(message) {\n");
+      printer->Print(vars, "      return encode$Message$(message, new Writer()).finish();\n");
+      printer->Print(vars, "    },\n");
+      printer->Print(vars, "    decode: function(buffer) {\n");
+      printer->Print(vars, "      return decode$Message$(new Reader(buffer), buffer.length);\n");
+      printer->Print(vars, "    }\n");
+      printer->Print(vars, message + 1 != messages.end() ? "  },\n" : "  }\n");
+    }
+    printer->Print(vars, "};\n\n");
+  }
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    const google::protobuf::MethodDescriptor* method = service->method(i);
+
+    vars["Method"] = LowercaseFirstLetter(method->name());
+    vars["MethodCanonical"] = method->name();
+    vars["MethodArgs"] = ddprpc_nodejs_generator::GetClassPrefix() + method->input_type()->name();
+    vars["CompletionResponseName"] = index.GetCompletionResponse(method);
+    vars["CompletionResponseClass"] = ddprpc_nodejs_generator::GetClassPrefix() + index.GetCompletionResponse(method);
+
+    const google::protobuf::Descriptor* request = method->input_type();
+
+    for (int j = 0; j < request->field_count(); ++j) {
+      const google::protobuf::FieldDescriptor* field = request->field(j);
+      if (field->is_required() && field->has_default_value()) {
+        fprintf(stderr,
+                "FYI: The field [%s.%s] is required, but has a default set so it will be allowed to be undefined.\n",
+                vars["MethodArgs"].c_str(), field->name().c_str());
+      }
+    }
+
+    // The checks and defaults live in a request builder that the single
+    // call, the cache and the in-flight sharing use.
+    vars["Message"] = GetLocalName(request);
+    printer->Print(vars, "function $Method$Request($MethodArgs$) {\n");
+    printer->Indent();
+    printer->Print(vars, "validate$Message$(\"$Method$\", $MethodArgs$);\n\n");
+    printer->Print(vars, "// TODO(cjrd) check the data\n");
+    printer->Print(vars, "return {\n");
+    printer->Indent();
+    for (int j = 0; j < request->field_count(); ++j) {
+      const google::protobuf::FieldDescriptor* field = request->field(j);
+
+      vars["FieldName"] = field->name();
+      printer->Print(vars, "$FieldName$: $MethodArgs$.$FieldName$");
+      if (field->has_default_value()) {
+        printer->Print(vars, " || $Message$Defaults.$FieldName$");
       }
 
-      printer.Print(vars, "var builder = requestProtobufs.getProtobufBuilder();\n");
-
-      printer.Print(vars, "// TODO(cjrd) check the data\n");
-      printer.Print(vars, "return Server.createRequestThenSend(\"$MethodCanonical$\", {\n");
-      printer.Indent();
-      for (int j = 0; j < request->field_count(); ++j) {
-        const google::protobuf::FieldDescriptor* field = request->field(j);
-
-        vars["FieldName"] = field->name();
-        printer.Print(vars, "$FieldName$: $MethodArgs$.$FieldName$");
-        if (field->has_default_value()) {
-          printer.Print(vars, " || builder.$MethodArgsFull$.$$type.getChild(\"$FieldName$\").defaultValue");
-        }
-
-        if (j < request->field_count() - 1) {
-          printer.Print(vars, ",\n");
-        } else {
-          printer.Print(vars, "\n");
-        }
+      if (j < request->field_count() - 1) {
+        printer->Print(vars, ",\n");
+      } else {
+        printer->Print(vars, "\n");
       }
-      printer.Outdent();
-      printer.Print(vars, "});\n");
+    }
+    printer->Outdent();
+    printer->Print(vars, "};\n");
 
-      printer.Outdent();
-      printer.Print(vars, "};\n\n");
+    printer->Outdent();
+    printer->Print(vars, "}\n\n");
+
+    if (IsIdempotent(method)) {
+      PrintMethodSingleFlight(printer, method, index, params);
+    }
+    if (GetCacheTtlMs(method) > 0) {
+      PrintMethodResponseCache(printer, method, index, params);
+      continue;
+    }
+    if (IsIdempotent(method)) {
+      printer->Print(vars, "// Shares the call of an identical request that is in flight.\n");
+      printer->Print(vars, "module.exports.$Method$ = function($MethodArgs$) {\n");
+      printer->Print(vars, "  var args = $Method$Request($MethodArgs$);\n");
+      printer->Print(vars, "  return $Method$Join(JSON.stringify(args), args);\n");
+      printer->Print(vars, "};\n\n");
+      continue;
+    }
+
+    printer->Print(vars, "module.exports.$Method$ = function($MethodArgs$) {\n");
+    printer->Print(vars, "  return Server.createRequestThenSend(\"$MethodCanonical$\", $Method$Request($MethodArgs$));\n");
+    printer->Print(vars, "};\n\n");
+  }
+
+  if (HasCacheableMethods(service)) {
+    printer->Print(vars, "// Drop every cached response.\n");
+    printer->Print(vars, "module.exports.clearResponseCache = function() {\n");
+    for (int i = 0; i < service->method_count(); ++i) {
+      if (GetCacheTtlMs(service->method(i)) > 0) {
+        vars["Method"] = LowercaseFirstLetter(service->method(i)->name());
+        printer->Print(vars, "  $Method$Cache.clear();\n");
+      }
+    }
+    printer->Print(vars, "};\n\n");
+  }
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    if (GetMethodType(service->method(i)) == METHODTYPE_NO_STREAMING) {
+      PrintServiceBatch(printer, service, params);
+      break;
     }
   }
-  return output;
 }
 
-string GetSourceIncludes(const google::protobuf::ServiceDescriptor* service, const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
+void PrintSourceIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars, "var _ = require(\"lodash\");\n");
+  printer->Print(vars, "var Server = require(\"./internal/server\");\n");
+  printer->Print(vars, "\n");
+
+  if (HasCacheableMethods(service)) {
+    PrintServiceResponseCache(printer, service, params);
+  }
+}
 
-    printer.Print(vars, "var _ = require(\"lodash\");\n");
-    printer.Print(vars, "var requestProtobufs = require(\"./internal/request-protobufs\");\n");
-    printer.Print(vars, "var Server = require(\"./internal/server\");\n");
-    printer.Print(vars, "\n");
+bool SetParameter(const string &key, const string &value, Parameters *params) {
+  if (key == "tests_dir") {
+    params->tests_dir = value;
+    return true;
   }
-  return output;
+  return false;
+}
+
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const DescriptorIndex &index, const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context, string *error) {
+  // Build each of the "service implementations". Each one is printed
+  // straight into the stream protoc hands us.
+  for (int i = 0; i < file->service_count(); ++i) {
+    const google::protobuf::ServiceDescriptor* service = file->service(i);
+    string file_name = ddprpc_generator::LowercaseFirstLetter(service->name());
+
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(
+        context->Open(file_name + ".js"));
+    google::protobuf::io::Printer printer(source_output.get(), '$');
+    PrintPrologue(&printer, file, params);
+    PrintSourceIncludes(&printer, service, params);
+    PrintServiceImplementation(&printer, service, index, params);
+
+    if (!params.tests_dir.empty()) {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> benchmark_output(
+          context->Open(params.tests_dir + "/" + file_name + ".bench.js"));
+      google::protobuf::io::Printer benchmark_printer(benchmark_output.get(), '$');
+      PrintPrologue(&benchmark_printer, file, params);
+      PrintServiceBenchmark(&benchmark_printer, service, index, params);
+    }
+  }
+
+  return true;
 }
 
 }  // namespace ddprpc_nodejs_generator
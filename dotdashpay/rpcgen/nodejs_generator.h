@@ -37,32 +37,97 @@
 
 #include "generator_helpers.h"
 
+#include <google/protobuf/compiler/code_generator.h>
 #include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/printer.h>
 #include <string>
 
 namespace ddprpc_nodejs_generator {
 
 // Contains all the parameters that are parsed from the command line.
 struct Parameters {
+  // Set with tests_dir=DIR. Writes a benchmark of the argument
+  // validators and codecs of every service into DIR, relative to the
+  // output directory.
+  std::string tests_dir;
 };
 
-// Return the prologue of the generated header file.
-std::string GetPrologue(const google::protobuf::FileDescriptor *file, const Parameters &params);
-
-// Return the includes for the generated source file.
-std::string GetSourceIncludes(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the implementation of the service with name.
-std::string GetServiceImplementation(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the simulator header.
-std::string GetSimulatorHeader(const google::protobuf::FileDescriptor* file, const Parameters &params);
-
-// Return the simulator implementation.
-std::string GetSimulatorSource(const google::protobuf::FileDescriptor* file, const Parameters &params);
-
-// Return the examples template.
-std::string GetExamplesTemplate(const google::protobuf::FileDescriptor* file, const Parameters &params);
+// Set the parameter key to value. Returns false if key is unknown.
+bool SetParameter(const std::string &key, const std::string &value, Parameters *params);
+
+// Generate all of the output files for file into context. The file
+// must already have passed ddprpc_generator::ValidateFile and be
+// covered by index.
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const ddprpc_generator::DescriptorIndex &index, const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context, std::string *error);
+
+// Print the prologue of the generated source file.
+void PrintPrologue(google::protobuf::io::Printer *printer,
+                   const google::protobuf::FileDescriptor *file, const Parameters &params);
+
+// Print the includes for the generated source file.
+void PrintSourceIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service, const Parameters &params);
+
+// Print the implementation of the service with name.
+void PrintServiceImplementation(google::protobuf::io::Printer *printer,
+                                const google::protobuf::ServiceDescriptor* service,
+                                const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print <Service>Batch, which collects the non-streaming calls of the
+// service into one frame.
+void PrintServiceBatch(google::protobuf::io::Printer *printer,
+                       const google::protobuf::ServiceDescriptor* service, const Parameters &params);
+
+// Print ResponseCache, the cache behind the cacheable methods of the
+// service.
+void PrintServiceResponseCache(google::protobuf::io::Printer *printer,
+                               const google::protobuf::ServiceDescriptor* service, const Parameters &params);
+
+// Print the cache and the exported call of a cacheable method.
+void PrintMethodResponseCache(google::protobuf::io::Printer *printer,
+                              const google::protobuf::MethodDescriptor* method,
+                              const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the in-flight table of an idempotent method and the function
+// that joins identical calls.
+void PrintMethodSingleFlight(google::protobuf::io::Printer *printer,
+                             const google::protobuf::MethodDescriptor* method,
+                             const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the validator of each argument message used by the service.
+void PrintArgsValidators(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service, const Parameters &params);
+
+// Print the default values of the fields of each argument message used
+// by the service.
+void PrintArgsDefaults(google::protobuf::io::Printer *printer,
+                       const google::protobuf::ServiceDescriptor* service, const Parameters &params);
+
+// Print Writer and Reader, the wire format helpers of the codecs.
+void PrintCodecRuntime(google::protobuf::io::Printer *printer, const Parameters &params);
+
+// Print the function that turns a value of enum_type given by name into
+// its number for the encoders.
+void PrintEnumCodec(google::protobuf::io::Printer *printer,
+                    const google::protobuf::EnumDescriptor* enum_type, const Parameters &params);
+
+// Print the static encoder and decoder of message.
+void PrintMessageCodec(google::protobuf::io::Printer *printer,
+                       const google::protobuf::Descriptor* message, const Parameters &params);
+
+// Print the codecs of every message that the methods of the service send
+// or receive, and of the messages those contain.
+void PrintServiceCodecs(google::protobuf::io::Printer *printer,
+                        const google::protobuf::ServiceDescriptor* service,
+                        const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the benchmark of the argument validators and codecs of the
+// service.
+void PrintServiceBenchmark(google::protobuf::io::Printer *printer,
+                           const google::protobuf::ServiceDescriptor* service,
+                           const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
 
 inline std::string GetClassPrefix() {
   return "";
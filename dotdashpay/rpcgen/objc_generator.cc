@@ -38,8 +38,9 @@
 #include <google/protobuf/compiler/objectivec/objectivec_helpers.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/printer.h>
-#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream.h>
 #include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
@@ -110,131 +111,216 @@ google::protobuf::compiler::objectivec::ObjectiveCType type =
 return NULL;
 }
 
+// The channels of every error and response of the services of file, in
+// the order the methods first use them.
+vector<string> GetSignalNames(const google::protobuf::FileDescriptor* file, const DescriptorIndex &index) {
+  vector<string> names;
+  set<string> seen;
+  for (int i = 0; i < file->service_count(); ++i) {
+    const google::protobuf::ServiceDescriptor* service = file->service(i);
+    for (int j = 0; j < service->method_count(); ++j) {
+      const google::protobuf::MethodDescriptor* method = service->method(j);
+      vector<string> channels(1, method->name() + "Error");
+      const vector<string>& update_responses = index.GetUpdateResponses(method);
+      channels.insert(channels.end(), update_responses.begin(), update_responses.end());
+      channels.push_back(index.GetCompletionResponse(method));
+      for (auto channel = channels.begin(); channel != channels.end(); channel++) {
+        if (seen.insert(*channel).second) {
+          names.push_back(*channel);
+        }
+      }
+    }
+  }
+  return names;
+}
+
 }  // namespace
 
-string GetPrologue(const google::protobuf::FileDescriptor *file,
-                   const Parameters &params, const bool& is_header) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["filename"] = file->name();
-    vars["filename_identifier"] = FilenameIdentifier(file->name());
-    vars["filename_base"] = StripProto(file->name());
-
-    vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
-    vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
-
-    printer.Print(vars, "//\n");
-    printer.Print(vars, "//  Automatically generated from $filename$\n");
-    printer.Print(vars, "//  DO NOT EDIT THIS FILE DIRECTLY.\n");
-    printer.Print(vars, "//\n");
-    printer.Print(vars, "\n");
-    if (is_header) {
-      printer.Print(vars, "#define DDP_API_MAJOR_VERSION $major_version$\n");
-      printer.Print(vars, "#define DDP_API_MINOR_VERSION $minor_version$\n");
-      printer.Print(vars, "\n");
-    }
+void PrintPrologue(google::protobuf::io::Printer *printer,
+                   const google::protobuf::FileDescriptor *file,
+                   const Parameters &params,
+                   const bool& is_header) {
+  map<string, string> vars;
+
+  vars["filename"] = file->name();
+  vars["filename_identifier"] = FilenameIdentifier(file->name());
+  vars["filename_base"] = StripProto(file->name());
+
+  vars["major_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_major_version));
+  vars["minor_version"] = std::to_string(file->options().GetExtension(dotdashpay::api::common::api_minor_version));
+
+  printer->Print(vars, "//\n");
+  printer->Print(vars, "//  Automatically generated from $filename$\n");
+  printer->Print(vars, "//  DO NOT EDIT THIS FILE DIRECTLY.\n");
+  printer->Print(vars, "//\n");
+  printer->Print(vars, "\n");
+  if (is_header) {
+    printer->Print(vars, "#define DDP_API_MAJOR_VERSION $major_version$\n");
+    printer->Print(vars, "#define DDP_API_MINOR_VERSION $minor_version$\n");
+    printer->Print(vars, "\n");
   }
-  return output;
 }
 
-string GetSimulatorHeader(const google::protobuf::FileDescriptor* file,
+void PrintSimulatorHeader(google::protobuf::io::Printer *printer,
+                          const google::protobuf::FileDescriptor* file,
                           const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    printer.Print(vars, "#import <Foundation/Foundation.h>\n\n");
-    printer.Print(vars, "@interface DDPSimulatorMappings : NSObject\n\n");
-    printer.Print(vars, "+ (NSArray*) getResponsesForRequest:(NSString*)request;\n\n");
-    printer.Print(vars, "@end\n");
-  }
+  map<string, string> vars;
 
-  return output;
+  printer->Print(vars, "#import <Foundation/Foundation.h>\n\n");
+  printer->Print(vars, "@interface DDPSimulatorMappings : NSObject\n\n");
+  printer->Print(vars, "+ (NSArray*) getResponsesForRequest:(NSString*)request;\n\n");
+  printer->Print(vars, "@end\n");
 }
 
-std::string GetSimulatorSource(const google::protobuf::FileDescriptor* file, const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    printer.Print(vars, "#import \"DDPSimulatorMappings.h\"\n\n");
-
-    printer.Print(vars, "@implementation DDPSimulatorMappings\n\n");
-
-    printer.Print(vars, "+ (NSArray*) getResponsesForRequest:(NSString*)request {\n");
-    printer.Indent();
-    for (int i = 0; i < file->service_count(); ++i) {
-      const google::protobuf::ServiceDescriptor* service = file->service(i);
-      for (int j = 0; j < service->method_count(); ++j) {
-        const google::protobuf::MethodDescriptor* method = service->method(j);
-        vars["MethodName"] = method->name();
-        printer.Print(vars, "if ([request isEqualToString:@\"$MethodName$\"]) {\n");
-        printer.Indent();
-
-        printer.Print(vars, "return @[");
-
-        vector<string> responses = GetUpdateResponses(method);
-        for (int k = 0; k < responses.size(); ++k) {
-          vars["UpdateResponseName"] = responses[k];
-          printer.Print(vars, "@\"$UpdateResponseName$\", ");
-        }
-        vars["CompletionResponseName"] = GetCompletionResponse(method);
-        printer.Print(vars, "@\"$CompletionResponseName$\"");
+void PrintSimulatorSource(google::protobuf::io::Printer *printer,
+                          const google::protobuf::FileDescriptor* file,
+                          const DescriptorIndex &index,
+                          const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars, "#import \"DDPSimulatorMappings.h\"\n\n");
+
+  printer->Print(vars, "@implementation DDPSimulatorMappings\n\n");
 
-        printer.Print(vars, "];\n");
-        printer.Outdent();
-        printer.Print(vars, "}\n\n");
+  printer->Print(vars, "+ (NSArray*) getResponsesForRequest:(NSString*)request {\n");
+  printer->Indent();
+  printer->Print(vars, "static NSDictionary* responsesForRequest;\n");
+  printer->Print(vars, "static dispatch_once_t onceToken;\n");
+  printer->Print(vars, "dispatch_once(&onceToken, ^{\n");
+  printer->Print(vars, "  responsesForRequest = @{");
+  printer->Indent();
+  printer->Indent();
+
+  // A method name that several services share maps to the responses
+  // of its first method, as it did when this was a chain of ifs.
+  set<string> requests;
+  for (int i = 0; i < file->service_count(); ++i) {
+    const google::protobuf::ServiceDescriptor* service = file->service(i);
+    for (int j = 0; j < service->method_count(); ++j) {
+      const google::protobuf::MethodDescriptor* method = service->method(j);
+      if (!requests.insert(method->name()).second) {
+        continue;
       }
+      vars["MethodName"] = method->name();
+      printer->Print(vars, requests.size() > 1 ? ",\n" : "\n");
+      printer->Print(vars, "@\"$MethodName$\": @[");
+
+      vector<string> responses = index.GetUpdateResponses(method);
+      for (int k = 0; k < responses.size(); ++k) {
+        vars["UpdateResponseName"] = responses[k];
+        printer->Print(vars, "@\"$UpdateResponseName$\", ");
+      }
+      vars["CompletionResponseName"] = index.GetCompletionResponse(method);
+      printer->Print(vars, "@\"$CompletionResponseName$\"");
+
+      printer->Print(vars, "]");
     }
+  }
 
-    printer.Print(vars, "return nil;\n");
-    printer.Outdent();
-    printer.Print(vars, "}\n\n");
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print(vars, requests.empty() ? "};\n" : "\n  };\n");
+  printer->Print(vars, "});\n");
+  printer->Print(vars, "return responsesForRequest[request];\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
 
-    printer.Print(vars, "@end\n");
+  printer->Print(vars, "@end\n");
+}
+
+void PrintSignalsHeader(google::protobuf::io::Printer *printer,
+                        const google::protobuf::FileDescriptor* file,
+                        const DescriptorIndex &index,
+                        const Parameters &params) {
+  map<string, string> vars;
+
+  vars["SignalId"] = ddprpc_objc_generator::GetClassPrefix() + "SignalId";
+  vars["Signals"] = ddprpc_objc_generator::GetClassPrefix() + "Signals";
+
+  printer->Print(vars, "#import <Foundation/Foundation.h>\n\n");
+  // Clients still register their callbacks by name: DDPSignalManager has
+  // no channel-keyed API yet, and converting channels back to names just
+  // to call it would add work to every request.
+  printer->Print(vars, "// The channel of every error and response of the API, for a\n");
+  printer->Print(vars, "// DDPSignalManager that keeps its callbacks in an array indexed by\n");
+  printer->Print(vars, "// channel instead of by name.\n");
+  printer->Print(vars, "typedef NS_ENUM(NSInteger, $SignalId$) {\n");
+  printer->Indent();
+  const vector<string> names = GetSignalNames(file, index);
+  for (auto name = names.begin(); name != names.end(); name++) {
+    vars["Name"] = *name;
+    printer->Print(vars, "$SignalId$_$Name$,\n");
   }
+  printer->Print(vars, "$SignalId$Count\n");
+  printer->Outdent();
+  printer->Print(vars, "};\n\n");
+
+  printer->Print(vars, "@interface $Signals$ : NSObject\n\n");
+  printer->Print(vars, "// The channel of the error or response with name, or $SignalId$Count if\n");
+  printer->Print(vars, "// the API has none.\n");
+  printer->Print(vars, "+ ($SignalId$) signalIdForName:(NSString*)name;\n\n");
+  printer->Print(vars, "@end\n");
+}
+
+void PrintSignalsSource(google::protobuf::io::Printer *printer,
+                        const google::protobuf::FileDescriptor* file,
+                        const DescriptorIndex &index,
+                        const Parameters &params) {
+  map<string, string> vars;
+
+  vars["SignalId"] = ddprpc_objc_generator::GetClassPrefix() + "SignalId";
+  vars["Signals"] = ddprpc_objc_generator::GetClassPrefix() + "Signals";
+
+  printer->Print(vars, "#import \"$Signals$.h\"\n\n");
+  printer->Print(vars, "@implementation $Signals$\n\n");
+
+  printer->Print(vars, "+ ($SignalId$) signalIdForName:(NSString*)name {\n");
+  printer->Indent();
+  printer->Print(vars, "static NSDictionary* signalIdForName;\n");
+  printer->Print(vars, "static dispatch_once_t onceToken;\n");
+  printer->Print(vars, "dispatch_once(&onceToken, ^{\n");
+  const vector<string> names = GetSignalNames(file, index);
+  printer->Print(vars, names.empty() ? "  signalIdForName = @{" : "  signalIdForName = @{\n");
+  printer->Indent();
+  printer->Indent();
+  for (size_t i = 0; i < names.size(); ++i) {
+    vars["Name"] = names[i];
+    printer->Print(vars, i + 1 < names.size() ? "@\"$Name$\": @($SignalId$_$Name$),\n" : "@\"$Name$\": @($SignalId$_$Name$)\n");
+  }
+  printer->Outdent();
+  printer->Outdent();
+  printer->Print(vars, names.empty() ? "};\n" : "  };\n");
+  printer->Print(vars, "});\n");
+  printer->Print(vars, "NSNumber* signalId = signalIdForName[name];\n");
+  printer->Print(vars, "return signalId != nil ? [signalId integerValue] : $SignalId$Count;\n");
+  printer->Outdent();
+  printer->Print(vars, "}\n\n");
 
-  return output;
+  printer->Print(vars, "@end\n");
 }
 
-string GetHeaderIncludes(const google::protobuf::ServiceDescriptor* service,
+void PrintHeaderIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const DescriptorIndex &index,
                          const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["ServiceMessagesIncludeFile"] = service->name() + ".pbobjc.h";
-    printer.Print(vars, "#import <Foundation/Foundation.h>\n\n");
-    printer.Print(vars, "#import \"DDPCallback.h\"\n\n");
-
-    // Forward decl all of the Args and responses classes.
-    set<string> classes = GetUniqueResponses(service);
-    for (int i = 0; i < service->method_count(); ++i) {
-      classes.insert(service->method(i)->name() + "Args");
-    }
+  map<string, string> vars;
 
-    printer.Print(vars, "@class DDPErrorResponse;\n");
-    for (set<string>::iterator it = classes.begin(); it != classes.end(); ++it) {
-      vars["ClassName"] = ddprpc_objc_generator::GetClassPrefix() + *it;
-      printer.Print(vars, "@class $ClassName$;\n");
-    }
-    printer.Print(vars, "\n");
+  vars["ServiceMessagesIncludeFile"] = service->name() + ".pbobjc.h";
+  printer->Print(vars, "#import <Foundation/Foundation.h>\n\n");
+  printer->Print(vars, "#import \"DDPCallback.h\"\n\n");
+
+  // Forward decl all of the Args and responses classes.
+  set<string> classes = index.GetUniqueResponses(service);
+  for (int i = 0; i < service->method_count(); ++i) {
+    classes.insert(service->method(i)->name() + "Args");
+  }
+
+  printer->Print(vars, "@class DDPErrorResponse;\n");
+  for (set<string>::iterator it = classes.begin(); it != classes.end(); ++it) {
+    vars["ClassName"] = ddprpc_objc_generator::GetClassPrefix() + *it;
+    printer->Print(vars, "@class $ClassName$;\n");
   }
-  return output;
+  printer->Print(vars, "\n");
 }
 
 void PrintMethodSuffix(google::protobuf::io::Printer *printer, const bool& is_declaration) {
@@ -248,16 +334,17 @@ void PrintMethodSuffix(google::protobuf::io::Printer *printer, const bool& is_de
 void PrintHeaderClientMethodInterfaces(
     google::protobuf::io::Printer *printer,
     const google::protobuf::MethodDescriptor *method,
+    const DescriptorIndex &index,
     map<string, string> *vars,
     const bool& is_declaration) {
   (*vars)["Method"] = LowercaseFirstLetter(method->name());
   (*vars)["MethodArgs"] = ddprpc_objc_generator::GetClassPrefix() + method->name() + "Args";
   (*vars)["Request"] = google::protobuf::compiler::objectivec::ClassName(method->input_type());
   (*vars)["Response"] = google::protobuf::compiler::objectivec::ClassName(method->output_type());
-  (*vars)["CompletionResponseName"] = GetCompletionResponse(method);
+  (*vars)["CompletionResponseName"] = index.GetCompletionResponse(method);
   (*vars)["CompletionResponseClass"]
-      = ddprpc_objc_generator::GetClassPrefix() + GetCompletionResponse(method);
-  const vector<string> update_responses = GetUpdateResponses(method);
+      = ddprpc_objc_generator::GetClassPrefix() + index.GetCompletionResponse(method);
+  const vector<string>& update_responses = index.GetUpdateResponses(method);
 
   printer->Print(
       *vars,
@@ -291,38 +378,34 @@ void PrintHeaderClientMethodInterfaces(
   }
 }
 
-string GetHeaderService(const google::protobuf::ServiceDescriptor* service,
+void PrintHeaderService(google::protobuf::io::Printer *printer,
+                        const google::protobuf::ServiceDescriptor* service,
+                        const DescriptorIndex &index,
                         const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["Service"] = "DDP" + service->name();
-    printer.Print(vars, "@interface $Service$ : NSObject\n\n");
+  map<string, string> vars;
 
-    for (int i = 0; i < service->method_count(); ++i) {
-      PrintHeaderClientMethodInterfaces(&printer, service->method(i), &vars, true);
-    }
+  vars["Service"] = "DDP" + service->name();
+  printer->Print(vars, "@interface $Service$ : NSObject\n\n");
 
-    printer.Print(vars, "\n");
-    printer.Print(vars, "@end");
+  for (int i = 0; i < service->method_count(); ++i) {
+    PrintHeaderClientMethodInterfaces(printer, service->method(i), index, &vars, true);
   }
-  return output;
+
+  printer->Print(vars, "\n");
+  printer->Print(vars, "@end");
 }
 
 
 void PrintServiceMethodImplementation(google::protobuf::io::Printer *printer,
                                       const google::protobuf::MethodDescriptor *method,
+                                      const DescriptorIndex &index,
                                       map<string, string> *vars) {
   (*vars)["ServiceName"] = ddprpc_objc_generator::GetClassPrefix() + method->service()->name();
   (*vars)["Method"] = LowercaseFirstLetter(method->name());
   (*vars)["MethodName"] = method->name();
-  (*vars)["CompletionResponse"] = GetCompletionResponse(method);
+  (*vars)["CompletionResponse"] = index.GetCompletionResponse(method);
   (*vars)["MessageId"] = ddprpc_objc_generator::GetClassPrefix() + "MessageId_" + method->name() + "Args";
-  const vector<string> update_responses = GetUpdateResponses(method);
+  const vector<string>& update_responses = index.GetUpdateResponses(method);
 
   printer->Print(*vars, "[DDPSignalManager clear:@\"$MethodName$Error\"];\n");
   for (int i = 0; i < update_responses.size(); ++i) {
@@ -376,190 +459,260 @@ void PrintServiceMethodImplementation(google::protobuf::io::Printer *printer,
 
 }
 
-string GetServiceImplementation(const google::protobuf::ServiceDescriptor* service,
+void PrintServiceImplementation(google::protobuf::io::Printer *printer,
+                                const google::protobuf::ServiceDescriptor* service,
+                                const DescriptorIndex &index,
                                 const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["Service"] = "DDP" + service->name();
-    printer.Print(vars, "@implementation $Service$\n");
-    printer.Print(vars, "\n");
-
-    for (int i = 0; i < service->method_count(); ++i) {
-      PrintHeaderClientMethodInterfaces(&printer, service->method(i), &vars, false);
-      printer.Indent();
-      PrintServiceMethodImplementation(&printer, service->method(i), &vars);
-      printer.Outdent();
-      printer.Print("}\n\n");
-    }
-
-    printer.Print(vars, "@end\n");
+  map<string, string> vars;
+
+  vars["Service"] = "DDP" + service->name();
+  printer->Print(vars, "@implementation $Service$\n");
+  printer->Print(vars, "\n");
+
+  for (int i = 0; i < service->method_count(); ++i) {
+    PrintHeaderClientMethodInterfaces(printer, service->method(i), index, &vars, false);
+    printer->Indent();
+    PrintServiceMethodImplementation(printer, service->method(i), index, &vars);
+    printer->Outdent();
+    printer->Print("}\n\n");
   }
-  return output;
+
+  printer->Print(vars, "@end\n");
 }
 
-string GetHeaderEpilogue(const google::protobuf::FileDescriptor *file,
+void PrintHeaderEpilogue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file,
                          const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-  }
-  return output;
 }
 
-string GetSourceIncludes(const google::protobuf::ServiceDescriptor* service, const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    vars["HeaderFilename"] = "DDP" + service->name() + ".h";
-    printer.Print(vars, "#import \"$HeaderFilename$\"\n");
-    printer.Print(vars, "\n");
-    printer.Print(vars, "#import \"DDPBridge.h\"\n");
-    printer.Print(vars, "#import \"DotDashPayAPI.h\"\n");
-    printer.Print(vars, "#import \"DDPLogging.h\"\n");
-    printer.Print(vars, "#import \"DDPSerialProtocol.h\"\n");
-    printer.Print(vars, "#import \"DDPSignalManager.h\"\n\n");
-
-    printer.Print(vars, "#import \"Common.pbobjc.h\"\n");
-    const set<string> classes = GetUniqueResponses(service, true);
-    for (set<string>::iterator it = classes.begin(); it != classes.end(); ++it) {
-      vars["ClassName"] = *it;
-      printer.Print(vars, "#import \"$ClassName$.pbobjc.h\"\n");
-    }
-    printer.Print(vars, "\n");
+void PrintSourceIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const DescriptorIndex &index,
+                         const Parameters &params) {
+  map<string, string> vars;
+
+  vars["HeaderFilename"] = "DDP" + service->name() + ".h";
+  printer->Print(vars, "#import \"$HeaderFilename$\"\n");
+  printer->Print(vars, "\n");
+  printer->Print(vars, "#import \"DDPBridge.h\"\n");
+  printer->Print(vars, "#import \"DotDashPayAPI.h\"\n");
+  printer->Print(vars, "#import \"DDPLogging.h\"\n");
+  printer->Print(vars, "#import \"DDPSerialProtocol.h\"\n");
+  printer->Print(vars, "#import \"DDPSignalManager.h\"\n\n");
+
+  printer->Print(vars, "#import \"Common.pbobjc.h\"\n");
+  const set<string>& classes = index.GetUniqueResponses(service, true);
+  for (set<string>::iterator it = classes.begin(); it != classes.end(); ++it) {
+    vars["ClassName"] = *it;
+    printer->Print(vars, "#import \"$ClassName$.pbobjc.h\"\n");
   }
-  return output;
+  printer->Print(vars, "\n");
 }
 
-string GetExamplesTemplate(const google::protobuf::FileDescriptor* file, const Parameters &params) {
-  string output;
-  {
-    // Scope the output stream so it closes and finalizes output to the string.
-    google::protobuf::io::StringOutputStream output_stream(&output);
-    google::protobuf::io::Printer printer(&output_stream, '$');
-    map<string, string> vars;
-
-    printer.Print(vars, "// @example-includes(all)\n");
-    printer.Print(vars, "#import <DotDashPayAPI/DotDashPayAPI.h>\n");
-    printer.Print(vars, "// @example-includes-end()\n\n");
-
-    for (int i = 0; i < file->service_count(); ++i) {
-      const google::protobuf::ServiceDescriptor* service = file->service(i);
-      vars["PackageName"] = service->name();
-      vars["PackageNameLowercase"] = LowercaseFirstLetter(service->name());
-
-      for (int j = 0; j < service->method_count(); ++j) {
-        const google::protobuf::MethodDescriptor* method = service->method(j);
-        const google::protobuf::Descriptor* args = method->input_type();
-        vars["MethodName"] = method->name();
-        vars["MethodNameLowercase"] = LowercaseFirstLetter(method->name());
-        vars["MethodArgsName"] = ddprpc_objc_generator::GetClassPrefix() + method->name() + "Args";
-
-        printer.Print(vars, "- (void) Example$MethodName$ {\n");
-        printer.Indent();
-
-        printer.Print(vars, "// @example-args($PackageName$.$MethodName$)\n");
-        printer.Print(vars, "$MethodArgsName$* args = [[$MethodArgsName$ alloc] init];\n");
-        for (int k = 0; k < args->field_count(); ++k) {
-          const google::protobuf::FieldDescriptor* field = args->field(k);
-          vars["OriginalFieldName"] = field->name();
-          vars["FieldName"] = LowercaseFirstLetter(LowerUnderscoreToUpperCamel(field->name()));
-          printer.Print(vars, "args.$FieldName$ = @example-value($OriginalFieldName$);\n");
-        }
-        printer.Print(vars, "// @example-args-end()\n\n");
-
-        printer.Print(vars, "[DotDashPayAPI.$PackageNameLowercase$ $MethodNameLowercase$:args\n");
-        printer.Print(vars, "// @example-error($PackageName$.$MethodName$)\n");
-        printer.Print(vars, "onError:^(DDPErrorResponse* error) {\n");
-        printer.Indent();
-
-        printer.Print(vars, "if ([error.errorCode isEqualToString:@\"\"]) {\n");
-        printer.Indent();
-
-        printer.Print(vars, "LOG(ERROR, @\"%@\", error.errorMessage);\n");
-        printer.Outdent();
-        printer.Print(vars, "}\n");
-
-        printer.Outdent();
-        printer.Print(vars, "}\n");
-
-        printer.Print(vars, "// @example-error-end()\n");
-
-        vector<string> responses = GetUpdateResponses(method);
-        responses.push_back(GetCompletionResponse(method));
-
-        for (int k = 0; k < responses.size(); ++k) {
-          vars["ResponseName"] = responses[k];
-          vars["ResponseNameClass"] = ddprpc_objc_generator::GetClassPrefix() + responses[k];
-          printer.Print(vars, "// @example-response($PackageName$.$ResponseName$)\n");
-          printer.Print(vars, "on$ResponseName$:^($ResponseNameClass$* response) {\n");
-          printer.Indent();
-
-          const google::protobuf::Descriptor* response = FindMessageByName(file, responses[k]);
-          if (response != NULL) {
-            for (int l = 0; l < response->field_count(); ++l) {  // Damnnnn. 'l' is deep.
-              const google::protobuf::FieldDescriptor* field = response->field(l);
-              // Don't output META examples.
-              if (field->name() == "META") {
-                continue;
-              }
-
-              vars["OriginalFieldName"] = field->name();
-              vars["FieldName"] = LowercaseFirstLetter(LowerUnderscoreToUpperCamel(field->name()));
-              const char* type_name = PrimitiveTypeName(field);
-              vars["FieldType"] = type_name ? type_name : "id";
-
-              printer.Print(vars, "$FieldType$* $FieldName$ = response.$FieldName$;  ");
-              printer.Print(vars, "// $FieldName$ = @example-value($OriginalFieldName$)\n");
+void PrintExamplesTemplate(google::protobuf::io::Printer *printer,
+                           const google::protobuf::FileDescriptor* file,
+                           const DescriptorIndex &index,
+                           const Parameters &params) {
+  map<string, string> vars;
+
+  printer->Print(vars, "// @example-includes(all)\n");
+  printer->Print(vars, "#import <DotDashPayAPI/DotDashPayAPI.h>\n");
+  printer->Print(vars, "// @example-includes-end()\n\n");
+
+  for (int i = 0; i < file->service_count(); ++i) {
+    const google::protobuf::ServiceDescriptor* service = file->service(i);
+    vars["PackageName"] = service->name();
+    vars["PackageNameLowercase"] = LowercaseFirstLetter(service->name());
+
+    for (int j = 0; j < service->method_count(); ++j) {
+      const google::protobuf::MethodDescriptor* method = service->method(j);
+      const google::protobuf::Descriptor* args = method->input_type();
+      vars["MethodName"] = method->name();
+      vars["MethodNameLowercase"] = LowercaseFirstLetter(method->name());
+      vars["MethodArgsName"] = ddprpc_objc_generator::GetClassPrefix() + method->name() + "Args";
+
+      printer->Print(vars, "- (void) Example$MethodName$ {\n");
+      printer->Indent();
+
+      printer->Print(vars, "// @example-args($PackageName$.$MethodName$)\n");
+      printer->Print(vars, "$MethodArgsName$* args = [[$MethodArgsName$ alloc] init];\n");
+      for (int k = 0; k < args->field_count(); ++k) {
+        const google::protobuf::FieldDescriptor* field = args->field(k);
+        vars["OriginalFieldName"] = field->name();
+        vars["FieldName"] = LowercaseFirstLetter(LowerUnderscoreToUpperCamel(field->name()));
+        printer->Print(vars, "args.$FieldName$ = @example-value($OriginalFieldName$);\n");
+      }
+      printer->Print(vars, "// @example-args-end()\n\n");
+
+      printer->Print(vars, "[DotDashPayAPI.$PackageNameLowercase$ $MethodNameLowercase$:args\n");
+      printer->Print(vars, "// @example-error($PackageName$.$MethodName$)\n");
+      printer->Print(vars, "onError:^(DDPErrorResponse* error) {\n");
+      printer->Indent();
+
+      printer->Print(vars, "if ([error.errorCode isEqualToString:@\"\"]) {\n");
+      printer->Indent();
+
+      printer->Print(vars, "LOG(ERROR, @\"%@\", error.errorMessage);\n");
+      printer->Outdent();
+      printer->Print(vars, "}\n");
+
+      printer->Outdent();
+      printer->Print(vars, "}\n");
+
+      printer->Print(vars, "// @example-error-end()\n");
+
+      vector<string> responses = index.GetUpdateResponses(method);
+      responses.push_back(index.GetCompletionResponse(method));
+
+      for (int k = 0; k < responses.size(); ++k) {
+        vars["ResponseName"] = responses[k];
+        vars["ResponseNameClass"] = ddprpc_objc_generator::GetClassPrefix() + responses[k];
+        printer->Print(vars, "// @example-response($PackageName$.$ResponseName$)\n");
+        printer->Print(vars, "on$ResponseName$:^($ResponseNameClass$* response) {\n");
+        printer->Indent();
+
+        const google::protobuf::Descriptor* response = index.FindMessageByName(method->file(), responses[k]);
+        if (response != NULL) {
+          for (int l = 0; l < response->field_count(); ++l) {  // Damnnnn. 'l' is deep.
+            const google::protobuf::FieldDescriptor* field = response->field(l);
+            // Don't output META examples.
+            if (field->name() == "META") {
+              continue;
             }
-          } else {
-            fprintf(stderr, "Could not find response defined in current context: %s\n", responses[k].c_str());
-          }
 
-          printer.Outdent();
-          printer.Print(vars, "}\n");
-          printer.Print(vars, "// @example-response-end()\n");
-        }
-        printer.Print(vars, "];\n\n");
-
-        printer.Print(vars, "// @example-request($PackageName$.$MethodName$)\n");
-        printer.Print(vars, "[DotDashPayAPI.$PackageNameLowercase$ $MethodNameLowercase$:args ");
-        printer.Print(vars, "onError:^(DDPErrorResponse* error) {\n");
-        printer.Indent();
-
-        printer.Print(vars, "// Handle error response\n");
-        printer.Outdent();
-        printer.Print(vars, "}");
-
-        for (int k = 0; k < responses.size(); ++k) {
-          vars["ResponseName"] = responses[k];
-          vars["ResponseNameClass"] = ddprpc_objc_generator::GetClassPrefix() + responses[k];
-          printer.Print(vars, " on$ResponseName$:^($ResponseNameClass$* response) {\n");
-          printer.Indent();
-
-          printer.Print(vars, "// Handle response\n");
-          printer.Outdent();
-          printer.Print(vars, "}");
+            vars["OriginalFieldName"] = field->name();
+            vars["FieldName"] = LowercaseFirstLetter(LowerUnderscoreToUpperCamel(field->name()));
+            const char* type_name = PrimitiveTypeName(field);
+            vars["FieldType"] = type_name ? type_name : "id";
+
+            printer->Print(vars, "$FieldType$* $FieldName$ = response.$FieldName$;  ");
+            printer->Print(vars, "// $FieldName$ = @example-value($OriginalFieldName$)\n");
+          }
+        } else {
+          fprintf(stderr, "Could not find response defined in current context: %s\n", responses[k].c_str());
         }
-        printer.Print("];\n");
-        printer.Print(vars, "// @example-request-end()\n\n");
-        printer.Outdent();
-        printer.Print(vars, "}\n\n");
 
+        printer->Outdent();
+        printer->Print(vars, "}\n");
+        printer->Print(vars, "// @example-response-end()\n");
       }
+      printer->Print(vars, "];\n\n");
+
+      printer->Print(vars, "// @example-request($PackageName$.$MethodName$)\n");
+      printer->Print(vars, "[DotDashPayAPI.$PackageNameLowercase$ $MethodNameLowercase$:args ");
+      printer->Print(vars, "onError:^(DDPErrorResponse* error) {\n");
+      printer->Indent();
+
+      printer->Print(vars, "// Handle error response\n");
+      printer->Outdent();
+      printer->Print(vars, "}");
+
+      for (int k = 0; k < responses.size(); ++k) {
+        vars["ResponseName"] = responses[k];
+        vars["ResponseNameClass"] = ddprpc_objc_generator::GetClassPrefix() + responses[k];
+        printer->Print(vars, " on$ResponseName$:^($ResponseNameClass$* response) {\n");
+        printer->Indent();
+
+        printer->Print(vars, "// Handle response\n");
+        printer->Outdent();
+        printer->Print(vars, "}");
+      }
+      printer->Print("];\n");
+      printer->Print(vars, "// @example-request-end()\n\n");
+      printer->Outdent();
+      printer->Print(vars, "}\n\n");
+
+    }
+  }
+}
+
+bool SetParameter(const string &key, const string &value, Parameters *params) {
+  return false;
+}
+
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const DescriptorIndex &index, const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context, string *error) {
+  // Every file is printed straight into the stream protoc hands us so
+  // that no generated code is held in an intermediate string.
+
+  // Build each of the "service implementations".
+  for (int i = 0; i < file->service_count(); ++i) {
+    const google::protobuf::ServiceDescriptor* service = file->service(i);
+    string file_name = "DDP" + ddprpc_generator::CapitalizeFirstLetter(service->name());
+    fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(
+          context->Open(file_name + ".h"));
+      google::protobuf::io::Printer printer(header_output.get(), '$');
+      PrintPrologue(&printer, file, params, true);
+      PrintHeaderIncludes(&printer, service, index, params);
+      PrintHeaderService(&printer, service, index, params);
+      PrintHeaderEpilogue(&printer, file, params);
+    }
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(
+          context->Open(file_name + ".m"));
+      google::protobuf::io::Printer printer(source_output.get(), '$');
+      PrintPrologue(&printer, file, params, false);
+      PrintSourceIncludes(&printer, service, index, params);
+      PrintServiceImplementation(&printer, service, index, params);
+    }
+  }
+
+  // Build the simulator.
+  {
+    string file_name = "DDPSimulatorMappings";
+    fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(context->Open(file_name + ".h"));
+      google::protobuf::io::Printer printer(header_output.get(), '$');
+      PrintPrologue(&printer, file, params, true);
+      PrintSimulatorHeader(&printer, file, params);
+    }
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(context->Open(file_name + ".m"));
+      google::protobuf::io::Printer printer(source_output.get(), '$');
+      PrintPrologue(&printer, file, params, false);
+      PrintSimulatorSource(&printer, file, index, params);
+    }
+  }
+
+  // Build the signal channels.
+  {
+    string file_name = ddprpc_objc_generator::GetClassPrefix() + "Signals";
+    fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(context->Open(file_name + ".h"));
+      google::protobuf::io::Printer printer(header_output.get(), '$');
+      PrintPrologue(&printer, file, params, true);
+      PrintSignalsHeader(&printer, file, index, params);
+    }
+
+    {
+      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(context->Open(file_name + ".m"));
+      google::protobuf::io::Printer printer(source_output.get(), '$');
+      PrintPrologue(&printer, file, params, false);
+      PrintSignalsSource(&printer, file, index, params);
     }
   }
-  return output;
+
+  // Build the examples template.
+  {
+    string file_name = "APIExamples.template.m";
+    fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
+
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(context->Open(file_name));
+    google::protobuf::io::Printer printer(source_output.get(), '$');
+    PrintExamplesTemplate(&printer, file, index, params);
+  }
+
+  return true;
 }
 
 }  // namespace ddprpc_objc_generator
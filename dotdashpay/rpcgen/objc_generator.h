@@ -37,7 +37,9 @@
 
 #include "generator_helpers.h"
 
+#include <google/protobuf/compiler/code_generator.h>
 #include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/printer.h>
 #include <string>
 
 namespace ddprpc_objc_generator {
@@ -46,33 +48,68 @@ namespace ddprpc_objc_generator {
 struct Parameters {
 };
 
-// Return the prologue of the generated header file.
-std::string GetPrologue(
-    const google::protobuf::FileDescriptor *file, const Parameters &params, const bool& is_header);
-
-// Return the includes for the generated header file.
-std::string GetHeaderIncludes(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the epilogue of the generated header file.
-std::string GetHeaderEpilogue(const google::protobuf::FileDescriptor *file, const Parameters &params);
-
-// Return the services for generated header file.
-std::string GetHeaderService(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the includes for the generated source file.
-std::string GetSourceIncludes(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the implementation of the service with name.
-std::string GetServiceImplementation(const google::protobuf::ServiceDescriptor* service, const Parameters &params);
-
-// Return the simulator header.
-std::string GetSimulatorHeader(const google::protobuf::FileDescriptor* file, const Parameters &params);
-
-// Return the simulator implementation.
-std::string GetSimulatorSource(const google::protobuf::FileDescriptor* file, const Parameters &params);
-
-// Return the examples template.
-std::string GetExamplesTemplate(const google::protobuf::FileDescriptor* file, const Parameters &params);
+// Set the parameter key to value. Returns false if key is unknown.
+bool SetParameter(const std::string &key, const std::string &value, Parameters *params);
+
+// Generate all of the output files for file into context. The file
+// must already have passed ddprpc_generator::ValidateFile and be
+// covered by index.
+bool GenerateFiles(const google::protobuf::FileDescriptor *file,
+                   const ddprpc_generator::DescriptorIndex &index, const Parameters &params,
+                   google::protobuf::compiler::GeneratorContext *context, std::string *error);
+
+// Print the prologue of the generated header file.
+void PrintPrologue(google::protobuf::io::Printer *printer,
+                   const google::protobuf::FileDescriptor *file, const Parameters &params, const bool& is_header);
+
+// Print the includes for the generated header file.
+void PrintHeaderIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the epilogue of the generated header file.
+void PrintHeaderEpilogue(google::protobuf::io::Printer *printer,
+                         const google::protobuf::FileDescriptor *file, const Parameters &params);
+
+// Print the services for generated header file.
+void PrintHeaderService(google::protobuf::io::Printer *printer,
+                        const google::protobuf::ServiceDescriptor* service,
+                        const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the includes for the generated source file.
+void PrintSourceIncludes(google::protobuf::io::Printer *printer,
+                         const google::protobuf::ServiceDescriptor* service,
+                         const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the implementation of the service with name.
+void PrintServiceImplementation(google::protobuf::io::Printer *printer,
+                                const google::protobuf::ServiceDescriptor* service,
+                                const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the simulator header.
+void PrintSimulatorHeader(google::protobuf::io::Printer *printer,
+                          const google::protobuf::FileDescriptor* file, const Parameters &params);
+
+// Print the simulator implementation.
+void PrintSimulatorSource(google::protobuf::io::Printer *printer,
+                          const google::protobuf::FileDescriptor* file,
+                          const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the header of the signal channels, an index for every error and
+// response of the services of file.
+void PrintSignalsHeader(google::protobuf::io::Printer *printer,
+                        const google::protobuf::FileDescriptor* file,
+                        const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the lookup of signal channels by name.
+void PrintSignalsSource(google::protobuf::io::Printer *printer,
+                        const google::protobuf::FileDescriptor* file,
+                        const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
+
+// Print the examples template.
+void PrintExamplesTemplate(google::protobuf::io::Printer *printer,
+                           const google::protobuf::FileDescriptor* file,
+                           const ddprpc_generator::DescriptorIndex &index, const Parameters &params);
 
 inline std::string GetClassPrefix() {
   return "DDP";
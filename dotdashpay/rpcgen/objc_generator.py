@@ -5,7 +5,7 @@ from google.protobuf.descriptor_pb2 import FieldDescriptorProto
 import jsbeautifier
 import os
 import re
-from subprocess import Popen, PIPE, STDOUT
+from subprocess import Popen, PIPE
 
 UNCRUSTIFY_ROOT_DIR = "{}{}..{}..{}thirdparty{}uncrustify".format(os.path.dirname(os.path.realpath(__file__)),
                                                                   os.path.sep,
@@ -17,8 +17,40 @@ UNCRUSTIFY_CFG = "{}{}configs{}objc.cfg".format(UNCRUSTIFY_ROOT_DIR, os.path.sep
 
 re_inline_comment = re.compile(ur"(.*;) *(//.*)(\n)(\n*)")
 
+class UncrustifyWorker:
+    """UncrustifyWorker keeps a single uncrustify process running in
+    --batch mode so the config is only loaded once per generate() run.
+
+    Each call to format writes one length-prefixed source to the
+    worker and reads back the formatted source framed the same way.
+
+    """
+
+    def __init__(self):
+        self.pipe = Popen([UNCRUSTIFY_PATH, "-q", "-l", "oc", "-c", "{}".format(UNCRUSTIFY_CFG), "--batch"],
+                          stdout=PIPE, stdin=PIPE)
+
+    def format(self, code):
+        source = u"{}\n".format(code).encode("utf-8")
+        self.pipe.stdin.write("{}\n".format(len(source)))
+        self.pipe.stdin.write(source)
+        self.pipe.stdin.flush()
+
+        header = self.pipe.stdout.readline()
+        if not header:
+            raise Exception("uncrustify exited with status {}".format(self.pipe.wait()))
+        return self.pipe.stdout.read(int(header)).decode("utf-8")
+
+    def close(self):
+        self.pipe.stdin.close()
+        self.pipe.wait()
+
 class ObjectiveCGenerator(DDPGenerator):
 
+    def __init__(self):
+        DDPGenerator.__init__(self)
+        self.uncrustify = None
+
     def class_prefix(self):
         return "DDP"
 
@@ -33,16 +65,23 @@ class ObjectiveCGenerator(DDPGenerator):
         if not os.path.isfile(UNCRUSTIFY_PATH):
             raise "Cannot beautify Objective-C code without uncrustify, which can be built via setup.sh"
 
-        pipe = Popen([UNCRUSTIFY_PATH, "-q", "-l", "oc", "-c", "{}".format(UNCRUSTIFY_CFG)],
-                     stdout=PIPE, stdin=PIPE, stderr=STDOUT)
-        output = pipe.communicate(input="{}\n".format(code))[0]
-        intermediate = output.decode()
+        if self.uncrustify is None:
+            self.uncrustify = UncrustifyWorker()
+        intermediate = self.uncrustify.format(code)
 
         # Fix annoying bug that doesn't keep spacing between code and
         # inline comment.
         fixed = re.sub(re_inline_comment, u"\g<1> \g<2>\n", intermediate)
         return fixed
 
+    def generate(self, services, outputs):
+        try:
+            DDPGenerator.generate(self, services, outputs)
+        finally:
+            if self.uncrustify is not None:
+                self.uncrustify.close()
+                self.uncrustify = None
+
     def get_type_name(self, protobuf_type):
         return {
             FieldDescriptorProto.TYPE_BOOL: "BOOL",
@@ -16,6 +16,25 @@
    --ddprpc_out=OUT_DIR services.proto
    ```
 
+   Pass `jobs=N` (e.g. `--ddprpc_out=jobs=4:OUT_DIR`) to limit the
+   number of files that are generated concurrently. By default one file
+   is generated per hardware thread.
+
+   Pass `manifest=OUT_DIR/.ddprpc_manifest` to only write the files
+   whose content changed since the previous run. The plugin records a
+   hash of every output in the manifest; files that are unchanged keep
+   their modification time so dependent builds do not recompile them.
+
+   The generated `DDPSignals.h` numbers every error and response channel
+   in `DDPSignalId`, and `[DDPSignals signalIdForName:]` maps the name
+   of an incoming response to its channel. The clients still register
+   their callbacks with `DDPSignalManager` by name until it can keep
+   them by channel.
+
+   Set `RPCGEN_DATA_FILE=<file>` to save the request protoc sends and
+   run the plugin with `--replay=<file> --iterations=N` to profile
+   generation without protoc (see `plugin_main.h`).
+
    This will generate an interface for each service defined in
    `services.proto` that an API implementation can "subclassed" to
    ensure the implementation is consistent with the services defiend
@@ -61,14 +80,17 @@
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **/
 #include "objc_generator.h"
+#include "generator_context.h"
+#include "plugin_main.h"
 
 #include <dotdashpay/api/common/protobuf/api_common.pb.h>
 #include <google/protobuf/compiler/code_generator.h>
-#include <google/protobuf/compiler/plugin.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 using std::string;
 
@@ -83,80 +105,44 @@ class ObjcGenerator : public google::protobuf::compiler::CodeGenerator {
                         const string &parameter,
                         google::protobuf::compiler::GeneratorContext *context,
                         string *error) const {
-    ddprpc_objc_generator::Parameters generator_parameters;
+    std::vector<const google::protobuf::FileDescriptor*> files(1, file);
+    return GenerateAll(files, parameter, context, error);
+  }
 
-    if (!file->options().HasExtension(dotdashpay::api::common::api_major_version)
-        || !file->options().HasExtension(dotdashpay::api::common::api_minor_version)) {
-      *error = "ddprpc compiler requires that api_major_version and api_major_version "
-               "are set in the options";
-      return false;
-    }
+  // Files are independent of each other so they are generated
+  // concurrently; see ddprpc_generator::GenerateInParallel.
+  virtual bool GenerateAll(const std::vector<const google::protobuf::FileDescriptor*> &files,
+                           const string &parameter,
+                           google::protobuf::compiler::GeneratorContext *context,
+                           string *error) const {
+    ddprpc_objc_generator::Parameters generator_parameters;
+    ddprpc_generator::GenerationOptions generation_options;
 
-    // Ensure the protobuf file conforms to what we're expecting.
-    if (!ddprpc_generator::IsConformant(file, error)) {
+    std::vector<std::pair<string, string> > parameters;
+    if (!ddprpc_generator::ParseParameters(parameter, &parameters, error)) {
       return false;
     }
-
-    // Build each of the "service implementations".
-    for (int i = 0; i < file->service_count(); ++i) {
-      const google::protobuf::ServiceDescriptor* service = file->service(i);
-      string file_name = "DDP" + ddprpc_generator::CapitalizeFirstLetter(service->name());
-      fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
-
-      string header_code =
-          ddprpc_objc_generator::GetPrologue(file, generator_parameters, true) +
-          ddprpc_objc_generator::GetHeaderIncludes(service, generator_parameters) +
-          ddprpc_objc_generator::GetHeaderService(service, generator_parameters) +
-          ddprpc_objc_generator::GetHeaderEpilogue(file, generator_parameters);
-      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(
-          context->Open(file_name + ".h"));
-      google::protobuf::io::CodedOutputStream header_coded_out(
-          header_output.get());
-      header_coded_out.WriteRaw(header_code.data(), header_code.size());
-
-      string source_code =
-          ddprpc_objc_generator::GetPrologue(file, generator_parameters, false) +
-          ddprpc_objc_generator::GetSourceIncludes(service, generator_parameters) +
-          ddprpc_objc_generator::GetServiceImplementation(service, generator_parameters);
-      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(
-          context->Open(file_name + ".m"));
-      google::protobuf::io::CodedOutputStream source_coded_out(
-          source_output.get());
-      source_coded_out.WriteRaw(source_code.data(), source_code.size());
-    }
-
-    // Build the simulator.
-    {
-      string file_name = "DDPSimulatorMappings";
-      fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
-
-      string header_code =
-          ddprpc_objc_generator::GetPrologue(file, generator_parameters, true) +
-          ddprpc_objc_generator::GetSimulatorHeader(file, generator_parameters);
-      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> header_output(context->Open(file_name + ".h"));
-      google::protobuf::io::CodedOutputStream header_coded_out(header_output.get());
-      header_coded_out.WriteRaw(header_code.data(), header_code.size());
-
-      string source_code =
-          ddprpc_objc_generator::GetPrologue(file, generator_parameters, false) +
-          ddprpc_objc_generator::GetSimulatorSource(file, generator_parameters);
-      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(context->Open(file_name + ".m"));
-      google::protobuf::io::CodedOutputStream source_coded_out(source_output.get());
-      source_coded_out.WriteRaw(source_code.data(), source_code.size());
-    }
-
-    // Build the examples template.
-    {
-      string file_name = "APIExamples.template.m";
-      fprintf(stderr, "Generating objc file: %s\n", file_name.c_str());
-
-      string source_code = ddprpc_objc_generator::GetExamplesTemplate(file, generator_parameters);
-      std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> source_output(context->Open(file_name));
-      google::protobuf::io::CodedOutputStream source_coded_out(source_output.get());
-      source_coded_out.WriteRaw(source_code.data(), source_code.size());
+    for (auto param = parameters.begin(); param != parameters.end(); param++) {
+      if (!ddprpc_generator::SetGenerationParameter(param->first, param->second, &generation_options)
+          && !ddprpc_objc_generator::SetParameter(param->first, param->second, &generator_parameters)) {
+        *error = string("Unknown parameter: ") + param->first;
+        return false;
+      }
     }
 
-    return true;
+    // Analyze the descriptors once up front; every job shares the index.
+    const ddprpc_generator::DescriptorIndex index(files);
+
+    return ddprpc_generator::GenerateInParallel(
+        files.size(), generation_options, context, error,
+        [&](int i, google::protobuf::compiler::GeneratorContext *file_context, string *file_error) {
+          if (!ddprpc_generator::ValidateFile(files[i], file_error)
+              || !ddprpc_objc_generator::GenerateFiles(files[i], index, generator_parameters, file_context, file_error)) {
+            *file_error = files[i]->name() + ": " + *file_error;
+            return false;
+          }
+          return true;
+        });
   }
 
  private:
@@ -175,5 +161,5 @@ class ObjcGenerator : public google::protobuf::compiler::CodeGenerator {
 
 int main(int argc, char** argv) {
   dotdashpay::rpcgen::ObjcGenerator generator;
-  return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+  return ddprpc_generator::PluginMain(argc, argv, &generator);
 }
@@ -0,0 +1,193 @@
+/**
+   Entry point shared by the plugin binaries.
+**/
+
+#include "plugin_main.h"
+
+#ifdef DDPRPC_COUNT_ALLOCATIONS
+#include "allocation_counter.h"
+#endif
+
+#include <google/protobuf/compiler/plugin.h>
+#include <google/protobuf/compiler/plugin.pb.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+using std::string;
+
+namespace ddprpc_generator {
+
+namespace {
+
+bool ReadFile(const string &filename, string *data) {
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!input) {
+    return false;
+  }
+  std::ostringstream contents;
+  contents << input.rdbuf();
+  *data = contents.str();
+  return true;
+}
+
+bool WriteFile(const string &filename, const string &data) {
+  std::ofstream output(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  output.write(data.data(), data.size());
+  return static_cast<bool>(output);
+}
+
+// Generate request and write the response to stdout, as PluginMain does.
+int GenerateRequest(const string &data, const google::protobuf::compiler::CodeGenerator *generator) {
+  google::protobuf::compiler::CodeGeneratorRequest request;
+  if (!request.ParseFromString(data)) {
+    fprintf(stderr, "Could not parse the CodeGeneratorRequest.\n");
+    return 1;
+  }
+
+  google::protobuf::compiler::CodeGeneratorResponse response;
+  string error;
+  if (!google::protobuf::compiler::GenerateCode(request, *generator, &response, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (!response.SerializeToOstream(&std::cout)) {
+    fprintf(stderr, "Could not write the CodeGeneratorResponse.\n");
+    return 1;
+  }
+  return 0;
+}
+
+// CPU time, user and system, used by the process so far.
+double CpuTimeMs(const struct rusage &usage) {
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0
+      + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+int Replay(const string &filename, int iterations,
+           const google::protobuf::compiler::CodeGenerator *generator) {
+  string data;
+  google::protobuf::compiler::CodeGeneratorRequest request;
+  if (!ReadFile(filename, &data) || !request.ParseFromString(data)) {
+    fprintf(stderr, "Could not read a CodeGeneratorRequest from %s.\n", filename.c_str());
+    return 1;
+  }
+
+  double total_ms = 0;
+  double best_ms = 0;
+  size_t file_count = 0;
+  size_t byte_count = 0;
+#ifdef DDPRPC_COUNT_ALLOCATIONS
+  unsigned long long total_allocations = 0;
+  unsigned long long total_allocated_bytes = 0;
+#endif
+
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    google::protobuf::compiler::CodeGeneratorResponse response;
+    string error;
+
+#ifdef DDPRPC_COUNT_ALLOCATIONS
+    const AllocationCounts before = GetAllocationCounts();
+#endif
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!google::protobuf::compiler::GenerateCode(request, *generator, &response, &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+#ifdef DDPRPC_COUNT_ALLOCATIONS
+    const AllocationCounts after = GetAllocationCounts();
+    total_allocations += after.allocations - before.allocations;
+    total_allocated_bytes += after.bytes - before.bytes;
+#endif
+
+    if (response.has_error()) {
+      fprintf(stderr, "%s\n", response.error().c_str());
+      return 1;
+    }
+
+    total_ms += elapsed_ms;
+    best_ms = iteration == 0 ? elapsed_ms : std::min(best_ms, elapsed_ms);
+    file_count = response.file_size();
+    byte_count = 0;
+    for (int i = 0; i < response.file_size(); ++i) {
+      byte_count += response.file(i).content().size();
+    }
+  }
+
+  printf("replayed %s %d times: %zu files, %zu bytes per iteration\n",
+         filename.c_str(), iterations, file_count, byte_count);
+  printf("time ms: total %.2f, mean %.3f, best %.3f\n",
+         total_ms, total_ms / iterations, best_ms);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("cpu ms: total %.2f, peak rss: %ld KB\n", CpuTimeMs(usage), usage.ru_maxrss);
+#ifdef DDPRPC_COUNT_ALLOCATIONS
+  printf("allocations per iteration: %llu (%llu bytes)\n",
+         total_allocations / iterations, total_allocated_bytes / iterations);
+#else
+  printf("allocations per iteration: not counted, configure with -DCOUNT_ALLOCATIONS=ON\n");
+#endif
+  return 0;
+}
+
+}  // namespace
+
+int PluginMain(int argc, char** argv, const google::protobuf::compiler::CodeGenerator *generator) {
+  string replay_file;
+  bool has_iterations = false;
+  int iterations = 1;
+  for (int i = 1; i < argc; ++i) {
+    const string argument = argv[i];
+    if (argument.compare(0, 9, "--replay=") == 0) {
+      replay_file = argument.substr(9);
+    } else if (argument.compare(0, 13, "--iterations=") == 0) {
+      iterations = std::max(1, atoi(argument.substr(13).c_str()));
+      has_iterations = true;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      fprintf(stderr, "Usage: %s [--replay=<request file> [--iterations=N]]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (has_iterations && replay_file.empty()) {
+    fprintf(stderr, "--iterations can only be used with --replay.\n");
+    fprintf(stderr, "Usage: %s [--replay=<request file> [--iterations=N]]\n", argv[0]);
+    return 1;
+  }
+  if (!replay_file.empty()) {
+    return Replay(replay_file, iterations, generator);
+  }
+
+  const char* data_file = getenv("RPCGEN_DATA_FILE");
+  if (data_file == NULL) {
+    return google::protobuf::compiler::PluginMain(argc, argv, generator);
+  }
+
+  string data;
+  if (getenv("RPCGEN_DEBUG_MODE") != NULL) {
+    if (!ReadFile(data_file, &data)) {
+      fprintf(stderr, "Could not read %s.\n", data_file);
+      return 1;
+    }
+  } else {
+    data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    if (!WriteFile(data_file, data)) {
+      fprintf(stderr, "Could not write %s.\n", data_file);
+      return 1;
+    }
+  }
+  return GenerateRequest(data, generator);
+}
+
+}  // namespace ddprpc_generator
@@ -0,0 +1,43 @@
+/**
+   Entry point shared by the plugin binaries. Besides running under
+   protoc it can capture the request protoc sends and replay it later,
+   which keeps protoc out of the loop when debugging or profiling a
+   back-end:
+
+   ```bash
+   RPCGEN_DATA_FILE=/tmp/request.bin protoc --plugin=protoc-gen-ddprpc=ddprpc_cpp_plugin ...
+   ddprpc_cpp_plugin --replay=/tmp/request.bin --iterations=100
+   ```
+
+   As with `ddp_generator.py`, setting both `RPCGEN_DATA_FILE` and
+   `RPCGEN_DEBUG_MODE` runs the captured request once and writes the
+   response to stdout.
+**/
+
+#ifndef __DOTDASHPAY_RPCGEN_PLUGIN_MAIN_H__
+#define __DOTDASHPAY_RPCGEN_PLUGIN_MAIN_H__
+
+#include <google/protobuf/compiler/code_generator.h>
+
+namespace ddprpc_generator {
+
+// Run generator according to argv and the environment:
+//
+// - `--replay=<file> [--iterations=N]` generates the request captured
+//   in file N times (default 1), discards the output and prints the
+//   wall time, the CPU time and the peak resident set size. Builds
+//   configured with COUNT_ALLOCATIONS=ON also print the allocations and
+//   bytes allocated per iteration.
+//   `--iterations` without `--replay` is a usage error.
+// - `RPCGEN_DATA_FILE` and `RPCGEN_DEBUG_MODE` read the request from
+//   the data file instead of stdin.
+// - `RPCGEN_DATA_FILE` alone saves the request read from stdin to the
+//   data file before generating.
+// - Otherwise this is protoc's PluginMain.
+//
+// Returns the process exit code.
+int PluginMain(int argc, char** argv, const google::protobuf::compiler::CodeGenerator *generator);
+
+}  // namespace ddprpc_generator
+
+#endif  // __DOTDASHPAY_RPCGEN_PLUGIN_MAIN_H__
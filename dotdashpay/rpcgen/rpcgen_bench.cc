@@ -0,0 +1,299 @@
+/**
+   `rpcgen_bench` measures how long the C++, Objective-C and Node.js
+   back-ends take to generate synthetic APIs of increasing size.
+
+   Each API is a services file with the requested number of methods,
+   split into services of at most 100 methods, plus a messages file with
+   the argument and response messages. Every method has several update
+   responses. The back-ends run in-process against the same
+   DescriptorIndex and an in-memory GeneratorContext, exactly as they do
+   inside the plugins, so protoc and the disk are not part of the
+   measurement.
+
+   Run it from an optimized build (`cmake -DDEBUG_SYMBOLS=OFF ..`):
+
+   ```bash
+   rpcgen_bench [--methods=10,1000,50000] [--updates=8] [--iterations=3]
+   ```
+
+   For every API size and language it reports the number of files and
+   bytes emitted, the best wall time over the iterations, the time per
+   generated file and the peak resident set size of the process so far.
+**/
+#include "cpp_generator.h"
+#include "generator_context.h"
+#include "nodejs_generator.h"
+#include "objc_generator.h"
+
+#include <dotdashpay/api/common/protobuf/api_common.pb.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace {
+
+const int kMethodsPerService = 100;
+const int kResponseMessageCount = 64;
+
+struct BenchmarkOptions {
+  BenchmarkOptions() : updates(8), iterations(3) {
+    methods.push_back(10);
+    methods.push_back(1000);
+    methods.push_back(50000);
+  }
+
+  std::vector<int> methods;
+  int updates;
+  int iterations;
+};
+
+string MethodName(int method) {
+  return "Method" + std::to_string(method);
+}
+
+string ResponseName(int response) {
+  return "Response" + std::to_string(response);
+}
+
+// Build the messages used by the synthetic services: one Args message per
+// method and a shared pool of response messages.
+google::protobuf::FileDescriptorProto MessagesFile(int method_count) {
+  google::protobuf::FileDescriptorProto file;
+  file.set_name("bench/messages_" + std::to_string(method_count) + ".proto");
+  file.set_package("bench");
+
+  for (int i = 0; i < method_count; ++i) {
+    google::protobuf::DescriptorProto* args = file.add_message_type();
+    args->set_name(MethodName(i) + "Args");
+
+    google::protobuf::FieldDescriptorProto* field = args->add_field();
+    field->set_name("amount");
+    field->set_number(1);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_REQUIRED);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_INT32);
+
+    field = args->add_field();
+    field->set_name("memo");
+    field->set_number(2);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_STRING);
+    field->set_default_value("memo");
+
+    field = args->add_field();
+    field->set_name("enabled");
+    field->set_number(3);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_REQUIRED);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_BOOL);
+  }
+
+  for (int i = 0; i < kResponseMessageCount; ++i) {
+    google::protobuf::DescriptorProto* response = file.add_message_type();
+    response->set_name(ResponseName(i));
+
+    google::protobuf::FieldDescriptorProto* field = response->add_field();
+    field->set_name("status");
+    field->set_number(1);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_STRING);
+
+    field = response->add_field();
+    field->set_name("count");
+    field->set_number(2);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_UINT32);
+  }
+
+  return file;
+}
+
+// Build a services file with method_count methods, each of which has
+// update_count update responses and a completion response.
+google::protobuf::FileDescriptorProto ServicesFile(const string &messages_file, const string &api_common_file,
+                                                   int method_count, int update_count) {
+  google::protobuf::FileDescriptorProto file;
+  file.set_name("bench/services_" + std::to_string(method_count) + ".proto");
+  file.set_package("bench");
+  file.add_dependency(api_common_file);
+  file.add_dependency(messages_file);
+  file.mutable_options()->SetExtension(dotdashpay::api::common::api_major_version, 1);
+  file.mutable_options()->SetExtension(dotdashpay::api::common::api_minor_version, 0);
+
+  google::protobuf::ServiceDescriptorProto* service = NULL;
+  for (int i = 0; i < method_count; ++i) {
+    if (i % kMethodsPerService == 0) {
+      service = file.add_service();
+      service->set_name("Service" + std::to_string(i / kMethodsPerService));
+    }
+
+    google::protobuf::MethodDescriptorProto* method = service->add_method();
+    method->set_name(MethodName(i));
+    method->set_input_type(".bench." + MethodName(i) + "Args");
+    method->set_output_type(".bench." + ResponseName(i % kResponseMessageCount));
+
+    google::protobuf::MethodOptions* options = method->mutable_options();
+    for (int j = 0; j < update_count; ++j) {
+      options->AddExtension(dotdashpay::api::common::update_response,
+                            "bench." + ResponseName((i + j + 1) % kResponseMessageCount));
+    }
+    options->SetExtension(dotdashpay::api::common::completion_response,
+                          "bench." + ResponseName(i % kResponseMessageCount));
+  }
+
+  return file;
+}
+
+// Add file and, first, everything it imports from the generated pool.
+void AddGeneratedFile(const google::protobuf::FileDescriptor *file, google::protobuf::DescriptorPool *pool) {
+  if (pool->FindFileByName(file->name()) != NULL) {
+    return;
+  }
+  for (int i = 0; i < file->dependency_count(); ++i) {
+    AddGeneratedFile(file->dependency(i), pool);
+  }
+  google::protobuf::FileDescriptorProto proto;
+  file->CopyTo(&proto);
+  pool->BuildFile(proto);
+}
+
+size_t PeakResidentSetKb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+typedef std::function<bool(google::protobuf::compiler::GeneratorContext *context, string *error)> LanguageRun;
+
+bool RunLanguage(int method_count, const string &language, const BenchmarkOptions &options,
+                 const LanguageRun &run) {
+  double best_ms = 0;
+  size_t file_count = 0;
+  size_t byte_count = 0;
+
+  for (int iteration = 0; iteration < options.iterations; ++iteration) {
+    ddprpc_generator::MemoryGeneratorContext context;
+    string error;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!run(&context, &error)) {
+      fprintf(stderr, "%s generation failed: %s\n", language.c_str(), error.c_str());
+      return false;
+    }
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (iteration == 0 || elapsed_ms < best_ms) {
+      best_ms = elapsed_ms;
+    }
+    file_count = context.files().size();
+    byte_count = 0;
+    for (auto file = context.files().begin(); file != context.files().end(); file++) {
+      byte_count += file->content.size();
+    }
+  }
+
+  printf("%8d  %-7s  %6zu  %12zu  %10.2f  %10.4f  %12zu\n",
+         method_count, language.c_str(), file_count, byte_count, best_ms,
+         file_count > 0 ? best_ms / file_count : 0.0, PeakResidentSetKb());
+  fflush(stdout);
+  return true;
+}
+
+bool RunBenchmark(int method_count, const BenchmarkOptions &options) {
+  const google::protobuf::FileDescriptor *api_common =
+      google::protobuf::DescriptorPool::generated_pool()->FindExtensionByName(
+          "dotdashpay.api.common.completion_response")->file();
+
+  google::protobuf::DescriptorPool pool;
+  AddGeneratedFile(api_common, &pool);
+
+  const google::protobuf::FileDescriptor *messages = pool.BuildFile(MessagesFile(method_count));
+  const google::protobuf::FileDescriptor *services =
+      messages == NULL ? NULL : pool.BuildFile(
+          ServicesFile(messages->name(), api_common->name(), method_count, options.updates));
+  if (services == NULL) {
+    fprintf(stderr, "Could not build the synthetic API with %d methods\n", method_count);
+    return false;
+  }
+
+  string error;
+  if (!ddprpc_generator::ValidateFile(services, &error)) {
+    fprintf(stderr, "Synthetic API is not conformant: %s\n", error.c_str());
+    return false;
+  }
+
+  const std::vector<const google::protobuf::FileDescriptor*> files(1, services);
+  const ddprpc_generator::DescriptorIndex index(files);
+
+  const ddprpc_cpp_generator::Parameters cpp_parameters;
+  const ddprpc_objc_generator::Parameters objc_parameters;
+  const ddprpc_nodejs_generator::Parameters nodejs_parameters;
+
+  return RunLanguage(method_count, "cpp", options,
+                     [&](google::protobuf::compiler::GeneratorContext *context, string *run_error) {
+                       return ddprpc_cpp_generator::GenerateFiles(services, index, cpp_parameters,
+                                                                  context, run_error);
+                     })
+      && RunLanguage(method_count, "objc", options,
+                     [&](google::protobuf::compiler::GeneratorContext *context, string *run_error) {
+                       return ddprpc_objc_generator::GenerateFiles(services, index, objc_parameters,
+                                                                   context, run_error);
+                     })
+      && RunLanguage(method_count, "nodejs", options,
+                     [&](google::protobuf::compiler::GeneratorContext *context, string *run_error) {
+                       return ddprpc_nodejs_generator::GenerateFiles(services, index, nodejs_parameters,
+                                                                     context, run_error);
+                     });
+}
+
+bool ParseArguments(int argc, char** argv, BenchmarkOptions *options) {
+  for (int i = 1; i < argc; ++i) {
+    string argument = argv[i];
+    const size_t equals_pos = argument.find('=');
+    const string key = argument.substr(0, equals_pos);
+    const string value = equals_pos == string::npos ? "" : argument.substr(equals_pos + 1);
+
+    if (key == "--methods") {
+      options->methods.clear();
+      std::vector<string> counts = ddprpc_generator::tokenize(value, ",");
+      for (auto count = counts.begin(); count != counts.end(); count++) {
+        options->methods.push_back(atoi(count->c_str()));
+      }
+    } else if (key == "--updates") {
+      options->updates = atoi(value.c_str());
+    } else if (key == "--iterations") {
+      options->iterations = std::max(1, atoi(value.c_str()));
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      fprintf(stderr, "Usage: %s [--methods=10,1000,50000] [--updates=8] [--iterations=3]\n", argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchmarkOptions options;
+  if (!ParseArguments(argc, argv, &options)) {
+    return 1;
+  }
+
+  printf("%8s  %-7s  %6s  %12s  %10s  %10s  %12s\n",
+         "methods", "lang", "files", "bytes", "best_ms", "ms/file", "peak_rss_kb");
+  for (auto method_count = options.methods.begin(); method_count != options.methods.end(); method_count++) {
+    if (!RunBenchmark(*method_count, options)) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,863 @@
+// Generated by the ddpRPC protobuf plugin.
+// If you make any local change, they will be lost.
+// source: caching.proto
+#ifndef __DOTDASHPAY_caching_2eproto__INCLUDED
+#define __DOTDASHPAY_caching_2eproto__INCLUDED
+
+#define DDP_API_MAJOR_VERSION 1
+#define DDP_API_MINOR_VERSION 0
+
+#include "caching.pb.h"
+
+#include <dotdashpay/common/function.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/message_lite.h>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+#ifndef __DOTDASHPAY_DDPRPC_REQUEST_KEY__
+#define __DOTDASHPAY_DDPRPC_REQUEST_KEY__
+
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// The deterministic serialization of request, which byte-identical
+// requests share.
+inline std::string RequestKey(const ::google::protobuf::MessageLite& request) {
+  std::string key;
+  ::google::protobuf::io::StringOutputStream stream(&key);
+  ::google::protobuf::io::CodedOutputStream output(&stream);
+  output.SetSerializationDeterministic(true);
+  request.SerializePartialToCodedStream(&output);
+  output.Trim();
+  return key;
+}
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_REQUEST_KEY__
+
+
+#ifndef __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__
+#define __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// Maps request keys to the completion responses they produced.
+// Every response is kept for the same time-to-live, so entries expire
+// in insertion order and the oldest one is evicted to stay within
+// capacity. Safe to use from several threads.
+class ResponseCache {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  ResponseCache(size_t capacity, Clock::duration ttl) : capacity_(capacity), ttl_(ttl) {}
+
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+
+  // The response cached for the request with key, or NULL if there is
+  // none or it has expired.
+  std::shared_ptr<const ::google::protobuf::Message> Find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entries::iterator entry = entries_.find(key);
+    if (entry == entries_.end()) {
+      return nullptr;
+    }
+    if (entry->second.expires <= Clock::now()) {
+      Erase(entry);
+      return nullptr;
+    }
+    return entry->second.response;
+  }
+
+  // Cache a copy of response for the request with key.
+  void Insert(const std::string& key, const ::google::protobuf::Message& response) {
+    if (capacity_ == 0) {
+      return;
+    }
+    ::google::protobuf::Message* copy = response.New();
+    copy->CopyFrom(response);
+    std::shared_ptr<const ::google::protobuf::Message> cached(copy);
+    const Clock::time_point expires = Clock::now() + ttl_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entries::iterator entry = entries_.find(key);
+    if (entry != entries_.end()) {
+      Erase(entry);
+    }
+    while (entries_.size() >= capacity_) {
+      Erase(entries_.find(*order_.front()));
+    }
+    entry = entries_.insert(std::make_pair(key, Entry())).first;
+    entry->second.expires = expires;
+    entry->second.response = std::move(cached);
+    entry->second.position = order_.insert(order_.end(), &entry->first);
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    order_.clear();
+  }
+
+ private:
+  struct Entry {
+    Clock::time_point expires;
+    std::shared_ptr<const ::google::protobuf::Message> response;
+    std::list<const std::string*>::iterator position;
+  };
+  typedef std::unordered_map<std::string, Entry> Entries;
+
+  void Erase(Entries::iterator entry) {
+    order_.erase(entry->second.position);
+    entries_.erase(entry);
+  }
+
+  const size_t capacity_;
+  const Clock::duration ttl_;
+  Entries entries_;
+  // The keys of entries_, oldest first.
+  std::list<const std::string*> order_;
+  std::mutex mutex_;
+};
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_RESPONSE_CACHE__
+
+
+#ifndef __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__
+#define __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__
+
+#include <mutex>
+#include <unordered_map>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// The calls of one method that are in flight, by request key. The
+// handlers of identical requests made while one is in flight are
+// attached to it and share its responses instead of sending the
+// request again. Safe to use from several threads.
+template <class UpdateFunction, class CompletionFunction>
+class SingleFlight {
+ public:
+  SingleFlight() {}
+
+  SingleFlight(const SingleFlight&) = delete;
+  SingleFlight& operator=(const SingleFlight&) = delete;
+
+  // Attach the handlers to the call for the request with key. Returns
+  // true if there was no such call yet and the caller has to send the
+  // request.
+  bool Join(const std::string& key, UpdateFunction update_handler, CompletionFunction completion_handler) {
+    std::shared_ptr<Handlers> handlers(new Handlers(std::move(update_handler), std::move(completion_handler)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::pair<typename Calls::iterator, bool> call = calls_.insert(std::make_pair(key, Call()));
+    call.first->second.push_back(std::move(handlers));
+    return call.second;
+  }
+
+  // Pass an update response of the call for the request with key to
+  // every handler attached so far.
+  void Update(const std::string& key, const ::google::protobuf::Message& update) {
+    Call call;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      typename Calls::iterator found = calls_.find(key);
+      if (found == calls_.end()) {
+        return;
+      }
+      call = found->second;
+    }
+    for (size_t i = 0; i < call.size(); ++i) {
+      if (call[i]->update_handler) {
+        call[i]->update_handler(update);
+      }
+    }
+  }
+
+  // Pass the completion response of the call for the request with key
+  // to every attached handler. Identical requests made afterwards
+  // start a new call.
+  void Complete(const std::string& key, const ::google::protobuf::Message& completion) {
+    Call call;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      typename Calls::iterator found = calls_.find(key);
+      if (found == calls_.end()) {
+        return;
+      }
+      call.swap(found->second);
+      calls_.erase(found);
+    }
+    for (size_t i = 0; i < call.size(); ++i) {
+      call[i]->completion_handler(completion);
+    }
+  }
+
+ private:
+  struct Handlers {
+    Handlers(UpdateFunction update_handler, CompletionFunction completion_handler)
+        : update_handler(std::move(update_handler)), completion_handler(std::move(completion_handler)) {}
+
+    UpdateFunction update_handler;
+    CompletionFunction completion_handler;
+  };
+  typedef std::vector<std::shared_ptr<Handlers> > Call;
+  typedef std::unordered_map<std::string, Call> Calls;
+
+  Calls calls_;
+  std::mutex mutex_;
+};
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_SINGLE_FLIGHT__
+
+
+namespace rpcgentest {
+
+// Registry of every update and completion response of the services
+// in caching.proto.
+struct CachingResponses {
+  // Tags are assigned in name order, so they are only stable between
+  // peers built from the same API version.
+  enum class Tag : uint32_t {
+    kLookupDone = 0,
+    kLookupProgress = 1,
+  };
+  static constexpr uint32_t kTagCount = 2;
+
+  // Set tag to the tag of the response message called name. Returns
+  // false if no service in the file uses such a response.
+  static bool FindTag(const char* name, Tag* tag) {
+    struct ResponseName {
+      const char* name;
+      Tag tag;
+    };
+    static constexpr ResponseName kResponseNames[] = {
+      {"LookupDone", Tag::kLookupDone},
+      {"LookupProgress", Tag::kLookupProgress},
+    };
+
+    size_t low = 0;
+    size_t high = kTagCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kResponseNames[middle].name);
+      if (order == 0) {
+        *tag = kResponseNames[middle].tag;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the size bytes at data as the response identified by tag.
+  // The response is allocated on arena, or on the heap and owned by
+  // the caller when arena is NULL. Returns NULL if tag is unknown or
+  // the response does not parse.
+  static ::google::protobuf::Message* ParseResponse(Tag tag, const void* data, size_t size,
+                                                    ::google::protobuf::Arena* arena) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return NULL;
+    }
+    ::google::protobuf::Message* response = NULL;
+    switch (tag) {
+      case Tag::kLookupDone:
+        response = ::google::protobuf::Arena::CreateMessage<::rpcgentest::LookupDone>(arena);
+        break;
+      case Tag::kLookupProgress:
+        response = ::google::protobuf::Arena::CreateMessage<::rpcgentest::LookupProgress>(arena);
+        break;
+    }
+    if (response != NULL && !response->ParseFromArray(data, static_cast<int>(size))) {
+      if (arena == NULL) {
+        delete response;
+      }
+      return NULL;
+    }
+    return response;
+  }
+
+  // Routes tagged responses to a typed handler per response type.
+  // Responses without a handler are not parsed.
+  class Router {
+   public:
+    void OnLookupDone(std::function<void(const ::rpcgentest::LookupDone&)> handler) {
+      lookup_done_handler_ = std::move(handler);
+    }
+    void OnLookupProgress(std::function<void(const ::rpcgentest::LookupProgress&)> handler) {
+      lookup_progress_handler_ = std::move(handler);
+    }
+
+    // Parse the response identified by tag and pass it to its
+    // handler. Returns false if tag is unknown or the response does
+    // not parse.
+    bool Route(Tag tag, const void* data, size_t size,
+               ::google::protobuf::Arena* arena = NULL) const {
+      switch (tag) {
+        case Tag::kLookupDone:
+          return Route(lookup_done_handler_, data, size, arena);
+        case Tag::kLookupProgress:
+          return Route(lookup_progress_handler_, data, size, arena);
+      }
+      return false;
+    }
+
+   private:
+    template <class Response>
+    static bool Route(const std::function<void(const Response&)>& handler,
+                      const void* data, size_t size, ::google::protobuf::Arena* arena) {
+      if (!handler) {
+        return true;
+      }
+      if (size > static_cast<size_t>(INT_MAX)) {
+        return false;
+      }
+      Response* response = ::google::protobuf::Arena::CreateMessage<Response>(arena);
+      std::unique_ptr<Response> owned_response(arena == NULL ? response : NULL);
+      if (!response->ParseFromArray(data, static_cast<int>(size))) {
+        return false;
+      }
+      handler(*response);
+      return true;
+    }
+
+    std::function<void(const ::rpcgentest::LookupDone&)> lookup_done_handler_;
+    std::function<void(const ::rpcgentest::LookupProgress&)> lookup_progress_handler_;
+  };
+};
+
+class Store {
+ public:
+  // Identifies the methods of Store in declaration order.
+  enum class MethodId : uint32_t {
+    kGet = 0,
+    kFind = 1,
+    kPeek = 2,
+  };
+  static constexpr uint32_t kMethodCount = 3;
+
+  virtual ~Store() {}
+
+  virtual void Get(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) = 0;
+  virtual void Find(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) = 0;
+  virtual void Peek(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::CompletionFunction completion_handler) = 0;
+
+  // Set id to the id of the method called name. Returns false if
+  // Store has no such method.
+  static bool FindMethodId(const char* name, MethodId* id) {
+    struct MethodName {
+      const char* name;
+      MethodId id;
+    };
+    static constexpr MethodName kMethodNames[] = {
+      {"Find", MethodId::kFind},
+      {"Get", MethodId::kGet},
+      {"Peek", MethodId::kPeek},
+    };
+
+    size_t low = 0;
+    size_t high = kMethodCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kMethodNames[middle].name);
+      if (order == 0) {
+        *id = kMethodNames[middle].id;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the request for the method id from the size bytes at data
+  // and call the method. Methods without update responses ignore
+  // update_handler. Returns false if id is unknown, names a
+  // streaming method or the request does not parse.
+  bool Dispatch(MethodId id, const void* data, size_t size,
+                ::dotdashpay::common::UpdateFunction update_handler,
+                ::dotdashpay::common::CompletionFunction completion_handler) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    switch (id) {
+      case MethodId::kGet: {
+        ::rpcgentest::LookupArgs request;
+        if (!request.ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Get(request, std::move(update_handler), std::move(completion_handler));
+        return true;
+      }
+      case MethodId::kFind: {
+        ::rpcgentest::LookupArgs request;
+        if (!request.ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Find(request, std::move(update_handler), std::move(completion_handler));
+        return true;
+      }
+      case MethodId::kPeek: {
+        ::rpcgentest::LookupArgs request;
+        if (!request.ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Peek(request, std::move(completion_handler));
+        return true;
+      }
+    }
+    (void)update_handler;
+    (void)completion_handler;
+    return false;
+  }
+};
+
+// Frames Store requests as [method id][payload length][payload],
+// with the id and length as little-endian 32-bit integers. Frames
+// are written straight into the caller's buffer or stream and
+// decoded in place, so the payload is never copied. Streaming
+// methods cannot be framed.
+class StoreCodec {
+ public:
+  static constexpr size_t kHeaderSize = 8;
+
+  enum class DecodeStatus {
+    kOk,
+    // data does not hold a whole frame yet.
+    kIncomplete,
+    // The frame is for a method Store does not have.
+    kUnknownMethod,
+  };
+
+  // A decoded frame. payload points into the decoded buffer.
+  struct Frame {
+    Store::MethodId id;
+    const void* payload;
+    size_t payload_size;
+    size_t frame_size;
+  };
+
+  // Number of bytes the frame for request takes up.
+  static size_t FrameSize(const ::google::protobuf::MessageLite& request) {
+    return kHeaderSize + request.ByteSizeLong();
+  }
+
+  static size_t EncodeGet(const ::rpcgentest::LookupArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Store::MethodId::kGet, request, buffer, capacity);
+  }
+  static bool EncodeGet(const ::rpcgentest::LookupArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Store::MethodId::kGet, request, output);
+  }
+
+  static size_t EncodeFind(const ::rpcgentest::LookupArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Store::MethodId::kFind, request, buffer, capacity);
+  }
+  static bool EncodeFind(const ::rpcgentest::LookupArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Store::MethodId::kFind, request, output);
+  }
+
+  static size_t EncodePeek(const ::rpcgentest::LookupArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Store::MethodId::kPeek, request, buffer, capacity);
+  }
+  static bool EncodePeek(const ::rpcgentest::LookupArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Store::MethodId::kPeek, request, output);
+  }
+
+  // Serialize request as a frame for id into the capacity bytes at
+  // buffer. The payload size is computed once and reused for the
+  // serialization. Returns the size of the frame, or 0 if it does
+  // not fit.
+  static size_t EncodeFrame(Store::MethodId id, const ::google::protobuf::MessageLite& request,
+                            void* buffer, size_t capacity) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX) || capacity < kHeaderSize + payload_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteHeader(id, payload_size, bytes);
+    request.SerializeWithCachedSizesToArray(bytes + kHeaderSize);
+    return kHeaderSize + payload_size;
+  }
+
+  // Serialize request as a frame for id into output. Returns false
+  // if output fails.
+  static bool EncodeFrame(Store::MethodId id, const ::google::protobuf::MessageLite& request,
+                          ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    uint8_t header[kHeaderSize];
+    WriteHeader(id, payload_size, header);
+    ::google::protobuf::io::CodedOutputStream coded_output(output);
+    coded_output.WriteRaw(header, kHeaderSize);
+    request.SerializeWithCachedSizes(&coded_output);
+    return !coded_output.HadError();
+  }
+
+  // Decode the frame at the start of the size bytes at data into
+  // frame without copying its payload, which can be passed on to
+  // Store::Dispatch.
+  static DecodeStatus DecodeFrame(const void* data, size_t size, Frame* frame) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return DecodeStatus::kIncomplete;
+    }
+    const uint32_t id = ReadLittleEndian32(bytes);
+    const size_t payload_size = ReadLittleEndian32(bytes + 4);
+    if (size - kHeaderSize < payload_size) {
+      return DecodeStatus::kIncomplete;
+    }
+    if (id >= Store::kMethodCount) {
+      return DecodeStatus::kUnknownMethod;
+    }
+    frame->id = static_cast<Store::MethodId>(id);
+    frame->payload = bytes + kHeaderSize;
+    frame->payload_size = payload_size;
+    frame->frame_size = kHeaderSize + payload_size;
+    return DecodeStatus::kOk;
+  }
+
+ private:
+  static void WriteHeader(Store::MethodId id, size_t payload_size, uint8_t* header) {
+    WriteLittleEndian32(static_cast<uint32_t>(id), header);
+    WriteLittleEndian32(static_cast<uint32_t>(payload_size), header + 4);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+};
+
+// Collects several Store calls and sends them as one frame:
+// [call count] followed by [call id][method id][length][payload]
+// for every call, all little-endian 32-bit integers. Call ids are
+// the position of the call in the batch; responses are routed
+// back to each call's handlers by id. Streaming methods cannot be
+// batched.
+class StoreBatch {
+ public:
+  static constexpr size_t kHeaderSize = 4;
+  static constexpr size_t kCallHeaderSize = 12;
+
+  // A call decoded from a batch frame. payload points into the
+  // decoded buffer.
+  struct DecodedCall {
+    uint32_t call_id;
+    Store::MethodId id;
+    const void* payload;
+    size_t payload_size;
+  };
+
+  uint32_t Get(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler,
+                    ::dotdashpay::common::CompletionFunction completion_handler) {
+    return Add(Store::MethodId::kGet, request, std::move(update_handler),
+               std::move(completion_handler));
+  }
+
+  uint32_t Find(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler,
+                    ::dotdashpay::common::CompletionFunction completion_handler) {
+    return Add(Store::MethodId::kFind, request, std::move(update_handler),
+               std::move(completion_handler));
+  }
+
+  uint32_t Peek(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::CompletionFunction completion_handler) {
+    return Add(Store::MethodId::kPeek, request, ::dotdashpay::common::UpdateFunction(),
+               std::move(completion_handler));
+  }
+
+  size_t size() const { return calls_.size(); }
+
+  // Number of bytes Encode writes.
+  size_t FrameSize() const {
+    size_t frame_size = kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      frame_size += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Serialize every call into the capacity bytes at buffer. Returns
+  // the size of the frame, or 0 if it does not fit.
+  size_t Encode(void* buffer, size_t capacity) const {
+    const size_t frame_size = FrameSize();
+    if (capacity < frame_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteLittleEndian32(static_cast<uint32_t>(calls_.size()), bytes);
+    bytes += kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      WriteLittleEndian32(static_cast<uint32_t>(i), bytes);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].id), bytes + 4);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].payload.size()), bytes + 8);
+      memcpy(bytes + kCallHeaderSize, calls_[i].payload.data(), calls_[i].payload.size());
+      bytes += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Pass an update response for call_id to its update handler.
+  // Returns false if there is no such call or it has no update
+  // handler.
+  bool Update(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].update_handler) {
+      return false;
+    }
+    calls_[call_id].update_handler(response);
+    return true;
+  }
+
+  // Pass the completion response for call_id to its completion
+  // handler. Returns false if there is no such call or it has
+  // already completed.
+  bool Complete(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].completion_handler) {
+      return false;
+    }
+    ::dotdashpay::common::CompletionFunction completion_handler(std::move(calls_[call_id].completion_handler));
+    calls_[call_id].completion_handler = nullptr;
+    calls_[call_id].update_handler = nullptr;
+    completion_handler(response);
+    return true;
+  }
+
+  // Decode the batch frame in the size bytes at data into calls,
+  // without copying the payloads, so each call can be passed on to
+  // Store::Dispatch. Returns false if the frame is truncated or
+  // names a method Store does not have.
+  static bool Decode(const void* data, size_t size, std::vector<DecodedCall>* calls) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return false;
+    }
+    const uint32_t call_count = ReadLittleEndian32(bytes);
+    bytes += kHeaderSize;
+    size -= kHeaderSize;
+    for (uint32_t i = 0; i < call_count; ++i) {
+      if (size < kCallHeaderSize) {
+        return false;
+      }
+      DecodedCall call;
+      call.call_id = ReadLittleEndian32(bytes);
+      const uint32_t id = ReadLittleEndian32(bytes + 4);
+      call.payload_size = ReadLittleEndian32(bytes + 8);
+      if (id >= Store::kMethodCount || size - kCallHeaderSize < call.payload_size) {
+        return false;
+      }
+      call.id = static_cast<Store::MethodId>(id);
+      call.payload = bytes + kCallHeaderSize;
+      calls->push_back(call);
+      bytes += kCallHeaderSize + call.payload_size;
+      size -= kCallHeaderSize + call.payload_size;
+    }
+    return true;
+  }
+
+ private:
+  struct Call {
+    Store::MethodId id;
+    std::string payload;
+    ::dotdashpay::common::UpdateFunction update_handler;
+    ::dotdashpay::common::CompletionFunction completion_handler;
+  };
+
+  uint32_t Add(Store::MethodId id, const ::google::protobuf::MessageLite& request,
+               ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) {
+    calls_.push_back(Call());
+    Call& call = calls_.back();
+    call.id = id;
+    request.SerializeToString(&call.payload);
+    call.update_handler = std::move(update_handler);
+    call.completion_handler = std::move(completion_handler);
+    return static_cast<uint32_t>(calls_.size() - 1);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  std::vector<Call> calls_;
+};
+
+// A Store that completes calls to its cacheable methods from
+// the completion responses of earlier identical requests, while
+// they are younger than the method's cache_ttl_ms, and forwards
+// every other call to service. Calls completed from the cache get
+// no update responses. At most capacity responses are cached per
+// method.
+class CachingStore : public Store {
+ public:
+  explicit CachingStore(Store* service, size_t capacity = 64)
+      : service_(service),
+        get_cache_(capacity, std::chrono::milliseconds(60000)),
+        peek_cache_(capacity, std::chrono::milliseconds(60000)) {}
+
+  virtual void Get(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) {
+    std::string key = ::dotdashpay::ddprpc::RequestKey(request);
+    std::shared_ptr<const ::google::protobuf::Message> response = get_cache_.Find(key);
+    if (response) {
+      completion_handler(*response);
+      return;
+    }
+    std::shared_ptr<PendingCall> call(
+        new PendingCall(&get_cache_, std::move(key), std::move(completion_handler)));
+    service_->Get(request, std::move(update_handler), [call](const ::google::protobuf::Message& completion) {
+      call->Complete(completion);
+    });
+  }
+
+  virtual void Find(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) {
+    service_->Find(request, std::move(update_handler), std::move(completion_handler));
+  }
+
+  virtual void Peek(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::CompletionFunction completion_handler) {
+    std::string key = ::dotdashpay::ddprpc::RequestKey(request);
+    std::shared_ptr<const ::google::protobuf::Message> response = peek_cache_.Find(key);
+    if (response) {
+      completion_handler(*response);
+      return;
+    }
+    std::shared_ptr<PendingCall> call(
+        new PendingCall(&peek_cache_, std::move(key), std::move(completion_handler)));
+    service_->Peek(request, [call](const ::google::protobuf::Message& completion) {
+      call->Complete(completion);
+    });
+  }
+
+  // Drop every cached response.
+  void Clear() {
+    get_cache_.Clear();
+    peek_cache_.Clear();
+  }
+
+ private:
+  // A forwarded call to a cacheable method, which caches its
+  // completion response before passing it on.
+  struct PendingCall {
+    PendingCall(::dotdashpay::ddprpc::ResponseCache* cache, std::string key,
+                ::dotdashpay::common::CompletionFunction completion_handler)
+        : cache(cache), key(std::move(key)), completion_handler(std::move(completion_handler)) {}
+
+    void Complete(const ::google::protobuf::Message& completion) {
+      cache->Insert(key, completion);
+      completion_handler(completion);
+    }
+
+    ::dotdashpay::ddprpc::ResponseCache* cache;
+    std::string key;
+    ::dotdashpay::common::CompletionFunction completion_handler;
+  };
+
+  Store* service_;
+  ::dotdashpay::ddprpc::ResponseCache get_cache_;
+  ::dotdashpay::ddprpc::ResponseCache peek_cache_;
+};
+
+// A Store that sends a call to one of its idempotent methods
+// only if no byte-identical request is in flight; otherwise the
+// call shares the responses of the pending one, receiving the
+// updates from when it joined on. Every other call is forwarded to
+// service.
+class CoalescingStore : public Store {
+ public:
+  explicit CoalescingStore(Store* service) : service_(service) {}
+
+  virtual void Get(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) {
+    const std::string key = ::dotdashpay::ddprpc::RequestKey(request);
+    if (!get_calls_.Join(key, std::move(update_handler), std::move(completion_handler))) {
+      return;
+    }
+    Calls* calls = &get_calls_;
+    std::shared_ptr<const std::string> shared_key(new std::string(key));
+    service_->Get(request, [calls, shared_key](const ::google::protobuf::Message& update) {
+      calls->Update(*shared_key, update);
+    }, [calls, shared_key](const ::google::protobuf::Message& completion) {
+      calls->Complete(*shared_key, completion);
+    });
+  }
+
+  virtual void Find(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::UpdateFunction update_handler, ::dotdashpay::common::CompletionFunction completion_handler) {
+    const std::string key = ::dotdashpay::ddprpc::RequestKey(request);
+    if (!find_calls_.Join(key, std::move(update_handler), std::move(completion_handler))) {
+      return;
+    }
+    Calls* calls = &find_calls_;
+    std::shared_ptr<const std::string> shared_key(new std::string(key));
+    service_->Find(request, [calls, shared_key](const ::google::protobuf::Message& update) {
+      calls->Update(*shared_key, update);
+    }, [calls, shared_key](const ::google::protobuf::Message& completion) {
+      calls->Complete(*shared_key, completion);
+    });
+  }
+
+  virtual void Peek(const ::rpcgentest::LookupArgs& request, ::dotdashpay::common::CompletionFunction completion_handler) {
+    service_->Peek(request, std::move(completion_handler));
+  }
+
+ private:
+  typedef ::dotdashpay::ddprpc::SingleFlight<::dotdashpay::common::UpdateFunction, ::dotdashpay::common::CompletionFunction> Calls;
+
+  Store* service_;
+  Calls get_calls_;
+  Calls find_calls_;
+};
+
+}  // namespace rpcgentest
+
+
+#endif  // __DOTDASHPAY_caching_2eproto__INCLUDED
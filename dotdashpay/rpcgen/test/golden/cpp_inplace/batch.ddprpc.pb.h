@@ -0,0 +1,754 @@
+// Generated by the ddpRPC protobuf plugin.
+// If you make any local change, they will be lost.
+// source: batch.proto
+#ifndef __DOTDASHPAY_batch_2eproto__INCLUDED
+#define __DOTDASHPAY_batch_2eproto__INCLUDED
+
+#define DDP_API_MAJOR_VERSION 1
+#define DDP_API_MINOR_VERSION 0
+
+#include "batch.pb.h"
+
+#include <dotdashpay/common/function.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/message_lite.h>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+#ifndef __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+#define __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+
+#include <new>
+#include <type_traits>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// A move-only callable that stores its target in an inline buffer of
+// Capacity bytes instead of on the heap. Targets that do not fit are
+// rejected at compile time.
+template <class Signature, size_t Capacity = 4 * sizeof(void*)>
+class InplaceFunction;
+
+template <class R, class... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+ public:
+  InplaceFunction() : invoke_(NULL), manage_(NULL) {}
+  InplaceFunction(std::nullptr_t) : invoke_(NULL), manage_(NULL) {}
+
+  template <class F, class = typename std::enable_if<
+                        !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+  InplaceFunction(F&& target) {
+    typedef typename std::decay<F>::type Target;
+    static_assert(sizeof(Target) <= Capacity, "the handler does not fit in an InplaceFunction");
+    static_assert(alignof(Target) <= alignof(Storage), "the handler is over-aligned");
+    new (&storage_) Target(std::forward<F>(target));
+    invoke_ = &Invoke<Target>;
+    manage_ = &Manage<Target>;
+  }
+
+  InplaceFunction(InplaceFunction&& other) : invoke_(NULL), manage_(NULL) {
+    MoveFrom(&other);
+  }
+
+  InplaceFunction& operator=(InplaceFunction&& other) {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  InplaceFunction(const InplaceFunction&) = delete;
+  InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+  ~InplaceFunction() { Reset(); }
+
+  explicit operator bool() const { return invoke_ != NULL; }
+
+  R operator()(Args... args) const {
+    return invoke_(&storage_, std::forward<Args>(args)...);
+  }
+
+ private:
+  typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+  template <class Target>
+  static R Invoke(void* storage, Args&&... args) {
+    return (*static_cast<Target*>(storage))(std::forward<Args>(args)...);
+  }
+
+  // Move the target at source to destination, unless destination is
+  // NULL, and destroy the one at source.
+  template <class Target>
+  static void Manage(void* destination, void* source) {
+    Target* target = static_cast<Target*>(source);
+    if (destination != NULL) {
+      new (destination) Target(std::move(*target));
+    }
+    target->~Target();
+  }
+
+  void MoveFrom(InplaceFunction* other) {
+    if (other->manage_ != NULL) {
+      other->manage_(&storage_, &other->storage_);
+    }
+    invoke_ = other->invoke_;
+    manage_ = other->manage_;
+    other->invoke_ = NULL;
+    other->manage_ = NULL;
+  }
+
+  void Reset() {
+    if (manage_ != NULL) {
+      manage_(NULL, &storage_);
+    }
+    invoke_ = NULL;
+    manage_ = NULL;
+  }
+
+  R (*invoke_)(void*, Args&&...);
+  void (*manage_)(void*, void*);
+  mutable Storage storage_;
+};
+
+typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceUpdateFunction;
+typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceCompletionFunction;
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+
+
+#ifndef __DOTDASHPAY_DDPRPC_STREAMS__
+#define __DOTDASHPAY_DDPRPC_STREAMS__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// The receiving end of a stream of messages.
+template <class T>
+class StreamReader {
+ public:
+  virtual ~StreamReader() {}
+
+  // Block until a message is available and move it into message.
+  // Returns false once the stream is closed and drained.
+  virtual bool Read(T* message) = 0;
+
+  // Block until a message is available, then move up to max_count
+  // queued messages onto the end of messages. Returns the number of
+  // messages read, which is 0 once the stream is closed and drained.
+  virtual size_t ReadBatch(std::vector<T>* messages, size_t max_count) = 0;
+};
+
+// The sending end of a stream of messages.
+template <class T>
+class StreamWriter {
+ public:
+  virtual ~StreamWriter() {}
+
+  // Queue message, blocking while the stream is full. Returns false
+  // if the stream is closed.
+  virtual bool Write(T&& message) = 0;
+
+  bool Write(const T& message) {
+    T copy(message);
+    return Write(std::move(copy));
+  }
+
+  // Move the count messages at messages into the stream, blocking
+  // whenever it is full. Returns the number of messages written,
+  // which is less than count only if the stream is closed.
+  virtual size_t WriteBatch(T* messages, size_t count) = 0;
+
+  // Signal that no more messages will be written.
+  virtual void Close() = 0;
+};
+
+// A stream that queues at most capacity messages between its writer
+// and its reader. Writers block while the queue is full, so a
+// producer cannot outrun its consumer by more than capacity
+// messages. Safe to use from one writer and one reader thread.
+template <class T>
+class BoundedStream : public StreamReader<T>, public StreamWriter<T> {
+ public:
+  explicit BoundedStream(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity), closed_(false) {}
+
+  using StreamWriter<T>::Write;
+
+  virtual bool Write(T&& message) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    queue_.push_back(std::move(message));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  virtual size_t WriteBatch(T* messages, size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t written = 0;
+    while (written < count) {
+      not_full_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });
+      if (closed_) {
+        break;
+      }
+      while (written < count && queue_.size() < capacity_) {
+        queue_.push_back(std::move(messages[written++]));
+      }
+      not_empty_.notify_one();
+    }
+    return written;
+  }
+
+  virtual void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  virtual bool Read(T* message) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return false;
+    }
+    *message = std::move(queue_.front());
+    queue_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  virtual size_t ReadBatch(std::vector<T>* messages, size_t max_count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+    size_t read = 0;
+    while (read < max_count && !queue_.empty()) {
+      messages->push_back(std::move(queue_.front()));
+      queue_.pop_front();
+      ++read;
+    }
+    not_full_.notify_one();
+    return read;
+  }
+
+ private:
+  const size_t capacity_;
+  bool closed_;
+  std::deque<T> queue_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_STREAMS__
+
+
+namespace rpcgentest {
+
+// Registry of every update and completion response of the services
+// in batch.proto.
+struct BatchResponses {
+  // Tags are assigned in name order, so they are only stable between
+  // peers built from the same API version.
+  enum class Tag : uint32_t {
+    kPopDone = 0,
+    kPushDone = 1,
+  };
+  static constexpr uint32_t kTagCount = 2;
+
+  // Set tag to the tag of the response message called name. Returns
+  // false if no service in the file uses such a response.
+  static bool FindTag(const char* name, Tag* tag) {
+    struct ResponseName {
+      const char* name;
+      Tag tag;
+    };
+    static constexpr ResponseName kResponseNames[] = {
+      {"PopDone", Tag::kPopDone},
+      {"PushDone", Tag::kPushDone},
+    };
+
+    size_t low = 0;
+    size_t high = kTagCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kResponseNames[middle].name);
+      if (order == 0) {
+        *tag = kResponseNames[middle].tag;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the size bytes at data as the response identified by tag.
+  // The response is allocated on arena, or on the heap and owned by
+  // the caller when arena is NULL. Returns NULL if tag is unknown or
+  // the response does not parse.
+  static ::google::protobuf::Message* ParseResponse(Tag tag, const void* data, size_t size,
+                                                    ::google::protobuf::Arena* arena) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return NULL;
+    }
+    ::google::protobuf::Message* response = NULL;
+    switch (tag) {
+      case Tag::kPopDone:
+        response = ::google::protobuf::Arena::CreateMessage<::rpcgentest::PopDone>(arena);
+        break;
+      case Tag::kPushDone:
+        response = ::google::protobuf::Arena::CreateMessage<::rpcgentest::PushDone>(arena);
+        break;
+    }
+    if (response != NULL && !response->ParseFromArray(data, static_cast<int>(size))) {
+      if (arena == NULL) {
+        delete response;
+      }
+      return NULL;
+    }
+    return response;
+  }
+
+  // Routes tagged responses to a typed handler per response type.
+  // Responses without a handler are not parsed.
+  class Router {
+   public:
+    void OnPopDone(std::function<void(const ::rpcgentest::PopDone&)> handler) {
+      pop_done_handler_ = std::move(handler);
+    }
+    void OnPushDone(std::function<void(const ::rpcgentest::PushDone&)> handler) {
+      push_done_handler_ = std::move(handler);
+    }
+
+    // Parse the response identified by tag and pass it to its
+    // handler. Returns false if tag is unknown or the response does
+    // not parse.
+    bool Route(Tag tag, const void* data, size_t size,
+               ::google::protobuf::Arena* arena = NULL) const {
+      switch (tag) {
+        case Tag::kPopDone:
+          return Route(pop_done_handler_, data, size, arena);
+        case Tag::kPushDone:
+          return Route(push_done_handler_, data, size, arena);
+      }
+      return false;
+    }
+
+   private:
+    template <class Response>
+    static bool Route(const std::function<void(const Response&)>& handler,
+                      const void* data, size_t size, ::google::protobuf::Arena* arena) {
+      if (!handler) {
+        return true;
+      }
+      if (size > static_cast<size_t>(INT_MAX)) {
+        return false;
+      }
+      Response* response = ::google::protobuf::Arena::CreateMessage<Response>(arena);
+      std::unique_ptr<Response> owned_response(arena == NULL ? response : NULL);
+      if (!response->ParseFromArray(data, static_cast<int>(size))) {
+        return false;
+      }
+      handler(*response);
+      return true;
+    }
+
+    std::function<void(const ::rpcgentest::PopDone&)> pop_done_handler_;
+    std::function<void(const ::rpcgentest::PushDone&)> push_done_handler_;
+  };
+};
+
+class Queue {
+ public:
+  // Identifies the methods of Queue in declaration order.
+  enum class MethodId : uint32_t {
+    kPush = 0,
+    kWatch = 1,
+    kPop = 2,
+  };
+  static constexpr uint32_t kMethodCount = 3;
+
+  virtual ~Queue() {}
+
+  virtual void Push(const ::rpcgentest::PushArgs& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) = 0;
+  virtual void Push(::rpcgentest::PushArgs&& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    Push(static_cast<const ::rpcgentest::PushArgs&>(request), std::move(completion_handler));
+  }
+  virtual void Watch(::dotdashpay::ddprpc::StreamReader<::rpcgentest::WatchArgs>* requests, ::dotdashpay::ddprpc::StreamWriter<::rpcgentest::PushDone>* responses, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) = 0;
+  virtual void Pop(const ::rpcgentest::PopArgs& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) = 0;
+  virtual void Pop(::rpcgentest::PopArgs&& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    Pop(static_cast<const ::rpcgentest::PopArgs&>(request), std::move(completion_handler));
+  }
+
+  // Set id to the id of the method called name. Returns false if
+  // Queue has no such method.
+  static bool FindMethodId(const char* name, MethodId* id) {
+    struct MethodName {
+      const char* name;
+      MethodId id;
+    };
+    static constexpr MethodName kMethodNames[] = {
+      {"Pop", MethodId::kPop},
+      {"Push", MethodId::kPush},
+      {"Watch", MethodId::kWatch},
+    };
+
+    size_t low = 0;
+    size_t high = kMethodCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kMethodNames[middle].name);
+      if (order == 0) {
+        *id = kMethodNames[middle].id;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the request for the method id from the size bytes at data
+  // and call the method. Methods without update responses ignore
+  // update_handler. Returns false if id is unknown, names a
+  // streaming method or the request does not parse.
+  bool Dispatch(MethodId id, const void* data, size_t size,
+                ::dotdashpay::ddprpc::InplaceUpdateFunction&& update_handler,
+                ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    switch (id) {
+      case MethodId::kPush: {
+        ::rpcgentest::PushArgs request;
+        if (!request.ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Push(std::move(request), std::move(completion_handler));
+        return true;
+      }
+      case MethodId::kPop: {
+        ::rpcgentest::PopArgs request;
+        if (!request.ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Pop(std::move(request), std::move(completion_handler));
+        return true;
+      }
+      default:
+        break;
+    }
+    (void)update_handler;
+    (void)completion_handler;
+    return false;
+  }
+};
+
+// Frames Queue requests as [method id][payload length][payload],
+// with the id and length as little-endian 32-bit integers. Frames
+// are written straight into the caller's buffer or stream and
+// decoded in place, so the payload is never copied. Streaming
+// methods cannot be framed.
+class QueueCodec {
+ public:
+  static constexpr size_t kHeaderSize = 8;
+
+  enum class DecodeStatus {
+    kOk,
+    // data does not hold a whole frame yet.
+    kIncomplete,
+    // The frame is for a method Queue does not have.
+    kUnknownMethod,
+  };
+
+  // A decoded frame. payload points into the decoded buffer.
+  struct Frame {
+    Queue::MethodId id;
+    const void* payload;
+    size_t payload_size;
+    size_t frame_size;
+  };
+
+  // Number of bytes the frame for request takes up.
+  static size_t FrameSize(const ::google::protobuf::MessageLite& request) {
+    return kHeaderSize + request.ByteSizeLong();
+  }
+
+  static size_t EncodePush(const ::rpcgentest::PushArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Queue::MethodId::kPush, request, buffer, capacity);
+  }
+  static bool EncodePush(const ::rpcgentest::PushArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Queue::MethodId::kPush, request, output);
+  }
+
+  static size_t EncodePop(const ::rpcgentest::PopArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Queue::MethodId::kPop, request, buffer, capacity);
+  }
+  static bool EncodePop(const ::rpcgentest::PopArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Queue::MethodId::kPop, request, output);
+  }
+
+  // Serialize request as a frame for id into the capacity bytes at
+  // buffer. The payload size is computed once and reused for the
+  // serialization. Returns the size of the frame, or 0 if it does
+  // not fit.
+  static size_t EncodeFrame(Queue::MethodId id, const ::google::protobuf::MessageLite& request,
+                            void* buffer, size_t capacity) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX) || capacity < kHeaderSize + payload_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteHeader(id, payload_size, bytes);
+    request.SerializeWithCachedSizesToArray(bytes + kHeaderSize);
+    return kHeaderSize + payload_size;
+  }
+
+  // Serialize request as a frame for id into output. Returns false
+  // if output fails.
+  static bool EncodeFrame(Queue::MethodId id, const ::google::protobuf::MessageLite& request,
+                          ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    uint8_t header[kHeaderSize];
+    WriteHeader(id, payload_size, header);
+    ::google::protobuf::io::CodedOutputStream coded_output(output);
+    coded_output.WriteRaw(header, kHeaderSize);
+    request.SerializeWithCachedSizes(&coded_output);
+    return !coded_output.HadError();
+  }
+
+  // Decode the frame at the start of the size bytes at data into
+  // frame without copying its payload, which can be passed on to
+  // Queue::Dispatch.
+  static DecodeStatus DecodeFrame(const void* data, size_t size, Frame* frame) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return DecodeStatus::kIncomplete;
+    }
+    const uint32_t id = ReadLittleEndian32(bytes);
+    const size_t payload_size = ReadLittleEndian32(bytes + 4);
+    if (size - kHeaderSize < payload_size) {
+      return DecodeStatus::kIncomplete;
+    }
+    if (id >= Queue::kMethodCount) {
+      return DecodeStatus::kUnknownMethod;
+    }
+    frame->id = static_cast<Queue::MethodId>(id);
+    frame->payload = bytes + kHeaderSize;
+    frame->payload_size = payload_size;
+    frame->frame_size = kHeaderSize + payload_size;
+    return DecodeStatus::kOk;
+  }
+
+ private:
+  static void WriteHeader(Queue::MethodId id, size_t payload_size, uint8_t* header) {
+    WriteLittleEndian32(static_cast<uint32_t>(id), header);
+    WriteLittleEndian32(static_cast<uint32_t>(payload_size), header + 4);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+};
+
+// Collects several Queue calls and sends them as one frame:
+// [call count] followed by [call id][method id][length][payload]
+// for every call, all little-endian 32-bit integers. Call ids are
+// the position of the call in the batch; responses are routed
+// back to each call's handlers by id. Streaming methods cannot be
+// batched.
+class QueueBatch {
+ public:
+  static constexpr size_t kHeaderSize = 4;
+  static constexpr size_t kCallHeaderSize = 12;
+
+  // A call decoded from a batch frame. payload points into the
+  // decoded buffer.
+  struct DecodedCall {
+    uint32_t call_id;
+    Queue::MethodId id;
+    const void* payload;
+    size_t payload_size;
+  };
+
+  uint32_t Push(const ::rpcgentest::PushArgs& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    return Add(Queue::MethodId::kPush, request, ::dotdashpay::ddprpc::InplaceUpdateFunction(),
+               std::move(completion_handler));
+  }
+
+  uint32_t Pop(const ::rpcgentest::PopArgs& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    return Add(Queue::MethodId::kPop, request, ::dotdashpay::ddprpc::InplaceUpdateFunction(),
+               std::move(completion_handler));
+  }
+
+  size_t size() const { return calls_.size(); }
+
+  // Number of bytes Encode writes.
+  size_t FrameSize() const {
+    size_t frame_size = kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      frame_size += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Serialize every call into the capacity bytes at buffer. Returns
+  // the size of the frame, or 0 if it does not fit.
+  size_t Encode(void* buffer, size_t capacity) const {
+    const size_t frame_size = FrameSize();
+    if (capacity < frame_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteLittleEndian32(static_cast<uint32_t>(calls_.size()), bytes);
+    bytes += kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      WriteLittleEndian32(static_cast<uint32_t>(i), bytes);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].id), bytes + 4);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].payload.size()), bytes + 8);
+      memcpy(bytes + kCallHeaderSize, calls_[i].payload.data(), calls_[i].payload.size());
+      bytes += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Pass an update response for call_id to its update handler.
+  // Returns false if there is no such call or it has no update
+  // handler.
+  bool Update(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].update_handler) {
+      return false;
+    }
+    calls_[call_id].update_handler(response);
+    return true;
+  }
+
+  // Pass the completion response for call_id to its completion
+  // handler. Returns false if there is no such call or it has
+  // already completed.
+  bool Complete(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].completion_handler) {
+      return false;
+    }
+    ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler(std::move(calls_[call_id].completion_handler));
+    calls_[call_id].completion_handler = nullptr;
+    calls_[call_id].update_handler = nullptr;
+    completion_handler(response);
+    return true;
+  }
+
+  // Decode the batch frame in the size bytes at data into calls,
+  // without copying the payloads, so each call can be passed on to
+  // Queue::Dispatch. Returns false if the frame is truncated or
+  // names a method Queue does not have.
+  static bool Decode(const void* data, size_t size, std::vector<DecodedCall>* calls) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return false;
+    }
+    const uint32_t call_count = ReadLittleEndian32(bytes);
+    bytes += kHeaderSize;
+    size -= kHeaderSize;
+    for (uint32_t i = 0; i < call_count; ++i) {
+      if (size < kCallHeaderSize) {
+        return false;
+      }
+      DecodedCall call;
+      call.call_id = ReadLittleEndian32(bytes);
+      const uint32_t id = ReadLittleEndian32(bytes + 4);
+      call.payload_size = ReadLittleEndian32(bytes + 8);
+      if (id >= Queue::kMethodCount || size - kCallHeaderSize < call.payload_size) {
+        return false;
+      }
+      call.id = static_cast<Queue::MethodId>(id);
+      call.payload = bytes + kCallHeaderSize;
+      calls->push_back(call);
+      bytes += kCallHeaderSize + call.payload_size;
+      size -= kCallHeaderSize + call.payload_size;
+    }
+    return true;
+  }
+
+ private:
+  struct Call {
+    Queue::MethodId id;
+    std::string payload;
+    ::dotdashpay::ddprpc::InplaceUpdateFunction update_handler;
+    ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler;
+  };
+
+  uint32_t Add(Queue::MethodId id, const ::google::protobuf::MessageLite& request,
+               ::dotdashpay::ddprpc::InplaceUpdateFunction update_handler, ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler) {
+    calls_.push_back(Call());
+    Call& call = calls_.back();
+    call.id = id;
+    request.SerializeToString(&call.payload);
+    call.update_handler = std::move(update_handler);
+    call.completion_handler = std::move(completion_handler);
+    return static_cast<uint32_t>(calls_.size() - 1);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  std::vector<Call> calls_;
+};
+
+}  // namespace rpcgentest
+
+
+#endif  // __DOTDASHPAY_batch_2eproto__INCLUDED
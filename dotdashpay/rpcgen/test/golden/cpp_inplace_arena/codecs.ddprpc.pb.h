@@ -0,0 +1,579 @@
+// Generated by the ddpRPC protobuf plugin.
+// If you make any local change, they will be lost.
+// source: codecs.proto
+#ifndef __DOTDASHPAY_codecs_2eproto__INCLUDED
+#define __DOTDASHPAY_codecs_2eproto__INCLUDED
+
+#define DDP_API_MAJOR_VERSION 1
+#define DDP_API_MINOR_VERSION 0
+
+#include "codecs.pb.h"
+
+#include <dotdashpay/common/function.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/message_lite.h>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+#ifndef __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+#define __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+
+#include <new>
+#include <type_traits>
+
+namespace dotdashpay {
+namespace ddprpc {
+
+// A move-only callable that stores its target in an inline buffer of
+// Capacity bytes instead of on the heap. Targets that do not fit are
+// rejected at compile time.
+template <class Signature, size_t Capacity = 4 * sizeof(void*)>
+class InplaceFunction;
+
+template <class R, class... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+ public:
+  InplaceFunction() : invoke_(NULL), manage_(NULL) {}
+  InplaceFunction(std::nullptr_t) : invoke_(NULL), manage_(NULL) {}
+
+  template <class F, class = typename std::enable_if<
+                        !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+  InplaceFunction(F&& target) {
+    typedef typename std::decay<F>::type Target;
+    static_assert(sizeof(Target) <= Capacity, "the handler does not fit in an InplaceFunction");
+    static_assert(alignof(Target) <= alignof(Storage), "the handler is over-aligned");
+    new (&storage_) Target(std::forward<F>(target));
+    invoke_ = &Invoke<Target>;
+    manage_ = &Manage<Target>;
+  }
+
+  InplaceFunction(InplaceFunction&& other) : invoke_(NULL), manage_(NULL) {
+    MoveFrom(&other);
+  }
+
+  InplaceFunction& operator=(InplaceFunction&& other) {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  InplaceFunction(const InplaceFunction&) = delete;
+  InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+  ~InplaceFunction() { Reset(); }
+
+  explicit operator bool() const { return invoke_ != NULL; }
+
+  R operator()(Args... args) const {
+    return invoke_(&storage_, std::forward<Args>(args)...);
+  }
+
+ private:
+  typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+  template <class Target>
+  static R Invoke(void* storage, Args&&... args) {
+    return (*static_cast<Target*>(storage))(std::forward<Args>(args)...);
+  }
+
+  // Move the target at source to destination, unless destination is
+  // NULL, and destroy the one at source.
+  template <class Target>
+  static void Manage(void* destination, void* source) {
+    Target* target = static_cast<Target*>(source);
+    if (destination != NULL) {
+      new (destination) Target(std::move(*target));
+    }
+    target->~Target();
+  }
+
+  void MoveFrom(InplaceFunction* other) {
+    if (other->manage_ != NULL) {
+      other->manage_(&storage_, &other->storage_);
+    }
+    invoke_ = other->invoke_;
+    manage_ = other->manage_;
+    other->invoke_ = NULL;
+    other->manage_ = NULL;
+  }
+
+  void Reset() {
+    if (manage_ != NULL) {
+      manage_(NULL, &storage_);
+    }
+    invoke_ = NULL;
+    manage_ = NULL;
+  }
+
+  R (*invoke_)(void*, Args&&...);
+  void (*manage_)(void*, void*);
+  mutable Storage storage_;
+};
+
+typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceUpdateFunction;
+typedef InplaceFunction<void(const ::google::protobuf::Message&)> InplaceCompletionFunction;
+
+}  // namespace ddprpc
+}  // namespace dotdashpay
+
+#endif  // __DOTDASHPAY_DDPRPC_INPLACE_FUNCTION__
+
+
+namespace rpcgentest {
+
+// Registry of every update and completion response of the services
+// in codecs.proto.
+struct CodecsResponses {
+  // Tags are assigned in name order, so they are only stable between
+  // peers built from the same API version.
+  enum class Tag : uint32_t {
+    kPaintDone = 0,
+  };
+  static constexpr uint32_t kTagCount = 1;
+
+  // Set tag to the tag of the response message called name. Returns
+  // false if no service in the file uses such a response.
+  static bool FindTag(const char* name, Tag* tag) {
+    struct ResponseName {
+      const char* name;
+      Tag tag;
+    };
+    static constexpr ResponseName kResponseNames[] = {
+      {"PaintDone", Tag::kPaintDone},
+    };
+
+    size_t low = 0;
+    size_t high = kTagCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kResponseNames[middle].name);
+      if (order == 0) {
+        *tag = kResponseNames[middle].tag;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the size bytes at data as the response identified by tag.
+  // The response is allocated on arena, or on the heap and owned by
+  // the caller when arena is NULL. Returns NULL if tag is unknown or
+  // the response does not parse.
+  static ::google::protobuf::Message* ParseResponse(Tag tag, const void* data, size_t size,
+                                                    ::google::protobuf::Arena* arena) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return NULL;
+    }
+    ::google::protobuf::Message* response = NULL;
+    switch (tag) {
+      case Tag::kPaintDone:
+        response = ::google::protobuf::Arena::CreateMessage<::rpcgentest::PaintDone>(arena);
+        break;
+    }
+    if (response != NULL && !response->ParseFromArray(data, static_cast<int>(size))) {
+      if (arena == NULL) {
+        delete response;
+      }
+      return NULL;
+    }
+    return response;
+  }
+
+  // Routes tagged responses to a typed handler per response type.
+  // Responses without a handler are not parsed.
+  class Router {
+   public:
+    void OnPaintDone(std::function<void(const ::rpcgentest::PaintDone&)> handler) {
+      paint_done_handler_ = std::move(handler);
+    }
+
+    // Parse the response identified by tag and pass it to its
+    // handler. Returns false if tag is unknown or the response does
+    // not parse.
+    bool Route(Tag tag, const void* data, size_t size,
+               ::google::protobuf::Arena* arena = NULL) const {
+      switch (tag) {
+        case Tag::kPaintDone:
+          return Route(paint_done_handler_, data, size, arena);
+      }
+      return false;
+    }
+
+   private:
+    template <class Response>
+    static bool Route(const std::function<void(const Response&)>& handler,
+                      const void* data, size_t size, ::google::protobuf::Arena* arena) {
+      if (!handler) {
+        return true;
+      }
+      if (size > static_cast<size_t>(INT_MAX)) {
+        return false;
+      }
+      Response* response = ::google::protobuf::Arena::CreateMessage<Response>(arena);
+      std::unique_ptr<Response> owned_response(arena == NULL ? response : NULL);
+      if (!response->ParseFromArray(data, static_cast<int>(size))) {
+        return false;
+      }
+      handler(*response);
+      return true;
+    }
+
+    std::function<void(const ::rpcgentest::PaintDone&)> paint_done_handler_;
+  };
+};
+
+class Canvas {
+ public:
+  // Identifies the methods of Canvas in declaration order.
+  enum class MethodId : uint32_t {
+    kPaint = 0,
+  };
+  static constexpr uint32_t kMethodCount = 1;
+
+  virtual ~Canvas() {}
+
+  virtual void Paint(const ::rpcgentest::PaintArgs& request, ::google::protobuf::Arena* arena, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) = 0;
+  virtual void Paint(::rpcgentest::PaintArgs&& request, ::google::protobuf::Arena* arena, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    Paint(static_cast<const ::rpcgentest::PaintArgs&>(request), arena, std::move(completion_handler));
+  }
+
+  // Set id to the id of the method called name. Returns false if
+  // Canvas has no such method.
+  static bool FindMethodId(const char* name, MethodId* id) {
+    struct MethodName {
+      const char* name;
+      MethodId id;
+    };
+    static constexpr MethodName kMethodNames[] = {
+      {"Paint", MethodId::kPaint},
+    };
+
+    size_t low = 0;
+    size_t high = kMethodCount;
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      const int order = strcmp(name, kMethodNames[middle].name);
+      if (order == 0) {
+        *id = kMethodNames[middle].id;
+        return true;
+      }
+      if (order < 0) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return false;
+  }
+
+  // Parse the request for the method id from the size bytes at data
+  // and call the method. Methods without update responses ignore
+  // update_handler. Returns false if id is unknown, names a
+  // streaming method or the request does not parse.
+  // The request is allocated on arena, or on the heap for the
+  // duration of the call when arena is NULL.
+  bool Dispatch(MethodId id, const void* data, size_t size,
+                ::google::protobuf::Arena* arena,
+                ::dotdashpay::ddprpc::InplaceUpdateFunction&& update_handler,
+                ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    if (size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    switch (id) {
+      case MethodId::kPaint: {
+        ::rpcgentest::PaintArgs* request = ::google::protobuf::Arena::CreateMessage<::rpcgentest::PaintArgs>(arena);
+        std::unique_ptr<::rpcgentest::PaintArgs> owned_request(arena == NULL ? request : NULL);
+        if (!request->ParseFromArray(data, static_cast<int>(size))) {
+          return false;
+        }
+        Paint(*request, arena, std::move(completion_handler));
+        return true;
+      }
+    }
+    (void)update_handler;
+    (void)completion_handler;
+    return false;
+  }
+};
+
+// Frames Canvas requests as [method id][payload length][payload],
+// with the id and length as little-endian 32-bit integers. Frames
+// are written straight into the caller's buffer or stream and
+// decoded in place, so the payload is never copied. Streaming
+// methods cannot be framed.
+class CanvasCodec {
+ public:
+  static constexpr size_t kHeaderSize = 8;
+
+  enum class DecodeStatus {
+    kOk,
+    // data does not hold a whole frame yet.
+    kIncomplete,
+    // The frame is for a method Canvas does not have.
+    kUnknownMethod,
+  };
+
+  // A decoded frame. payload points into the decoded buffer.
+  struct Frame {
+    Canvas::MethodId id;
+    const void* payload;
+    size_t payload_size;
+    size_t frame_size;
+  };
+
+  // Number of bytes the frame for request takes up.
+  static size_t FrameSize(const ::google::protobuf::MessageLite& request) {
+    return kHeaderSize + request.ByteSizeLong();
+  }
+
+  static size_t EncodePaint(const ::rpcgentest::PaintArgs& request, void* buffer, size_t capacity) {
+    return EncodeFrame(Canvas::MethodId::kPaint, request, buffer, capacity);
+  }
+  static bool EncodePaint(const ::rpcgentest::PaintArgs& request,
+                             ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    return EncodeFrame(Canvas::MethodId::kPaint, request, output);
+  }
+
+  // Serialize request as a frame for id into the capacity bytes at
+  // buffer. The payload size is computed once and reused for the
+  // serialization. Returns the size of the frame, or 0 if it does
+  // not fit.
+  static size_t EncodeFrame(Canvas::MethodId id, const ::google::protobuf::MessageLite& request,
+                            void* buffer, size_t capacity) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX) || capacity < kHeaderSize + payload_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteHeader(id, payload_size, bytes);
+    request.SerializeWithCachedSizesToArray(bytes + kHeaderSize);
+    return kHeaderSize + payload_size;
+  }
+
+  // Serialize request as a frame for id into output. Returns false
+  // if output fails.
+  static bool EncodeFrame(Canvas::MethodId id, const ::google::protobuf::MessageLite& request,
+                          ::google::protobuf::io::ZeroCopyOutputStream* output) {
+    const size_t payload_size = request.ByteSizeLong();
+    if (payload_size > static_cast<size_t>(INT_MAX)) {
+      return false;
+    }
+    uint8_t header[kHeaderSize];
+    WriteHeader(id, payload_size, header);
+    ::google::protobuf::io::CodedOutputStream coded_output(output);
+    coded_output.WriteRaw(header, kHeaderSize);
+    request.SerializeWithCachedSizes(&coded_output);
+    return !coded_output.HadError();
+  }
+
+  // Decode the frame at the start of the size bytes at data into
+  // frame without copying its payload, which can be passed on to
+  // Canvas::Dispatch.
+  static DecodeStatus DecodeFrame(const void* data, size_t size, Frame* frame) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return DecodeStatus::kIncomplete;
+    }
+    const uint32_t id = ReadLittleEndian32(bytes);
+    const size_t payload_size = ReadLittleEndian32(bytes + 4);
+    if (size - kHeaderSize < payload_size) {
+      return DecodeStatus::kIncomplete;
+    }
+    if (id >= Canvas::kMethodCount) {
+      return DecodeStatus::kUnknownMethod;
+    }
+    frame->id = static_cast<Canvas::MethodId>(id);
+    frame->payload = bytes + kHeaderSize;
+    frame->payload_size = payload_size;
+    frame->frame_size = kHeaderSize + payload_size;
+    return DecodeStatus::kOk;
+  }
+
+ private:
+  static void WriteHeader(Canvas::MethodId id, size_t payload_size, uint8_t* header) {
+    WriteLittleEndian32(static_cast<uint32_t>(id), header);
+    WriteLittleEndian32(static_cast<uint32_t>(payload_size), header + 4);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+};
+
+// Collects several Canvas calls and sends them as one frame:
+// [call count] followed by [call id][method id][length][payload]
+// for every call, all little-endian 32-bit integers. Call ids are
+// the position of the call in the batch; responses are routed
+// back to each call's handlers by id. Streaming methods cannot be
+// batched.
+class CanvasBatch {
+ public:
+  static constexpr size_t kHeaderSize = 4;
+  static constexpr size_t kCallHeaderSize = 12;
+
+  // A call decoded from a batch frame. payload points into the
+  // decoded buffer.
+  struct DecodedCall {
+    uint32_t call_id;
+    Canvas::MethodId id;
+    const void* payload;
+    size_t payload_size;
+  };
+
+  uint32_t Paint(const ::rpcgentest::PaintArgs& request, ::dotdashpay::ddprpc::InplaceCompletionFunction&& completion_handler) {
+    return Add(Canvas::MethodId::kPaint, request, ::dotdashpay::ddprpc::InplaceUpdateFunction(),
+               std::move(completion_handler));
+  }
+
+  size_t size() const { return calls_.size(); }
+
+  // Number of bytes Encode writes.
+  size_t FrameSize() const {
+    size_t frame_size = kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      frame_size += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Serialize every call into the capacity bytes at buffer. Returns
+  // the size of the frame, or 0 if it does not fit.
+  size_t Encode(void* buffer, size_t capacity) const {
+    const size_t frame_size = FrameSize();
+    if (capacity < frame_size) {
+      return 0;
+    }
+    uint8_t* bytes = static_cast<uint8_t*>(buffer);
+    WriteLittleEndian32(static_cast<uint32_t>(calls_.size()), bytes);
+    bytes += kHeaderSize;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      WriteLittleEndian32(static_cast<uint32_t>(i), bytes);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].id), bytes + 4);
+      WriteLittleEndian32(static_cast<uint32_t>(calls_[i].payload.size()), bytes + 8);
+      memcpy(bytes + kCallHeaderSize, calls_[i].payload.data(), calls_[i].payload.size());
+      bytes += kCallHeaderSize + calls_[i].payload.size();
+    }
+    return frame_size;
+  }
+
+  // Pass an update response for call_id to its update handler.
+  // Returns false if there is no such call or it has no update
+  // handler.
+  bool Update(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].update_handler) {
+      return false;
+    }
+    calls_[call_id].update_handler(response);
+    return true;
+  }
+
+  // Pass the completion response for call_id to its completion
+  // handler. Returns false if there is no such call or it has
+  // already completed.
+  bool Complete(uint32_t call_id, const ::google::protobuf::Message& response) {
+    if (call_id >= calls_.size() || !calls_[call_id].completion_handler) {
+      return false;
+    }
+    ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler(std::move(calls_[call_id].completion_handler));
+    calls_[call_id].completion_handler = nullptr;
+    calls_[call_id].update_handler = nullptr;
+    completion_handler(response);
+    return true;
+  }
+
+  // Decode the batch frame in the size bytes at data into calls,
+  // without copying the payloads, so each call can be passed on to
+  // Canvas::Dispatch. Returns false if the frame is truncated or
+  // names a method Canvas does not have.
+  static bool Decode(const void* data, size_t size, std::vector<DecodedCall>* calls) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size < kHeaderSize) {
+      return false;
+    }
+    const uint32_t call_count = ReadLittleEndian32(bytes);
+    bytes += kHeaderSize;
+    size -= kHeaderSize;
+    for (uint32_t i = 0; i < call_count; ++i) {
+      if (size < kCallHeaderSize) {
+        return false;
+      }
+      DecodedCall call;
+      call.call_id = ReadLittleEndian32(bytes);
+      const uint32_t id = ReadLittleEndian32(bytes + 4);
+      call.payload_size = ReadLittleEndian32(bytes + 8);
+      if (id >= Canvas::kMethodCount || size - kCallHeaderSize < call.payload_size) {
+        return false;
+      }
+      call.id = static_cast<Canvas::MethodId>(id);
+      call.payload = bytes + kCallHeaderSize;
+      calls->push_back(call);
+      bytes += kCallHeaderSize + call.payload_size;
+      size -= kCallHeaderSize + call.payload_size;
+    }
+    return true;
+  }
+
+ private:
+  struct Call {
+    Canvas::MethodId id;
+    std::string payload;
+    ::dotdashpay::ddprpc::InplaceUpdateFunction update_handler;
+    ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler;
+  };
+
+  uint32_t Add(Canvas::MethodId id, const ::google::protobuf::MessageLite& request,
+               ::dotdashpay::ddprpc::InplaceUpdateFunction update_handler, ::dotdashpay::ddprpc::InplaceCompletionFunction completion_handler) {
+    calls_.push_back(Call());
+    Call& call = calls_.back();
+    call.id = id;
+    request.SerializeToString(&call.payload);
+    call.update_handler = std::move(update_handler);
+    call.completion_handler = std::move(completion_handler);
+    return static_cast<uint32_t>(calls_.size() - 1);
+  }
+
+  static void WriteLittleEndian32(uint32_t value, uint8_t* bytes) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+    bytes[2] = static_cast<uint8_t>(value >> 16);
+    bytes[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  static uint32_t ReadLittleEndian32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  std::vector<Call> calls_;
+};
+
+}  // namespace rpcgentest
+
+
+#endif  // __DOTDASHPAY_codecs_2eproto__INCLUDED
@@ -0,0 +1,348 @@
+//
+//  Automatically generated from no_methods.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+const DDP_API_MAJOR_VERSION = 1;
+const DDP_API_MINOR_VERSION = 0;
+
+var _ = require("lodash");
+var Server = require("./internal/server");
+
+// The low and high 32 bits of a 64-bit integer given as a number, a
+// decimal string or a Long.
+function splitInt64(value) {
+  if (typeof value === "object") {
+    return [value.low >>> 0, value.high >>> 0];
+  }
+  var negative, lo = 0, hi = 0;
+  if (typeof value === "number") {
+    negative = value < 0;
+    value = Math.abs(value);
+    lo = value >>> 0;
+    hi = Math.floor(value / 4294967296) >>> 0;
+  } else {
+    var digits = String(value);
+    negative = digits.charAt(0) === "-";
+    for (var i = negative ? 1 : 0; i < digits.length; i += 6) {
+      var chunk = digits.slice(i, i + 6);
+      var scale = Math.pow(10, chunk.length);
+      var low = lo * scale + Number(chunk);
+      hi = (hi * scale + Math.floor(low / 4294967296)) % 4294967296;
+      lo = low % 4294967296;
+    }
+  }
+  if (negative) {
+    lo = (~lo + 1) >>> 0;
+    hi = (~hi + (lo === 0 ? 1 : 0)) >>> 0;
+  }
+  return [lo, hi];
+}
+
+// A 64-bit integer as a number while it is exactly representable and
+// as a decimal string beyond that.
+function joinInt64(lo, hi, signed) {
+  var negative = signed && hi >>> 31 === 1;
+  if (negative) {
+    lo = (~lo + 1) >>> 0;
+    hi = (~hi + (lo === 0 ? 1 : 0)) >>> 0;
+  }
+  if (hi < 0x200000) {
+    var value = hi * 4294967296 + lo;
+    return negative ? -value : value;
+  }
+  var digits = "";
+  while (hi) {
+    var low = (hi % 1000000) * 4294967296 + lo;
+    hi = Math.floor(hi / 1000000);
+    lo = Math.floor(low / 1000000);
+    digits = String(1000000 + low % 1000000).slice(1) + digits;
+  }
+  return (negative ? "-" : "") + lo + digits;
+}
+
+// Appends the wire format of fields to a Buffer that grows as needed.
+function Writer() {
+  this.buffer = Buffer.allocUnsafe(64);
+  this.length = 0;
+}
+
+Writer.prototype.reserve = function(size) {
+  if (this.length + size > this.buffer.length) {
+    var buffer = Buffer.allocUnsafe(Math.max(this.buffer.length * 2, this.length + size));
+    this.buffer.copy(buffer, 0, 0, this.length);
+    this.buffer = buffer;
+  }
+};
+
+Writer.prototype.uint32 = function(value) {
+  this.reserve(5);
+  value >>>= 0;
+  while (value > 127) {
+    this.buffer[this.length++] = (value & 127) | 128;
+    value >>>= 7;
+  }
+  this.buffer[this.length++] = value;
+  return this;
+};
+
+Writer.prototype.varint64 = function(lo, hi) {
+  this.reserve(10);
+  while (hi) {
+    this.buffer[this.length++] = (lo & 127) | 128;
+    lo = ((lo >>> 7) | (hi << 25)) >>> 0;
+    hi >>>= 7;
+  }
+  return this.uint32(lo);
+};
+
+Writer.prototype.int32 = function(value) {
+  return value < 0 ? this.varint64(value >>> 0, 4294967295) : this.uint32(value);
+};
+
+Writer.prototype.sint32 = function(value) {
+  return this.uint32((value << 1) ^ (value >> 31));
+};
+
+Writer.prototype.bool = function(value) {
+  return this.uint32(value ? 1 : 0);
+};
+
+Writer.prototype.int64 = Writer.prototype.uint64 = function(value) {
+  var bits = splitInt64(value);
+  return this.varint64(bits[0], bits[1]);
+};
+
+Writer.prototype.sint64 = function(value) {
+  var bits = splitInt64(value);
+  var sign = bits[1] >> 31;
+  return this.varint64(((bits[0] << 1) ^ sign) >>> 0, (((bits[1] << 1) | (bits[0] >>> 31)) ^ sign) >>> 0);
+};
+
+Writer.prototype.fixed32 = function(value) {
+  this.reserve(4);
+  this.length = this.buffer.writeUInt32LE(value >>> 0, this.length);
+  return this;
+};
+
+Writer.prototype.sfixed32 = function(value) {
+  this.reserve(4);
+  this.length = this.buffer.writeInt32LE(value | 0, this.length);
+  return this;
+};
+
+Writer.prototype.fixed64 = Writer.prototype.sfixed64 = function(value) {
+  var bits = splitInt64(value);
+  this.reserve(8);
+  this.buffer.writeUInt32LE(bits[0], this.length);
+  this.length = this.buffer.writeUInt32LE(bits[1], this.length + 4);
+  return this;
+};
+
+Writer.prototype.float = function(value) {
+  this.reserve(4);
+  this.length = this.buffer.writeFloatLE(value, this.length);
+  return this;
+};
+
+Writer.prototype.double = function(value) {
+  this.reserve(8);
+  this.length = this.buffer.writeDoubleLE(value, this.length);
+  return this;
+};
+
+Writer.prototype.string = function(value) {
+  var size = Buffer.byteLength(value);
+  this.uint32(size);
+  this.reserve(size);
+  this.length += this.buffer.write(value, this.length, size, "utf8");
+  return this;
+};
+
+// Takes a Buffer or a base64 string, just like protobuf.js.
+Writer.prototype.bytes = function(value) {
+  if (!Buffer.isBuffer(value)) {
+    value = Buffer.from(value, "base64");
+  }
+  this.uint32(value.length);
+  this.reserve(value.length);
+  this.length += value.copy(this.buffer, this.length);
+  return this;
+};
+
+// Starts a length delimited field whose size is not known yet. Pass the
+// result to ldelim once its content is written.
+Writer.prototype.fork = function() {
+  return this.length;
+};
+
+Writer.prototype.ldelim = function(start) {
+  var size = this.length - start;
+  var prefix = 1;
+  for (var rest = size >>> 7; rest; rest >>>= 7) {
+    prefix++;
+  }
+  this.reserve(prefix);
+  this.buffer.copy(this.buffer, start + prefix, start, this.length);
+  this.length = start;
+  this.uint32(size);
+  this.length += size;
+  return this;
+};
+
+Writer.prototype.finish = function() {
+  return this.buffer.slice(0, this.length);
+};
+
+// Reads fields from the wire format in a Buffer.
+function Reader(buffer) {
+  this.buffer = buffer;
+  this.pos = 0;
+}
+
+Reader.prototype.advance = function(size) {
+  if (this.pos + size > this.buffer.length) {
+    throw Error("truncated message");
+  }
+  var pos = this.pos;
+  this.pos += size;
+  return pos;
+};
+
+Reader.prototype.uint32 = function() {
+  var value = 0;
+  for (var shift = 0; ; shift += 7) {
+    var b = this.buffer[this.advance(1)];
+    if (shift < 32) {
+      value |= (b & 127) << shift;
+    }
+    if (b < 128) {
+      return value >>> 0;
+    }
+  }
+};
+
+// Reads a varint into lo and hi.
+Reader.prototype.varint64 = function() {
+  this.lo = 0;
+  this.hi = 0;
+  for (var shift = 0; ; shift += 7) {
+    var b = this.buffer[this.advance(1)];
+    if (shift < 28) {
+      this.lo |= (b & 127) << shift;
+    } else if (shift === 28) {
+      this.lo |= (b & 127) << 28;
+      this.hi |= (b & 127) >>> 4;
+    } else if (shift < 64) {
+      this.hi |= (b & 127) << (shift - 32);
+    }
+    if (b < 128) {
+      this.lo >>>= 0;
+      this.hi >>>= 0;
+      return;
+    }
+  }
+};
+
+Reader.prototype.int32 = function() {
+  return this.uint32() | 0;
+};
+
+Reader.prototype.sint32 = function() {
+  var value = this.uint32();
+  return (value >>> 1) ^ -(value & 1);
+};
+
+Reader.prototype.bool = function() {
+  return this.uint32() !== 0;
+};
+
+Reader.prototype.int64 = function() {
+  this.varint64();
+  return joinInt64(this.lo, this.hi, true);
+};
+
+Reader.prototype.uint64 = function() {
+  this.varint64();
+  return joinInt64(this.lo, this.hi, false);
+};
+
+Reader.prototype.sint64 = function() {
+  this.varint64();
+  var sign = -(this.lo & 1);
+  return joinInt64((((this.lo >>> 1) | (this.hi << 31)) ^ sign) >>> 0, ((this.hi >>> 1) ^ sign) >>> 0, true);
+};
+
+Reader.prototype.fixed32 = function() {
+  return this.buffer.readUInt32LE(this.advance(4));
+};
+
+Reader.prototype.sfixed32 = function() {
+  return this.buffer.readInt32LE(this.advance(4));
+};
+
+Reader.prototype.fixed64 = function() {
+  var pos = this.advance(8);
+  return joinInt64(this.buffer.readUInt32LE(pos), this.buffer.readUInt32LE(pos + 4), false);
+};
+
+Reader.prototype.sfixed64 = function() {
+  var pos = this.advance(8);
+  return joinInt64(this.buffer.readUInt32LE(pos), this.buffer.readUInt32LE(pos + 4), true);
+};
+
+Reader.prototype.float = function() {
+  return this.buffer.readFloatLE(this.advance(4));
+};
+
+Reader.prototype.double = function() {
+  return this.buffer.readDoubleLE(this.advance(8));
+};
+
+Reader.prototype.string = function() {
+  var size = this.uint32();
+  var pos = this.advance(size);
+  return this.buffer.toString("utf8", pos, pos + size);
+};
+
+Reader.prototype.bytes = function() {
+  var size = this.uint32();
+  var pos = this.advance(size);
+  return this.buffer.slice(pos, pos + size);
+};
+
+// The end of a length delimited field that starts at the current
+// position.
+Reader.prototype.end = function() {
+  var size = this.uint32();
+  if (this.pos + size > this.buffer.length) {
+    throw Error("truncated message");
+  }
+  return this.pos + size;
+};
+
+// Skips a field of an unknown number.
+Reader.prototype.skip = function(wireType) {
+  switch (wireType) {
+    case 0:
+      this.uint32();
+      break;
+    case 1:
+      this.advance(8);
+      break;
+    case 2:
+      this.advance(this.uint32());
+      break;
+    case 3:
+      for (var tag = this.uint32(); (tag & 7) !== 4; tag = this.uint32()) {
+        this.skip(tag & 7);
+      }
+      break;
+    case 5:
+      this.advance(4);
+      break;
+    default:
+      throw Error("invalid wire type " + wireType);
+  }
+};
+
@@ -0,0 +1,65 @@
+//
+//  Automatically generated from signals.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#import "DDPPayment.h"
+
+#import "DDPBridge.h"
+#import "DotDashPayAPI.h"
+#import "DDPLogging.h"
+#import "DDPSerialProtocol.h"
+#import "DDPSignalManager.h"
+
+#import "Common.pbobjc.h"
+#import "rpcgentest.pbobjc.h"
+
+@implementation DDPPayment
+
+- (void) charge:(DDPChargeArgs*)args onError:(void(^)(DDPErrorResponse*))callbackError onChargeDone:(void(^)(DDPChargeDone*))callbackChargeDone {
+  [self charge:args onError:callbackError onChargeProgress:nil onChargeDone:callbackChargeDone];
+}
+
+- (void) charge:(DDPChargeArgs*)args onError:(void(^)(DDPErrorResponse*))callbackError onChargeProgress:(void(^)(DDPChargeProgress*))callbackChargeProgress onChargeDone:(void(^)(DDPChargeDone*))callbackChargeDone {
+  [DDPSignalManager clear:@"ChargeError"];
+  [DDPSignalManager clear:@"ChargeProgress"];
+  [DDPSignalManager clear:@"ChargeDone"];
+  [[DDPBridge getInstance] sendRequest:@"Charge" messageId:DDPMessageId_ChargeArgs withArgs:args completionBlock:^(BOOL sent) {
+    VLOG(2, @"DDPPayment::Charge: %d", sent);
+    if (!sent && callbackError != nil) {
+      DDPErrorResponse* error = [[DDPErrorResponse alloc] init];
+      error.errorCode = @"RequestNotAcknowledged";
+      error.errorMessage = @"The request was not acknowledged. Please check the connection between this machine and the DotDashPay module.";
+      callbackError(error);
+    } else {
+      if (callbackError != nil) {
+        [DDPSignalManager on:@"ChargeError" performCallback:callbackError];
+      }
+      if (callbackChargeProgress != nil) {
+        [DDPSignalManager on:@"ChargeProgress" performCallback:callbackChargeProgress];
+      }
+      [DDPSignalManager on:@"ChargeDone" performCallback:callbackChargeDone];
+    }
+  }];
+}
+
+- (void) refund:(DDPRefundArgs*)args onError:(void(^)(DDPErrorResponse*))callbackError onChargeDone:(void(^)(DDPChargeDone*))callbackChargeDone {
+  [DDPSignalManager clear:@"RefundError"];
+  [DDPSignalManager clear:@"ChargeDone"];
+  [[DDPBridge getInstance] sendRequest:@"Refund" messageId:DDPMessageId_RefundArgs withArgs:args completionBlock:^(BOOL sent) {
+    VLOG(2, @"DDPPayment::Refund: %d", sent);
+    if (!sent && callbackError != nil) {
+      DDPErrorResponse* error = [[DDPErrorResponse alloc] init];
+      error.errorCode = @"RequestNotAcknowledged";
+      error.errorMessage = @"The request was not acknowledged. Please check the connection between this machine and the DotDashPay module.";
+      callbackError(error);
+    } else {
+      if (callbackError != nil) {
+        [DDPSignalManager on:@"RefundError" performCallback:callbackError];
+      }
+      [DDPSignalManager on:@"ChargeDone" performCallback:callbackChargeDone];
+    }
+  }];
+}
+
+@end
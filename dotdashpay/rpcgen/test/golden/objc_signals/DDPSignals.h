@@ -0,0 +1,28 @@
+//
+//  Automatically generated from signals.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#define DDP_API_MAJOR_VERSION 1
+#define DDP_API_MINOR_VERSION 0
+
+#import <Foundation/Foundation.h>
+
+// The channel of every error and response of the API, for a
+// DDPSignalManager that keeps its callbacks in an array indexed by
+// channel instead of by name.
+typedef NS_ENUM(NSInteger, DDPSignalId) {
+  DDPSignalId_ChargeError,
+  DDPSignalId_ChargeProgress,
+  DDPSignalId_ChargeDone,
+  DDPSignalId_RefundError,
+  DDPSignalIdCount
+};
+
+@interface DDPSignals : NSObject
+
+// The channel of the error or response with name, or DDPSignalIdCount if
+// the API has none.
++ (DDPSignalId) signalIdForName:(NSString*)name;
+
+@end
@@ -0,0 +1,25 @@
+//
+//  Automatically generated from signals.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#import "DDPSignals.h"
+
+@implementation DDPSignals
+
++ (DDPSignalId) signalIdForName:(NSString*)name {
+  static NSDictionary* signalIdForName;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    signalIdForName = @{
+      @"ChargeError": @(DDPSignalId_ChargeError),
+      @"ChargeProgress": @(DDPSignalId_ChargeProgress),
+      @"ChargeDone": @(DDPSignalId_ChargeDone),
+      @"RefundError": @(DDPSignalId_RefundError)
+    };
+  });
+  NSNumber* signalId = signalIdForName[name];
+  return signalId != nil ? [signalId integerValue] : DDPSignalIdCount;
+}
+
+@end
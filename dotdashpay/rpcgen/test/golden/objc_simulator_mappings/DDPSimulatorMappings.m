@@ -0,0 +1,22 @@
+//
+//  Automatically generated from simulator_mappings.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#import "DDPSimulatorMappings.h"
+
+@implementation DDPSimulatorMappings
+
++ (NSArray*) getResponsesForRequest:(NSString*)request {
+  static NSDictionary* responsesForRequest;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    responsesForRequest = @{
+      @"Status": @[@"StatusUpdate", @"StatusDone"],
+      @"Reset": @[@"ResetDone"]
+    };
+  });
+  return responsesForRequest[request];
+}
+
+@end
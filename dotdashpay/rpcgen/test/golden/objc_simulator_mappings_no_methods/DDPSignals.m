@@ -0,0 +1,20 @@
+//
+//  Automatically generated from no_methods.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#import "DDPSignals.h"
+
+@implementation DDPSignals
+
++ (DDPSignalId) signalIdForName:(NSString*)name {
+  static NSDictionary* signalIdForName;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    signalIdForName = @{};
+  });
+  NSNumber* signalId = signalIdForName[name];
+  return signalId != nil ? [signalId integerValue] : DDPSignalIdCount;
+}
+
+@end
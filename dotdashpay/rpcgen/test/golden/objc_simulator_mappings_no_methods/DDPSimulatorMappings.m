@@ -0,0 +1,19 @@
+//
+//  Automatically generated from no_methods.proto
+//  DO NOT EDIT THIS FILE DIRECTLY.
+//
+
+#import "DDPSimulatorMappings.h"
+
+@implementation DDPSimulatorMappings
+
++ (NSArray*) getResponsesForRequest:(NSString*)request {
+  static NSDictionary* responsesForRequest;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    responsesForRequest = @{};
+  });
+  return responsesForRequest[request];
+}
+
+@end
@@ -0,0 +1,35 @@
+// Checks the frame a generated batch encodes and that its calls are sent
+// one by one until the runtime can send the frame.
+var runtime = require("./runtime");
+var assert = runtime.assert;
+var sent = runtime.sent;
+
+var queue = runtime.load("queue.js");
+
+// Streaming methods are not batched.
+assert.strictEqual(queue.QueueBatch.prototype.watch, undefined);
+
+var batch = new queue.QueueBatch().push({item: "ab"}).pop({});
+assert.throws(function() { batch.push({}); }, /`item` has incorrect type/);
+
+// [count] then [call id][method id][length][payload] per call. The
+// payload of push is PushArgs with its default priority, byte for byte
+// what protoc --encode writes.
+assert.deepStrictEqual(Array.from(batch.encode()), [
+  2, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0x0a, 0x02, 0x61, 0x62, 0x10, 0x03,
+  1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0
+]);
+assert.deepStrictEqual(Array.from(new queue.QueueBatch().encode()), [0, 0, 0, 0]);
+
+// send() sends every call on its own, in order, and empties the batch.
+var requests = batch.send();
+assert.strictEqual(requests.length, 2);
+assert.deepStrictEqual(sent.map(function(request) { return request.name; }), ["Push", "Pop"]);
+assert.deepStrictEqual(sent[0].args, {item: "ab", priority: 3});
+assert.deepStrictEqual(Array.from(batch.encode()), [0, 0, 0, 0]);
+
+var completions = [];
+requests[1].onPopDone(function(done) { completions.push(done); });
+sent[1].respond("PopDone", {item: "ab"});
+assert.deepStrictEqual(completions, [{item: "ab"}]);
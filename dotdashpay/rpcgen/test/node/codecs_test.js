@@ -0,0 +1,57 @@
+// Round trips PaintArgs through the generated codecs, with enums given by
+// name and by number and 64-bit integers beyond 2^53.
+var runtime = require("./runtime");
+var assert = runtime.assert;
+var canvas = runtime.load("canvas.js");
+var codec = canvas.codecs.PaintArgs;
+
+// An enum given by name goes on the wire as its number.
+assert.deepStrictEqual(codec.encode({color: "BLUE"}), Buffer.from([0x08, 0x02]));
+assert.deepStrictEqual(codec.encode({color: 2}), Buffer.from([0x08, 0x02]));
+assert.deepStrictEqual(codec.encode({palette: ["GREEN", 2, "RED"]}), Buffer.from([0x42, 0x03, 0x01, 0x02, 0x00]));
+assert.throws(function() {
+  codec.encode({color: "PURPLE"});
+}, /`PURPLE` is not a Color value/);
+
+var decoded = codec.decode(codec.encode({
+  color: "BLUE",
+  id: "-9223372036854775808",
+  count: "18446744073709551615",
+  offset: -5,
+  mask: "9007199254740993",
+  delta: -2,
+  palette: ["GREEN", "BLUE"],
+  points: [{x: -1, y: 2}],
+  label: "café",
+  data: Buffer.from([0, 255]),
+  scale: 1.25
+}));
+assert.strictEqual(decoded.color, 2);
+assert.strictEqual(decoded.fallback, 1);
+assert.strictEqual(decoded.id, "-9223372036854775808");
+assert.strictEqual(decoded.count, "18446744073709551615");
+assert.strictEqual(decoded.offset, -5);
+assert.strictEqual(decoded.mask, "9007199254740993");
+assert.strictEqual(decoded.delta, -2);
+assert.deepStrictEqual(decoded.palette, [1, 2]);
+assert.deepStrictEqual(decoded.points, [{x: -1, y: 2}]);
+assert.strictEqual(decoded.label, "café");
+assert.deepStrictEqual(decoded.data, Buffer.from([0, 255]));
+assert.strictEqual(decoded.scale, 1.25);
+
+// Fields that are not on the wire decode to their defaults.
+var empty = codec.decode(Buffer.alloc(0));
+assert.strictEqual(empty.count, "18446744073709551615");
+assert.strictEqual(empty.delta, "-9007199254740993");
+assert.strictEqual(empty.label, "plain \"paint\"");
+assert.strictEqual(empty.scale, 0.1);
+
+// The arguments are checked before anything is sent, and enum names
+// pass the check.
+assert.throws(function() {
+  canvas.paint({color: "PURPLE", id: 1});
+}, /`color` has incorrect type/);
+canvas.paint({color: "BLUE", id: "12345678901234567890"});
+assert.strictEqual(runtime.sent.length, 1);
+assert.strictEqual(runtime.sent[0].args.color, "BLUE");
+assert.strictEqual(runtime.sent[0].args.fallback, 1);
@@ -0,0 +1,45 @@
+// Checks that a cacheable method completes identical calls from its
+// cache, whether or not the first caller attached a completion handler.
+var runtime = require("./runtime");
+var assert = runtime.assert;
+var sent = runtime.sent;
+
+var store = runtime.load("store.js");
+
+// The cache fills from the response even without a handler.
+store.peek({key: "a"});
+assert.strictEqual(sent.length, 1);
+sent[0].respond("LookupDone", {value: "x"});
+
+var completions = [];
+var hit = store.peek({key: "a"});
+assert.strictEqual(sent.length, 1);
+assert.strictEqual(hit.onError(function() { assert.fail("a cache hit does not fail"); }), hit);
+hit.onLookupDone(function(done) { completions.push(done); });
+
+// The cache of a method that is also joined fills and hits the same way,
+// and its hits take update handlers too.
+store.get({key: "a"});
+assert.strictEqual(sent.length, 2);
+sent[1].respond("LookupDone", {value: "y"});
+store.get({key: "a"})
+  .onError(function() { assert.fail("a cache hit does not fail"); })
+  .onLookupProgress(function() { assert.fail("a cache hit has no updates"); })
+  .onLookupDone(function(done) { completions.push(done); });
+assert.strictEqual(sent.length, 2);
+
+// A failed call leaves nothing in the cache.
+store.peek({key: "b"}).onError(function() {});
+sent[2].respond("Error", "boom");
+store.peek({key: "b"});
+assert.strictEqual(sent.length, 4);
+
+// Cache hits complete on a later tick, like a real response.
+assert.deepStrictEqual(completions, []);
+process.nextTick(function() {
+  assert.deepStrictEqual(completions, [{value: "x"}, {value: "y"}]);
+
+  store.clearResponseCache();
+  store.peek({key: "a"});
+  assert.strictEqual(sent.length, 5);
+});
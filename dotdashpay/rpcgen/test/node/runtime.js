@@ -0,0 +1,71 @@
+// Stands in for the runtime modules that generated services require, so
+// that a test can load a service and answer its requests.
+//
+// Every request a service sends is recorded in `sent`. Each one has the
+// method name, the arguments, and respond(name, message), which calls
+// the handlers attached with on<name>.
+var Module = require("module");
+
+var lodash = {
+  each: function(collection, iteratee) {
+    if (Array.isArray(collection)) {
+      collection.forEach(iteratee);
+    } else {
+      Object.keys(collection).forEach(function(key) {
+        iteratee(collection[key], key);
+      });
+    }
+  }
+};
+
+var sent = [];
+
+function createRequestThenSend(name, args) {
+  var handlers = {};
+  var request = new Proxy({}, {
+    get: function(target, property) {
+      if (property in target || typeof property !== "string" || property.indexOf("on") !== 0) {
+        return target[property];
+      }
+      return function(handler) {
+        var event = property.slice(2);
+        (handlers[event] = handlers[event] || []).push(handler);
+        return request;
+      };
+    }
+  });
+  sent.push({
+    name: name,
+    args: args,
+    respond: function(event, message) {
+      (handlers[event] || []).forEach(function(handler) {
+        handler(message);
+      });
+    }
+  });
+  return request;
+}
+
+var server = {
+  createRequestThenSend: createRequestThenSend
+};
+
+var require_ = Module.prototype.require;
+Module.prototype.require = function(id) {
+  if (id === "lodash") {
+    return lodash;
+  }
+  if (id === "./internal/server") {
+    return server;
+  }
+  return require_.apply(this, arguments);
+};
+
+// The generated service `name` in the directory the test was given.
+module.exports.load = function(name) {
+  return require(require("path").resolve(process.argv[2], name));
+};
+
+module.exports.sent = sent;
+
+module.exports.assert = require("assert");
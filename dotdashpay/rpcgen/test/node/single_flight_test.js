@@ -0,0 +1,46 @@
+// Checks that identical calls of an idempotent method share one request,
+// and that the call stops being shared once it completes or fails.
+var runtime = require("./runtime");
+var assert = runtime.assert;
+var sent = runtime.sent;
+
+var store = runtime.load("store.js");
+
+// Identical calls share one request and all get its responses.
+var updates = [];
+var completions = [];
+store.find({key: "a"})
+  .onLookupProgress(function(update) { updates.push(update); })
+  .onLookupDone(function(done) { completions.push(done); });
+store.find({key: "a"})
+  .onLookupDone(function(done) { completions.push(done); });
+store.find({key: "b"});
+assert.strictEqual(sent.length, 2);
+assert.strictEqual(sent[0].name, "Find");
+assert.deepStrictEqual(sent[0].args, {key: "a"});
+
+sent[0].respond("LookupProgress", {percent: 50});
+sent[0].respond("LookupDone", {value: "x"});
+assert.deepStrictEqual(updates, [{percent: 50}]);
+assert.deepStrictEqual(completions, [{value: "x"}, {value: "x"}]);
+
+// Once the call completed, an identical call sends again.
+store.find({key: "a"});
+assert.strictEqual(sent.length, 3);
+sent[2].respond("LookupDone", {value: "y"});
+
+// An error reaches every joined call, and the next identical call sends
+// again instead of joining the failed one.
+var errors = [];
+var first = store.find({key: "c"});
+assert.strictEqual(first.onError(function(error) { errors.push(error); }), first);
+store.find({key: "c"}).onError(function(error) { errors.push(error); });
+assert.strictEqual(sent.length, 4);
+sent[3].respond("Error", "boom");
+assert.deepStrictEqual(errors, ["boom", "boom"]);
+
+completions = [];
+store.find({key: "c"}).onLookupDone(function(done) { completions.push(done); });
+assert.strictEqual(sent.length, 5);
+sent[4].respond("LookupDone", {value: "z"});
+assert.deepStrictEqual(completions, [{value: "z"}]);
@@ -0,0 +1,41 @@
+# Run PROTOC with PLUGIN over PROTO and compare every file in GOLDEN_DIR
+# with the file of the same name that the plugin wrote to OUTPUT_DIR.
+# Files the plugin writes that have no golden copy are not compared.
+# PARAMETER, if set, is passed to the plugin, e.g. "use_arena=true".
+#
+# To update a golden file after an intended change, run the test and
+# copy the file from OUTPUT_DIR over the one in GOLDEN_DIR.
+
+file(REMOVE_RECURSE "${OUTPUT_DIR}")
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+
+set(out "${OUTPUT_DIR}")
+if(PARAMETER)
+  set(out "${PARAMETER}:${OUTPUT_DIR}")
+endif()
+
+execute_process(
+  COMMAND "${PROTOC}"
+          "--plugin=protoc-gen-ddprpc=${PLUGIN}"
+          "--ddprpc_out=${out}"
+          "-I${PROTO_PATH}"
+          "-I${IMPORT_PATH}"
+          "${PROTO_PATH}/${PROTO}"
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "protoc failed on ${PROTO}")
+endif()
+
+file(GLOB golden_files RELATIVE "${GOLDEN_DIR}" "${GOLDEN_DIR}/*")
+if(NOT golden_files)
+  message(FATAL_ERROR "${GOLDEN_DIR} has no golden files")
+endif()
+
+foreach(golden_file ${golden_files})
+  execute_process(
+    COMMAND "${CMAKE_COMMAND}" -E compare_files "${GOLDEN_DIR}/${golden_file}" "${OUTPUT_DIR}/${golden_file}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${OUTPUT_DIR}/${golden_file} differs from ${GOLDEN_DIR}/${golden_file}")
+  endif()
+endforeach()
@@ -0,0 +1,25 @@
+# Run PROTOC with PLUGIN over PROTO, then run the Node.js SCRIPT with
+# OUTPUT_DIR, where the plugin wrote the generated modules, as its
+# argument. The test fails if SCRIPT exits with an error.
+
+file(REMOVE_RECURSE "${OUTPUT_DIR}")
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+
+execute_process(
+  COMMAND "${PROTOC}"
+          "--plugin=protoc-gen-ddprpc=${PLUGIN}"
+          "--ddprpc_out=${OUTPUT_DIR}"
+          "-I${PROTO_PATH}"
+          "-I${IMPORT_PATH}"
+          "${PROTO_PATH}/${PROTO}"
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "protoc failed on ${PROTO}")
+endif()
+
+execute_process(
+  COMMAND "${NODE}" "${SCRIPT}" "${OUTPUT_DIR}"
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${SCRIPT} failed")
+endif()
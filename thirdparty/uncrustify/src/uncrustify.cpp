@@ -46,6 +46,8 @@ static int language_flags_from_name(const char *tag);
 static int language_flags_from_filename(const char *filename);
 static const char *language_name_from_flags(int lang);
 static bool read_stdin(file_mem& fm);
+static bool read_batch_frame(file_mem& fm);
+static void process_batch(void);
 static void uncrustify_start(const deque<int>& data);
 static void uncrustify_end();
 static void uncrustify_file(const file_mem& fm, FILE *pfout, const char *parsed_file);
@@ -161,6 +163,9 @@ static void usage_exit(const char *msg, const char *argv0, int code)
            " --frag       : code fragment, assume the first line is indented correctly\n"
            " --assume FN  : Uses the filename FN for automatic language detection if reading\n"
            "                from stdin unless -l is specified.\n"
+           " --batch      : read length-prefixed sources from stdin until EOF and write each\n"
+           "                formatted result to stdout the same way. A frame is the decimal\n"
+           "                byte count, a newline and then that many bytes.\n"
            "\n"
            "Config/Help Options:\n"
            " -h -? --help --usage     : print this message and exit\n"
@@ -415,6 +420,7 @@ int main(int argc, char *argv[])
    bool       update_config    = arg.Present("--update-config");
    bool       update_config_wd = arg.Present("--update-config-with-doc");
    bool       detect           = arg.Present("--detect");
+   bool       batch            = arg.Present("--batch");
 
    /* Grab the output override */
    output_file = arg.Param("-o");
@@ -430,6 +436,7 @@ int main(int argc, char *argv[])
    LOG_FMT(LDATA, "no_backup   = %d\n", no_backup);
    LOG_FMT(LDATA, "detect      = %d\n", detect);
    LOG_FMT(LDATA, "check       = %d\n", cpd.do_check);
+   LOG_FMT(LDATA, "batch       = %d\n", batch);
 
    if (cpd.do_check &&
        (output_file || replace || no_backup || keep_mtime || update_config ||
@@ -438,6 +445,13 @@ int main(int argc, char *argv[])
       usage_exit("Cannot use --check with output options.", argv[0], 67);
    }
 
+   if (batch &&
+       (cpd.do_check || (source_file != NULL) || (source_list != NULL) ||
+        (output_file != NULL) || replace || no_backup || (parsed_file != NULL)))
+   {
+      usage_exit("Cannot use --batch with file, output or check options.", argv[0], 67);
+   }
+
    if (!cpd.do_check)
    {
       if (replace || no_backup)
@@ -576,7 +590,21 @@ int main(int argc, char *argv[])
       cpd.bout = new deque<UINT8>();
    }
 
-   if ((source_file == NULL) && (source_list == NULL) && (p_arg == NULL))
+   if (batch)
+   {
+      if (p_arg != NULL)
+      {
+         usage_exit("Cannot specify files with --batch.", argv[0], 67);
+      }
+
+      if (cpd.lang_flags == 0)
+      {
+         cpd.lang_flags = (assume != NULL) ? language_flags_from_filename(assume) : LANG_C;
+      }
+
+      process_batch();
+   }
+   else if ((source_file == NULL) && (source_list == NULL) && (p_arg == NULL))
    {
       /* no input specified, so use stdin */
       if (cpd.lang_flags == 0)
@@ -744,6 +772,90 @@ static bool read_stdin(file_mem& fm)
 }
 
 
+/**
+ * Reads one '--batch' frame from stdin: the decimal byte count on its own
+ * line followed by that many bytes of source.
+ * Returns false at EOF or on a malformed frame.
+ */
+static bool read_batch_frame(file_mem& fm)
+{
+   char          linebuf[32];
+   char          *end;
+   unsigned long len;
+
+   fm.raw.clear();
+   fm.data.clear();
+   fm.enc = ENC_ASCII;
+
+   if (fgets(linebuf, sizeof(linebuf), stdin) == NULL)
+   {
+      return(false);
+   }
+   len = strtoul(linebuf, &end, 10);
+   if ((end == linebuf) || (*end != '\n'))
+   {
+      LOG_FMT(LERR, "%s: bad frame header '%s'\n", __func__, linebuf);
+      return(false);
+   }
+
+   fm.raw.resize(len);
+   if ((len > 0) && (fread(&fm.raw[0], 1, len, stdin) != len))
+   {
+      LOG_FMT(LERR, "%s: short frame, expected %lu bytes\n", __func__, len);
+      return(false);
+   }
+   return(decode_unicode(fm.raw, fm.data, fm.enc, fm.bom));
+}
+
+
+/**
+ * Formats frames from stdin until EOF, writing each result as a frame of
+ * the same form to stdout.
+ * The options, keywords and defines are loaded once for the whole run,
+ * which makes this cheaper than starting one process per source.
+ */
+static void process_batch(void)
+{
+   file_mem fm;
+   int      count = 0;
+
+#ifdef WIN32
+   (void)_setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+   /* Collect the output in cpd.bout so that it can be length-prefixed */
+   cpd.bout = new deque<UINT8>();
+
+   while (read_batch_frame(fm))
+   {
+      count++;
+      cpd.filename = "stdin";
+      cpd.bout->clear();
+
+      LOG_FMT(LSYS, "Parsing: frame %d, %d bytes (%d chars) as language %s\n",
+              count, (int)fm.raw.size(), (int)fm.data.size(),
+              language_name_from_flags(cpd.lang_flags));
+
+      uncrustify_file(fm, NULL, NULL);
+
+      fprintf(stdout, "%u\n", (unsigned)cpd.bout->size());
+      for (int idx = 0; idx < (int)cpd.bout->size(); idx++)
+      {
+         putc((*cpd.bout)[idx], stdout);
+      }
+      fflush(stdout);
+   }
+
+   if (!feof(stdin))
+   {
+      cpd.error_count++;
+   }
+
+   delete cpd.bout;
+   cpd.bout = NULL;
+} // process_batch
+
+
 static void make_folders(const string& filename)
 {
    int  idx;
@@ -1748,7 +1860,8 @@ static void uncrustify_end()
       chunk_del(pc);
    }
 
-   if (cpd.bout)
+   /* --batch reads cpd.bout after this returns and clears it itself */
+   if (cpd.bout && cpd.do_check)
    {
       cpd.bout->clear();
    }